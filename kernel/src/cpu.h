@@ -124,24 +124,30 @@ public:
                    "    FPU:   {}\n"
                    "    SSE:   {}\n"
                    "    XSAVE: {}\n"
+                   "    XSAVEOPT: {}\n"
                    "    AVX:   {}\n"
+                   "    MWAIT: {}\n"
                    "  Enabled:\n"
                    "    FXSR:  {}\n"
                    "    FPU:   {}\n"
                    "    SSE:   {}\n"
                    "    XSAVE: {}\n"
-                   "    AVX:   {}\n\n"
+                   "    AVX:   {}\n"
+                   "  XSAVE area size: {}\n\n"
                    , CPUIDCapable
                    , FXSRCapable
                    , FPUCapable
                    , SSECapable
                    , XSAVECapable
+                   , XSAVEOPTCapable
                    , AVXCapable
+                   , MWAITCapable
                    , FXSREnabled
                    , FPUEnabled
                    , SSEEnabled
                    , XSAVEEnabled
-                   , AVXEnabled);
+                   , AVXEnabled
+                   , XSAVEAreaSize);
 
         CPUs.for_each([](auto* it){ it->value().print_debug(); });
         std::print("\n");
@@ -157,8 +163,10 @@ public:
     void set_sse_enabled()   { SSEEnabled = true;   }
     void set_xsave_capable() { XSAVECapable = true; }
     void set_xsave_enabled() { XSAVEEnabled = true; }
+    void set_xsaveopt_capable() { XSAVEOPTCapable = true; }
     void set_avx_capable()   { AVXCapable = true;   }
     void set_avx_enabled()   { AVXEnabled = true;   }
+    void set_mwait_capable() { MWAITCapable = true; }
     // Feature flag getters
     bool cpuid_capable() { return CPUIDCapable; }
     bool fxsr_capable()  { return FXSRCapable;  }
@@ -169,8 +177,15 @@ public:
     bool sse_enabled()   { return SSEEnabled;   }
     bool xsave_capable() { return XSAVECapable; }
     bool xsave_enabled() { return XSAVEEnabled; }
+    bool xsaveopt_capable() { return XSAVEOPTCapable; }
     bool avx_capable()   { return AVXCapable;   }
     bool avx_enabled()   { return AVXEnabled;   }
+    bool mwait_capable() { return MWAITCapable; }
+
+    /// Size in bytes of the XSAVE area needed for the state components
+    /// currently enabled in XCR0 (CPUID.(EAX=0Dh,ECX=0):EBX).
+    void set_xsave_area_size(u32 size) { XSAVEAreaSize = size; }
+    u32 xsave_area_size() { return XSAVEAreaSize; }
 
 private:
     // Used for CPU Logical/Physical core number calculation from APIC ID.
@@ -188,8 +203,11 @@ private:
     bool SSEEnabled   { false };
     bool XSAVECapable { false };
     bool XSAVEEnabled { false };
+    bool XSAVEOPTCapable { false };
     bool AVXCapable   { false };
     bool AVXEnabled   { false };
+    bool MWAITCapable { false };
+    u32 XSAVEAreaSize { 0 };
     // 12-character string that represents the CPU vendor
     char VendorID[12] { ' ',' ',' ',' ',' ',' ',' ',' ',' ',' ',' ',' ' };
     // List of central processing units (why call them central anymore??)
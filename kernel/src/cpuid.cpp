@@ -34,6 +34,12 @@ void cpuid(u32 code, u32& a, u32& b, u32& c, u32& d) {
     asm volatile ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d): "a"(code));
 }
 
+void cpuid(u32 code, u32 subleaf, CPUIDRegisters& regs) {
+    asm volatile ("cpuid"
+                  : "=a"(regs.A), "=b"(regs.B), "=c"(regs.C), "=d"(regs.D)
+                  : "a"(code), "c"(subleaf));
+}
+
 // Strings are returned in registers 'B', 'D', and 'C'
 // This structure allows it's address to be treated
 //   as a valid and human-readable c-string.
@@ -40,6 +40,10 @@ inline void cpuid(u32 code, CPUIDRegisters& regs) {
     cpuid(code, regs.A, regs.B, regs.C, regs.D);
 }
 
+/// Some leaves (i.e. 0x0d, processor extended state enumeration) are
+/// further indexed by a sub-leaf passed in ECX.
+void cpuid(u32 code, u32 subleaf, CPUIDRegisters& regs);
+
 char* cpuid_string(u32 code);
 
 /* Vendor Strings
@@ -9,6 +9,7 @@
 #include <memory/virtual_memory_manager.h>
 #include <pci.h>
 #include <stdint.h>
+#include <work_queue.h>
 
 #include <array>
 #include <bit>
@@ -1963,6 +1964,9 @@ constexpr auto EERD_DATA(u32 eerd) { return u16(eerd >> 16); };
 
 E1000 gE1000 = {};
 
+/// Queued by the interrupt handler when transmit descriptors are done.
+static constinit Work TXCompletion([](Work*) { gE1000.complete_tx(); });
+
 void E1000::write_command(u16 address, u32 value) {
     if (BARType == PCI::BarType::Memory)
         volatile_write((volatile u32*)(BARMemoryAddress + address), value);
@@ -2266,6 +2270,83 @@ void E1000::write_raw(void* data, usz length) {
     write_command(REG_TXDESCTAIL, tail);
 }
 
+void E1000::complete_tx() {
+    // TODO: Abstract x86_64
+    // `write_raw` fills descriptors with interrupts disabled; so must
+    // we, while taking them back. Reporting is left until after.
+    usz transmitted = 0;
+    usz dropped = 0;
+    usz underruns = 0;
+    u64 flags;
+    asm volatile ("pushfq\n"
+                  "pop %0\n"
+                  "cli\n"
+                  : "=r"(flags)
+                  :: "memory");
+    u32 head = read_command(REG_TXDESCHEAD);
+    for (; TXHead < head; ++TXHead) {
+        // It's a ring buffer. Wrap indices over capacity.
+        if (TXHead >= TXDescCount) TXHead = 0;
+
+        volatile TXDesc* txDesc = TXDescPhysical + TXHead;
+
+        /// DD
+        /// Indicates that the descriptor is finished and is written back
+        /// either after the descriptor has been processed (with CMD_RS set) or
+        /// for the 82544GC and 82544EI, after the packet has been transmitted
+        /// on the wire (with RPS set).
+        if (txDesc->Status & E1000::TXDesc::DONE)
+            ++transmitted;
+
+        /// EC
+        /// Indicates that the packet has experienced more than the maximum
+        /// excessive collisions as defined by TCTL.CT control field and was
+        /// not transmitted. It has no meaning while working in full-duplex
+        /// mode.
+        /// LC
+        /// Indicates that late collision occurred while working in half-duplex
+        /// mode. It has no meaning while working in full-duplex mode. Note
+        /// that the collision window is speed dependent: 64 bytes for 10/100
+        /// Mb/s and 512 bytes for 1000 Mb/s operation.
+        if (!(txDesc->Status & E1000::TXDesc::DONE)
+            || txDesc->Status & E1000::TXDesc::EXCESS_COLLISIONS
+            || txDesc->Status & E1000::TXDesc::LATE_COLLISION)
+            ++dropped;
+
+        /// TU/RSV
+        /// Indicates a transmit underrun event occurred. Transmit Underrun might occur if Early
+        /// Transmits are enabled (based on ETT.Txthreshold value) and the
+        /// 82544GC/EI was not able to complete the early transmission of the
+        /// packet due to lack of data in the packet buffer. This does not
+        /// necessarily mean the packet failed to be eventually transmitted.
+        /// The packet is successfully re-transmitted if the TCTL.NRTU bit is
+        /// cleared (and excessive collisions do not occur).
+        /// This bit is reserved and should be programmed to 0b for all
+        /// Ethernet controllers except the 82544GC/EI.
+        // TODO: Do something about an underrun.
+        if (txDesc->Status & E1000::TXDesc::UNDERRUN)
+            ++underruns;
+
+        // Reset descriptor so that it can be used again.
+        usz pages = 0;
+        if (txDesc->Length % PAGE_SIZE)
+            pages = 1 + (txDesc->Length / PAGE_SIZE);
+        else pages = txDesc->Length / PAGE_SIZE;
+        Memory::free_pages((void*)txDesc->Address, pages);
+        txDesc->Address = 0;
+        txDesc->Command = 0;
+        txDesc->Length = 0;
+        txDesc->Status = 0;
+    }
+    asm volatile ("push %0\n"
+                  "popfq\n"
+                  :: "r"(flags)
+                  : "memory", "cc");
+
+    std::print("[E1000]: Packets transmitted: {}, dropped: {}\n", transmitted, dropped);
+    if (underruns) std::print("[E1000]: TX Underruns: {}\n", underruns);
+}
+
 void E1000::handle_interrupt() {
     /// Read status of pending interrupt
     u32 status = read_command(REG_ICR);
@@ -2275,65 +2356,9 @@ void E1000::handle_interrupt() {
     /// (IDE set), the interrupt occurs after the timer expires.
     if (status & ICR_TX_DESC_WRITTEN_BACK) {
         status &= ~ICR_TX_DESC_WRITTEN_BACK;
-
-        u32 head = read_command(REG_TXDESCHEAD);
-        for (; TXHead < head; ++TXHead) {
-            // It's a ring buffer. Wrap indices over capacity.
-            if (TXHead >= TXDescCount) TXHead = 0;
-
-            volatile TXDesc* txDesc = TXDescPhysical + TXHead;
-
-            /// DD
-            /// Indicates that the descriptor is finished and is written back
-            /// either after the descriptor has been processed (with CMD_RS set) or
-            /// for the 82544GC and 82544EI, after the packet has been transmitted
-            /// on the wire (with RPS set).
-            if (txDesc->Status & E1000::TXDesc::DONE) {
-                std::print("[E1000]: Packet transmitted! (desc {})\n", TXHead);
-            }
-
-            /// EC
-            /// Indicates that the packet has experienced more than the maximum
-            /// excessive collisions as defined by TCTL.CT control field and was
-            /// not transmitted. It has no meaning while working in full-duplex
-            /// mode.
-            /// LC
-            /// Indicates that late collision occurred while working in half-duplex
-            /// mode. It has no meaning while working in full-duplex mode. Note
-            /// that the collision window is speed dependent: 64 bytes for 10/100
-            /// Mb/s and 512 bytes for 1000 Mb/s operation.
-            if (!(txDesc->Status & E1000::TXDesc::DONE)
-                || txDesc->Status & E1000::TXDesc::EXCESS_COLLISIONS
-                || txDesc->Status & E1000::TXDesc::LATE_COLLISION) {
-                std::print("[E1000]: Transmitted packet dropped. (desc {})\n", TXHead);
-            }
-
-            /// TU/RSV
-            /// Indicates a transmit underrun event occurred. Transmit Underrun might occur if Early
-            /// Transmits are enabled (based on ETT.Txthreshold value) and the
-            /// 82544GC/EI was not able to complete the early transmission of the
-            /// packet due to lack of data in the packet buffer. This does not
-            /// necessarily mean the packet failed to be eventually transmitted.
-            /// The packet is successfully re-transmitted if the TCTL.NRTU bit is
-            /// cleared (and excessive collisions do not occur).
-            /// This bit is reserved and should be programmed to 0b for all
-            /// Ethernet controllers except the 82544GC/EI.
-            // TODO: Do something about an underrun.
-            if (txDesc->Status & E1000::TXDesc::UNDERRUN) {
-                std::print("[E1000]: TX Underrun\n");
-            }
-
-            // Reset descriptor so that it can be used again.
-            usz pages = 0;
-            if (txDesc->Length % PAGE_SIZE)
-                pages = 1 + (txDesc->Length / PAGE_SIZE);
-            else pages = txDesc->Length / PAGE_SIZE;
-            Memory::free_pages((void*)txDesc->Address, pages);
-            txDesc->Address = 0;
-            txDesc->Command = 0;
-            txDesc->Length = 0;
-            txDesc->Status = 0;
-        }
+        // Reclaiming descriptors (and telling everyone about it) can
+        // wait until we're out of the interrupt handler.
+        gWorkQueue.queue(&TXCompletion);
     }
 
     /// ICR_RX_OVERRUN
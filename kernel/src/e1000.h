@@ -174,6 +174,9 @@ public:
     E1000() {}
     E1000(PCI::PCIHeader0* header);
     void handle_interrupt();
+    /// Reclaim transmit descriptors the hardware is done with; deferred
+    /// to the work queue by the interrupt handler.
+    void complete_tx();
     uint irq_number();
     uint interrupt_line();
     void write_raw(void* data, usz length);
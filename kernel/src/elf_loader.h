@@ -36,6 +36,7 @@
 #include <scheduler.h>
 #include <storage/file_metadata.h>
 #include <system.h>
+#include <time_page.h>
 #include <tss.h>
 #include <virtual_filesystem.h>
 
@@ -109,6 +110,21 @@ namespace ELF {
 #endif /* #ifndef DEBUG_ELF */
     }
 
+    /// Read the ELF64 header of the executable open at FD into ELFHEADER.
+    /// @return false if it couldn't be read, or isn't one we can run.
+    inline bool ReadElf64Header(ProcessFileDescriptor fd, Elf64_Ehdr& elfHeader) {
+        bool read = SYSTEM->virtual_filesystem().read(fd, reinterpret_cast<u8*>(&elfHeader), sizeof(Elf64_Ehdr));
+        if (read == false) {
+            std::print("Failed to read ELF64 header.\n");
+            return false;
+        }
+        if (VerifyElf64Header(elfHeader) == false) {
+            std::print("Executable did not have valid ELF64 header.\n");
+            return false;
+        }
+        return true;
+    }
+
     inline bool LoadUserspaceElf64Process(Process* process, Memory::PageTable* pageTable,
                                           ProcessFileDescriptor fd, const Elf64_Ehdr& elfHeader,
                                           const std::vector<std::string_view>& args = {},
@@ -123,7 +139,7 @@ namespace ELF {
         // Load PT_LOAD program headers, mapping to vaddr as necessary.
         u64 programHeadersTableSize = elfHeader.e_phnum * elfHeader.e_phentsize;
         std::vector<Elf64_Phdr> programHeaders(elfHeader.e_phnum);
-        vfs.read(fd, (u8*)(programHeaders.data()), programHeadersTableSize, elfHeader.e_phoff);
+        vfs.pread(fd, (u8*)(programHeaders.data()), programHeadersTableSize, elfHeader.e_phoff);
         for (
              Elf64_Phdr* phdr = programHeaders.data();
              (u64)phdr < (u64)programHeaders.data() + programHeadersTableSize;
@@ -157,7 +173,7 @@ namespace ELF {
                 // at a page boundary, then we need to offset the read by the offset
                 // into the page.
                 u64 offset = phdr->p_vaddr % PAGE_SIZE;
-                auto n_read = vfs.read(fd, loadedProgram + offset, phdr->p_filesz, phdr->p_offset);
+                auto n_read = vfs.pread(fd, loadedProgram + offset, phdr->p_filesz, phdr->p_offset);
                 if (n_read < 0 || size_t(n_read) != phdr->p_filesz) {
                     std::print("[ELF] Could not read program data from file {}\n" , fd);
                     return false;
@@ -225,6 +241,9 @@ namespace ELF {
                                    UserProcessStackSize,
                                    stack_flags);
 
+        // Every process can tell the time without asking the kernel.
+        TimePage::map(pageTable);
+
         // TODO: Max argument length? Maximum environment length?
 
         // Copy environment contents to the stack, keeping track of addresses.
@@ -318,8 +337,8 @@ namespace ELF {
         // Entry point.
         process->CPU.Frame.ip = elfHeader.e_entry;
         // Ring 3 GDT segment selectors.
-        process->CPU.Frame.cs = 0x18 | 3;
-        process->CPU.Frame.ss = 0x20 | 3;
+        process->CPU.Frame.cs = 0x20 | 3;
+        process->CPU.Frame.ss = 0x18 | 3;
         // Enable interrupts after jump.
         process->CPU.Frame.flags = 0b1010000010;
 
@@ -331,26 +350,23 @@ namespace ELF {
     }
 
     inline bool ReplaceUserspaceElf64Process(Process* process, ProcessFileDescriptor fd, const std::vector<std::string_view>& args = {}) {
-        VFS& vfs = SYSTEM->virtual_filesystem();
         DBGMSG("Attempting to add userspace process from file descriptor {}\n", fd);
         Elf64_Ehdr elfHeader;
-        bool read = vfs.read(fd, reinterpret_cast<u8*>(&elfHeader), sizeof(Elf64_Ehdr));
-        if (read == false) {
-            std::print("Failed to read ELF64 header.\n");
-            return false;
-        }
-        if (VerifyElf64Header(elfHeader) == false) {
-            std::print("Executable did not have valid ELF64 header.\n");
-            return false;
-        }
+        if (not ReadElf64Header(fd, elfHeader)) return false;
 
         // Unmap and free old process memory, if header is valid and things look good to go.
-        for (const auto& region : process->Memories) {
+        for (const auto& region : process->Group->Memories) {
             Memory::unmap_pages(process->CR3, region.vaddr, region.pages, Memory::ShowDebug::No);
             Memory::free_pages(region.paddr, region.pages);
         }
         // Clear memories list.
-        while (process->Memories.remove(0));
+        while (process->Group->Memories.remove(0));
+        // The rings went along with the rest of the memory.
+        process->Group->Ring.reset();
+        // The new program starts with clean FPU registers.
+        Scheduler::fpu_release(process);
+        // ...and no thread local storage.
+        process->FSBase = 0;
 
         return LoadUserspaceElf64Process(process, process->CR3, fd, elfHeader, args);
     }
@@ -364,15 +380,7 @@ namespace ELF {
         VFS& vfs = SYSTEM->virtual_filesystem();
         DBGMSG("Attempting to add userspace process from file descriptor {}\n", fd);
         Elf64_Ehdr elfHeader;
-        bool read = vfs.read(fd, reinterpret_cast<u8*>(&elfHeader), sizeof(Elf64_Ehdr));
-        if (read == false) {
-            std::print("Failed to read ELF64 header.\n");
-            return false;
-        }
-        if (VerifyElf64Header(elfHeader) == false) {
-            std::print("Executable did not have valid ELF64 header.\n");
-            return false;
-        }
+        if (not ReadElf64Header(fd, elfHeader)) return false;
 
         auto* process = new Process{};
         process->State = Process::ProcessState::SLEEPING;
@@ -409,7 +417,7 @@ namespace ELF {
 #ifdef DEBUG_ELF
         std::print("[ELF] ProcFds:\n");
         u64 n = 0;
-        for (const auto& entry : process->FileDescriptors) {
+        for (const auto& entry : process->Group->FileDescriptors) {
             std::print("  {} -> {}\n", n, entry);
             n++;
         }
@@ -423,9 +431,60 @@ namespace ELF {
             process->ExecutablePath.substr(0, process->ExecutablePath.find_last_of("/"));
 
         // Make scheduler aware that this process may be run.
-        process->State = Process::ProcessState::RUNNING;
+        Scheduler::make_runnable(process);
         return true;
     }
+
+    /// Create a child of PARENT running the executable open at FD, in
+    /// an address space of it's own that starts out with only the
+    /// kernel mapped, rather than a copy of the parent's (as `fork`
+    /// would make). It has none of the parent's files open, and is not
+    /// yet runnable, so that the caller may set it up first.
+    /// @param args  Should NEVER be empty; see `CreateUserspaceElf64Process`.
+    /// @return NULL iff the process could not be created.
+    inline Process* SpawnUserspaceElf64Process(Process* parent, ProcessFileDescriptor fd, const std::vector<std::string_view>& args) {
+        if (!args.size()) {
+            std::print("Can not invoke process with zero arguments: at least invocation (argv[0]) is required\n");
+            return nullptr;
+        }
+        Elf64_Ehdr elfHeader;
+        if (not ReadElf64Header(fd, elfHeader)) return nullptr;
+
+        auto* process = new Process{};
+        process->State = Process::ProcessState::SLEEPING;
+        pid_t pid = Scheduler::add_process(process);
+        // Children inherit the priority of their parent.
+        process->Nice = parent->Nice;
+        process->Weight = parent->Weight;
+        process->Affinity = parent->Affinity;
+        SyscallTrace::set_traced(process, parent->Traced);
+
+        // The idle process runs within the kernel's page map, which has
+        // nothing of userspace in it.
+        auto* newPageTable = Memory::clone_page_map(Scheduler::IdleProcess->CR3);
+        if (newPageTable == nullptr) {
+            std::print("Failed to clone kernel page map for new process page map.\n");
+            Scheduler::remove_process(pid, -1);
+            return nullptr;
+        }
+        process->CR3 = newPageTable;
+        Memory::map(newPageTable, newPageTable, newPageTable
+                    , (u64)Memory::PageTableFlag::Present
+                    | (u64)Memory::PageTableFlag::ReadWrite
+                    );
+
+        if (!LoadUserspaceElf64Process(process, newPageTable, fd, elfHeader, args)) {
+            Scheduler::remove_process(pid, -1);
+            return nullptr;
+        }
+        // Only now, so that a child that never got going doesn't leave
+        // a zombie behind for the parent.
+        process->ParentProcess = parent->ProcessID;
+
+        process->ExecutablePath = args[0];
+        process->WorkingDirectory = parent->WorkingDirectory;
+        return process;
+    }
 }
 
 #undef DBGMSG
@@ -28,38 +28,22 @@
 
 EventManager gEvents;
 
-void EventManager::notify(const Event& event) {
-    if (event.Type >= EventType::COUNT) return;
-    static_assert((usz)EventType::COUNT == 3, "Exhaustive handling of process-specific event types in all-process notify().");
-    if (event.Type == EventType::READY_TO_READ || event.Type == EventType::READY_TO_WRITE) {
-        std::print("[Events]: Event manager refuses to notify all processes for process-specific events.\n"
-                   "  This is likely an error in the LensorOS kernel; please submit a bug report with as much information as possible.\n");
-        return;
-    }
-    for (auto pid : Listeners[event.Type]) {
-        Process* process = Scheduler::process(pid);
-        notify(event, process);
+/// Wake up whichever thread of GROUP is blocked in kevent on the
+/// queue with the given HANDLE, if any.
+static void wake_queue_waiter(ThreadGroup* group, EventQueueHandle handle) {
+    if (!group) return;
+    for (pid_t tid : group->Threads) {
+        Process* thread = Scheduler::process(tid);
+        if (thread && thread->BlockedOnEventQueue == handle)
+            thread->unblock(true, -2);
     }
 }
 
 void EventManager::notify(const Event& event, Process* process) {
     if (!process || event.Type >= EventType::COUNT) return;
-
-    // For each event queue in the process, check if it's filter has this
-    // event type enabled.
-    bool found = false;
-    for (auto& queue : process->EventQueues) {
-        // If it doesn't, we move on.
-        if (!queue.listens(event.Type, event.Filter)) continue;
-        // If it does, we push this event to the event queue.
-        std::print("Pushing event to event queue\n");
-        queue.push(event);
-        found = true;
-    }
-    // If none of the event queue's had this filter, then that means the
-    // book-keeping went wrong and we should remove this process from this
-    // Listeners[event.Type] vector.
-    if (!found) unregister_listener(event.Type, process->ProcessID);
+    for (auto* queue : process->Group->EventQueues)
+        if (auto* registration = queue->registration(event.Type, event.Filter))
+            queue->post(registration, &event.Data[0], sizeof(event.Data));
 }
 
 void EventManager::notify(const Event& event, pid_t pid) {
@@ -67,3 +51,129 @@ void EventManager::notify(const Event& event, pid_t pid) {
     return notify(event, process);
 }
 
+
+void EventSource::notify(EventType type, usz bytesAvailable) {
+    EventData_ReadyToReadWrite data{bytesAvailable};
+    for (auto* registration : Registrations)
+        if (registration->Type == type)
+            registration->Queue->post(registration, &data, sizeof(data));
+}
+
+void EventSource::detach() {
+    for (auto* registration : Registrations)
+        registration->Source = nullptr;
+    Registrations.clear();
+}
+
+
+void EventQueue::clear() {
+    for (auto& registrations : Registrations) {
+        while (registrations.size())
+            unregister_listening(registrations.back());
+    }
+}
+
+EventRegistration* EventQueue::register_listening(EventType e, EventFilter efilt, u32 flags, EventSource* source) {
+    if (e >= EventType::COUNT) return nullptr;
+    auto* r = registration(e, efilt);
+    if (!r) {
+        r = new EventRegistration;
+        r->Type = e;
+        r->Filter = efilt;
+        r->Queue = this;
+        Registrations[(size_t)e].push_back(r);
+    }
+    r->Flags = flags;
+    if (r->Source != source) {
+        if (r->Source) std::erase(r->Source->Registrations, r);
+        r->Source = source;
+        if (source) source->Registrations.push_back(r);
+    }
+    return r;
+}
+
+void EventQueue::unregister_listening(EventRegistration* r) {
+    if (!r) return;
+    if (r->Source) std::erase(r->Source->Registrations, r);
+    unlink_ready(r);
+    std::erase(Registrations[(size_t)r->Type], r);
+    delete r;
+}
+
+void EventQueue::make_ready(EventRegistration* r, const void* data, usz size) {
+    if (size > sizeof(r->Data)) size = sizeof(r->Data);
+    memcpy(&r->Data[0], data, size);
+    if (r->Ready) return;
+    r->Ready = true;
+    r->ReadyNext = nullptr;
+    r->ReadyPrevious = ReadyTail;
+    if (ReadyTail) ReadyTail->ReadyNext = r;
+    else ReadyHead = r;
+    ReadyTail = r;
+}
+
+void EventQueue::post(EventRegistration* r, const void* data, usz size) {
+    make_ready(r, data, size);
+    wake_queue_waiter(Group, ID);
+}
+
+EventRegistration* EventQueue::pop_ready() {
+    EventRegistration* r = ReadyHead;
+    unlink_ready(r);
+    return r;
+}
+
+void EventQueue::unlink_ready(EventRegistration* r) {
+    if (!r || !r->Ready) return;
+    if (r->ReadyPrevious) r->ReadyPrevious->ReadyNext = r->ReadyNext;
+    else ReadyHead = r->ReadyNext;
+    if (r->ReadyNext) r->ReadyNext->ReadyPrevious = r->ReadyPrevious;
+    else ReadyTail = r->ReadyPrevious;
+    r->ReadyNext = nullptr;
+    r->ReadyPrevious = nullptr;
+    r->Ready = false;
+}
+
+
+bool EventManager::add_timer(Process* process, const EventFilter& filter) {
+    if (!process || !filter.Timer.Milliseconds) return false;
+    for (auto* timer : process->Group->EventTimers)
+        if (timer->Filter == filter) return true;
+
+    auto* timer = new EventTimer;
+    timer->PID = process->ProcessID;
+    timer->Filter = filter;
+    timer->PeriodTicks = milliseconds_to_ticks(filter.Timer.Milliseconds);
+    timer->Entry.Data = timer;
+    timer->Entry.Function = [](Timer* entry) {
+        auto* timer = static_cast<EventTimer*>(entry->Data);
+        Event event;
+        event.Type = EventType::TIMER;
+        event.Filter = timer->Filter;
+        auto* data = reinterpret_cast<EventData_Timer*>(&event.Data[0]);
+        data->Tick = gTimerWheel.now();
+        // Re-arm first; periodic timers keep going until the process exits.
+        gTimerWheel.add_relative(&timer->Entry, timer->PeriodTicks);
+
+        gEvents.notify(event, timer->PID);
+    };
+    process->Group->EventTimers.push_back(timer);
+    gTimerWheel.add_relative(&timer->Entry, timer->PeriodTicks);
+    return true;
+}
+
+void EventManager::remove_timer(Process* process, const EventFilter& filter) {
+    if (!process) return;
+    for (auto* queue : process->Group->EventQueues)
+        if (queue->listens(EventType::TIMER, filter)) return;
+
+    auto& timers = process->Group->EventTimers;
+    for (usz i = 0; i < timers.size(); ++i) {
+        EventTimer* timer = timers[i];
+        if (!(timer->Filter == filter)) continue;
+        gTimerWheel.cancel(&timer->Entry);
+        timers.erase(timers.begin() + i);
+        delete timer;
+        return;
+    }
+}
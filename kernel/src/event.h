@@ -26,6 +26,7 @@
 #include <memory.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <timer_wheel.h>
 #include <vector>
 #include <vfs_forward.h>
 #include <extensions>
@@ -47,6 +48,8 @@ enum struct EventType : u32 {
     READY_TO_READ,
     // For sockets/pipes: space is available in the FIFO to write to.
     READY_TO_WRITE,
+    // A periodic timer registered with the event queue has expired.
+    TIMER,
     COUNT
 };
 
@@ -63,32 +66,23 @@ template<> struct hash<EventType> {
 
 struct Event;
 struct Process;
+union EventFilter;
 struct EventManager {
-    /// A map of event_type -> vector of pids of processes that have
-    /// event queues that are listening to this event type.
-    // FIXME: Maybe it's a better idea to keep a reference directly to
-    // the event queue that is listening, not just the processes. This
-    // would mean that A. we don't have to look up the process every
-    // time from PID and B. each process's event queue's wouldn't have
-    // to be iterated to find the one listening for the fired event.
-    // FIXME: The list of pids should be a set, not a vector.
-    std::unordered_map<EventType, std::vector<pid_t>> Listeners;
-
-    void register_listener(EventType event_type, pid_t new_listener) {
-        if (event_type >= EventType::COUNT) return;
-        if (std::find(Listeners[event_type].begin(), Listeners[event_type].end(), new_listener) != Listeners[event_type].end())
-            Listeners[event_type].push_back(new_listener);
-    }
-
-    bool unregister_listener(EventType event_type, pid_t new_listener) {
-        if (event_type >= EventType::COUNT) return false;
-        return std::erase(Listeners[event_type], new_listener);
-    }
-
-    void notify(const Event& event);
-
+    /// Deliver EVENT to every event queue of PROCESS with a
+    /// registration of the event's type and filter.
     void notify(const Event& event, Process* process);
     void notify(const Event& event, pid_t pid);
+
+    /// Start a periodic timer that pushes a TIMER event to the event
+    /// queues of the given process listening for the filter each time
+    /// it expires.
+    /// A process has at most one timer per filter, however many of it's
+    /// queues listen for it.
+    /// @return false iff the filter's period is zero.
+    bool add_timer(Process*, const EventFilter&);
+    /// Stop the timer behind the given filter, unless some event queue
+    /// of the process still listens for it.
+    void remove_timer(Process*, const EventFilter&);
 };
 
 extern EventManager gEvents;
@@ -98,6 +92,12 @@ union EventFilter {
 
     // Used by READY_TO_READ and READY_TO_WRITE event types.
     ProcFD ProcessFD { ProcFD::Invalid };
+    // Used by TIMER event type. ID is chosen by userspace to tell
+    // timers apart.
+    struct TimerFilter {
+        u32 ID;
+        u32 Milliseconds;
+    } Timer;
     /*
     struct PIDFD_T {
         pid_t PID;
@@ -110,9 +110,24 @@ union EventFilter {
     }
 };
 
+/// Flags given along with an event in kevent's changelist.
+enum EventFlag : u32 {
+    /// Level-triggered (the default) READY_TO_READ and READY_TO_WRITE
+    /// registrations are reported by every call to kevent for as long
+    /// as the file stays ready. Edge-triggered ones are reported once
+    /// each time the file becomes ready (i.e. for each write to or
+    /// read from it).
+    EVENT_FLAG_EDGE = 1u << 0,
+    /// The registration is removed once it has been reported.
+    EVENT_FLAG_ONESHOT = 1u << 1,
+    /// Remove the registration matching the type and filter.
+    EVENT_FLAG_DELETE = 1u << 2,
+};
+
 #define EVENT_MAX_SIZE 128
 struct Event {
     EventType Type = EventType::INVALID;
+    u32 Flags = 0;
     EventFilter Filter = {};
     u8 Data[EVENT_MAX_SIZE] = { 0 };
 };
@@ -122,60 +137,141 @@ struct EventData_ReadyToReadWrite {
     size_t BytesAvailable;
 };
 
-enum struct EventQueueHandle : int { Invalid = static_cast<int>(-1) };
+/// TIMER events have this data sent with them.
+struct EventData_Timer {
+    /// Tick count at which the timer expired.
+    u64 Tick;
+};
+
+enum struct EventQueueHandle : int {
+    Invalid = static_cast<int>(-1),
+    /// The queue `poll` registers it's interest on; see `Process::PollQueue`.
+    Poll = static_cast<int>(-2),
+};
+
+/// The timer behind a TIMER filter; owned by the process it notifies.
+struct EventTimer {
+    Timer Entry;
+    pid_t PID;
+    EventFilter Filter;
+    u64 PeriodTicks;
+};
+
+struct EventQueue;
+struct EventRegistration;
+struct ThreadGroup;
 
-template <size_t N>
+/// Something files become ready to read or write through (a pipe's
+/// buffer, a socket's FIFO, ...), along with the registrations of
+/// every event queue listening to one of those files. Becoming ready
+/// is delivered straight to those queues, without looking at anyone
+/// that isn't interested.
+struct EventSource {
+    std::vector<EventRegistration*> Registrations;
+
+    EventSource() = default;
+    /// Registrations belong to the file that was registered, so a copy
+    /// of the source (i.e. of a socket being accepted) starts out with
+    /// none.
+    EventSource(const EventSource&) {}
+    EventSource& operator=(const EventSource&) { return *this; }
+    ~EventSource() { detach(); }
+
+    /// Post a TYPE event with BYTES_AVAILABLE bytes to read or room to
+    /// write to every queue registered for it.
+    void notify(EventType type, usz bytesAvailable);
+
+    /// Forget about every registration; the source is going away (or
+    /// being reused for something else entirely).
+    void detach();
+};
+
+/// A filter an event queue is listening to, and how.
+struct EventRegistration {
+    EventType Type { EventType::INVALID };
+    EventFilter Filter;
+    u32 Flags { 0 };
+    EventQueue* Queue { nullptr };
+    /// For READY_TO_READ and READY_TO_WRITE, where the filter's file
+    /// reports it's readiness; see `FilesystemDriver::event_source`.
+    EventSource* Source { nullptr };
+
+    /// Whether this registration is on it's queue's ready list, and
+    /// the data of the event that will be reported for it.
+    bool Ready { false };
+    u8 Data[EVENT_MAX_SIZE] { 0 };
+    EventRegistration* ReadyNext { nullptr };
+    EventRegistration* ReadyPrevious { nullptr };
+};
+
+/// Events are kept as a list of registrations that are ready, so the
+/// queue never overflows, and a filter that becomes ready again before
+/// it has been collected is reported only once (with the latest data).
 struct EventQueue {
     // For now, used as a handle to find this particular event queue
     // within a process. In the future, we shouldn't need this, and
     // the handle should just be an index into some data structure,
     // or something.
     EventQueueHandle ID { EventQueueHandle::Invalid };
-    pid_t PID { pid_t(-1) };
-    std::ring_buffer<Event, N> Events;
+    /// The threads of this group blocked on the queue get woken up
+    /// when an event is posted to it.
+    ThreadGroup* Group { nullptr };
     // Yes, this is an array of vectors. The array index is the event
     // type as a size_t. This provides constant O(1) lookup on event
     // type. Then, we have a vector to store all of the filters that
     // are being listened to of that event type.
-    std::vector<EventFilter> Filter[(size_t)EventType::COUNT];
+    std::vector<EventRegistration*> Registrations[(size_t)EventType::COUNT];
 
-    EventQueue() {
-        memset(Filter, 0, sizeof(Filter));
-    }
+    EventQueue() = default;
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+    ~EventQueue() { clear(); }
 
-    void register_listening(EventType e, EventFilter efilt) {
-        if (e >= EventType::COUNT) return;
-        Filter[(size_t)e].push_back(efilt);
-        // Add PID to kernel event queue for this event type
-        gEvents.register_listener(e, PID);
-    }
+    /// Stop listening to anything at all.
+    void clear();
 
+    /// Start listening to EFILT for event type E, or change how it is
+    /// listened to if it already is.
+    /// @return The registration, or NULL if E is invalid.
+    EventRegistration* register_listening(EventType e, EventFilter efilt, u32 flags, EventSource* source);
+    void unregister_listening(EventRegistration*);
     void unregister_listening(EventType e, EventFilter efilt) {
-        if (e >= EventType::COUNT) return;
-        std::erase(Filter[(size_t)e], efilt);
-        // Remove PID from kernel event queue for this event type if there are
-        // no filters left.
-        if (!Filter[(size_t)e].size())
-            gEvents.unregister_listener(e, PID);
+        if (auto* r = registration(e, efilt)) unregister_listening(r);
     }
 
-    bool listens(EventType e, EventFilter efilt) const {
-        if (e >= EventType::COUNT) return false;
-        return Filter[(size_t)e].size() != 0 && std::find(Filter[(size_t)e].begin(), Filter[(size_t)e].end(), efilt) != Filter[(size_t)e].end();
+    /// @return The registration of EFILT for event type E, if any.
+    EventRegistration* registration(EventType e, EventFilter efilt) {
+        if (e >= EventType::COUNT) return nullptr;
+        for (auto* registration : Registrations[(size_t)e])
+            if (registration->Filter == efilt) return registration;
+        return nullptr;
     }
 
-    void push(const Event& e) {
-        Events.push_back(e);
+    bool listens(EventType e, EventFilter efilt) {
+        return registration(e, efilt);
     }
 
-    Event pop() {
-        if (Events.size()) return Events.pop_front();
-        return { EventType::INVALID, {}, { 0 } };
-    }
+    /// Make the event of REGISTRATION, with the given DATA, ready to be
+    /// collected, and wake up whoever is waiting on the queue. If it
+    /// already is, only the data is updated.
+    void post(EventRegistration*, const void* data, usz size);
+    /// Like `post`, without waking anyone up.
+    void make_ready(EventRegistration*, const void* data, usz size);
+
+    /// @return The oldest ready registration, taken off the ready
+    ///   list, or NULL if there are none.
+    EventRegistration* pop_ready();
+    EventRegistration* last_ready() { return ReadyTail; }
 
     bool has_events() {
-        return Events.size();
+        return ReadyHead;
     }
+
+private:
+    EventRegistration* ReadyHead { nullptr };
+    EventRegistration* ReadyTail { nullptr };
+
+    void unlink_ready(EventRegistration*);
 };
 
 #endif /* LENSOR_OS_EVENT_H */
@@ -0,0 +1,73 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <futex.h>
+
+#include <integers.h>
+#include <scheduler.h>
+
+namespace Futex {
+    /// Each bucket is an intrusive, singly linked list of the processes
+    /// waiting on any futex that hashes to it, oldest first.
+    constexpr usz BucketCount = 64;
+    Process* Buckets[BucketCount] {};
+
+    static usz bucket(usz physicalAddress) {
+        // Futex words are 4-byte aligned; the low bits carry nothing.
+        u64 hash = (physicalAddress >> 2) * 0x9e3779b97f4a7c15;
+        return hash >> (64 - 6);
+    }
+    static_assert(BucketCount == 1 << 6, "Futex hash shift must match bucket count");
+
+    void wait(Process* process, usz physicalAddress) {
+        process->FutexAddress = physicalAddress;
+        process->FutexNext = nullptr;
+        Process** link = &Buckets[bucket(physicalAddress)];
+        while (*link) link = &(*link)->FutexNext;
+        *link = process;
+    }
+
+    usz wake(usz physicalAddress, usz count) {
+        usz woken = 0;
+        Process** link = &Buckets[bucket(physicalAddress)];
+        while (*link && woken < count) {
+            Process* process = *link;
+            if (process->FutexAddress != physicalAddress) {
+                link = &process->FutexNext;
+                continue;
+            }
+            *link = process->FutexNext;
+            process->FutexNext = nullptr;
+            process->FutexAddress = 0;
+            process->unblock(true, 0);
+            ++woken;
+        }
+        return woken;
+    }
+
+    void cancel(Process* process) {
+        if (!process->FutexAddress) return;
+        Process** link = &Buckets[bucket(process->FutexAddress)];
+        while (*link && *link != process)
+            link = &(*link)->FutexNext;
+        if (*link) *link = process->FutexNext;
+        process->FutexNext = nullptr;
+        process->FutexAddress = 0;
+    }
+}
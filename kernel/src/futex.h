@@ -0,0 +1,55 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_FUTEX_H
+#define LENSOR_OS_FUTEX_H
+
+#include <integers.h>
+
+struct Process;
+
+/// Fast userspace mutexes: userspace does all of the locking with
+/// atomic operations on a 32-bit word, and only asks the kernel to
+/// sleep when it has to wait, or to wake up waiters when it knows there
+/// are some. Waiters are keyed by the physical address of the word, so
+/// the same futex may be used from different address spaces.
+namespace Futex {
+    enum Operation {
+        /// Sleep iff the word still holds the expected value.
+        WAIT = 0,
+        /// Wake up to the given number of waiters.
+        WAKE = 1,
+    };
+
+    /// Add the process to the waiters of the futex at the given physical
+    /// address. The caller is responsible for putting it to sleep.
+    void wait(Process*, usz physicalAddress);
+
+    /// Make up to `count` processes waiting on the futex at the given
+    /// physical address runnable again, in the order they started
+    /// waiting. Woken processes return zero from their wait.
+    /// @return The number of processes woken.
+    usz wake(usz physicalAddress, usz count);
+
+    /// Remove the process from whatever futex it is waiting on, if any
+    /// (i.e. when it is destroyed).
+    void cancel(Process*);
+}
+
+#endif /* LENSOR_OS_FUTEX_H */
@@ -158,8 +158,9 @@ struct GDT {
     GDTEntry Null;      // 0x00
     GDTEntry Ring0Code; // 0x08
     GDTEntry Ring0Data; // 0x10
-    GDTEntry Ring3Code; // 0x18
-    GDTEntry Ring3Data; // 0x20
+    // User data comes before user code, as `sysret` requires it.
+    GDTEntry Ring3Data; // 0x18
+    GDTEntry Ring3Code; // 0x20
     TSS_GDTEntry TSS;   // 0x28, 0x30
 } __attribute__((aligned(0x1000)));
 
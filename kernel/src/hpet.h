@@ -128,7 +128,7 @@ public:
     void print_state();
 
 private:
-    Spinlock Lock;
+    Spinlock Lock { "HPET" };
     ACPI::HPETHeader* Header { nullptr };
     bool Initialized { false };
     bool LargeCounterSupport { false };
@@ -147,7 +147,7 @@ static void handle_direct_input(char input) {
         Process* init = SYSTEM->init_process();
         if (init) {
             auto fd = static_cast<ProcFD>(0);
-            auto sysfd = init->FileDescriptors[fd];
+            auto sysfd = init->Group->FileDescriptors[fd];
             auto f = SYSTEM->virtual_filesystem().file(*sysfd);
             if (f) f->filesystem_driver()->write(f.get(), 0, sizeof(char), &input);
             return;
@@ -243,6 +243,17 @@ void divide_by_zero_handler(InterruptFrame* frame) {
     hang();
 }
 
+/// Raised by the first FPU/SSE/AVX instruction executed while CR0.TS is
+/// set, which the scheduler does whenever the process being switched to
+/// doesn't own the FPU registers.
+__attribute__((interrupt))
+void device_not_available_handler(InterruptFrame* frame) {
+    if (!Scheduler::fpu_trap()) {
+        panic(frame, "Device not available (#NM) with no process to give the FPU to!");
+        hang();
+    }
+}
+
 enum class PageFaultErrorCode {
     Present                                   = 1 << 0,
     ReadWrite                                 = 1 << 1,
@@ -533,3 +544,8 @@ __attribute__((no_caller_saved_registers))
 void scheduler_switch(CPUState* cpu) {
     Scheduler::switch_process(cpu);
 };
+
+__attribute__((no_caller_saved_registers))
+void scheduler_reschedule(CPUState* cpu) {
+    Scheduler::reschedule(cpu);
+};
@@ -127,6 +127,7 @@ void rtc_handler          (InterruptFrame*);
 void mouse_handler        (InterruptFrame*);
 // EXCEPTION HANDLING
 void divide_by_zero_handler           (InterruptFrame*);
+void device_not_available_handler     (InterruptFrame*);
 void double_fault_handler             (InterruptFrameError*);
 void stack_segment_fault_handler      (InterruptFrameError*);
 void general_protection_fault_handler (InterruptFrameError*);
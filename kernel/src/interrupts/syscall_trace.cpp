@@ -0,0 +1,143 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <interrupts/syscall_trace.h>
+
+#include <interrupts/syscalls.h>
+#include <memory.h>
+#include <scheduler.h>
+#include <tsc.h>
+#include <x86_64/cpu.h>
+
+static_assert(sizeof(SyscallTrace::Record) == 96, "SyscallTrace::Record layout must match libc's systrace_record");
+static_assert(sizeof(SyscallTrace::Statistics) == 152, "SyscallTrace::Statistics layout must match libc's systrace_stats");
+
+constinit bool syscall_tracing { false };
+
+namespace SyscallTrace {
+    constinit Record Ring[RingSize] {};
+    /// Sequence number of the next record to be written.
+    constinit u64 Head { 0 };
+
+    constinit Statistics Stats[LENSOR_OS_NUM_SYSCALLS] {};
+    constinit bool Counting { false };
+    /// How many processes are being traced.
+    constinit usz Traced { 0 };
+
+    static void update() {
+        syscall_tracing = Counting or Traced;
+    }
+
+    void set_traced(Process* process, bool traced) {
+        if (process->Traced == traced) return;
+        process->Traced = traced;
+        if (traced) Traced += 1;
+        else Traced -= 1;
+        update();
+    }
+
+    void set_counting(bool counting) {
+        Counting = counting;
+        update();
+    }
+
+    void reset_statistics() {
+        memset(Stats, 0, sizeof(Stats));
+    }
+
+    static void finish(Process* process, u64 result) {
+        Call& call = process->Syscall;
+        call.Pending = false;
+        u64 now = TSC::read();
+
+        if (Counting and call.Number < LENSOR_OS_NUM_SYSCALLS) {
+            Statistics& stats = Stats[call.Number];
+            u64 took = now - call.EntryTSC;
+            stats.Count += 1;
+            stats.TotalTime += took;
+            if (took > stats.MaxTime) stats.MaxTime = took;
+            usz bucket = 0;
+            for (u64 ns = TSC::to_nanoseconds(took) >> 7; ns && bucket < HistogramBuckets - 1; ns >>= 1)
+                bucket += 1;
+            stats.Histogram[bucket] += 1;
+        }
+
+        if (process->Traced) {
+            Record& record = Ring[Head % RingSize];
+            record.Sequence = Head++;
+            record.PID = process->ProcessID;
+            record.Number = call.Number;
+            memcpy(record.Arguments, call.Arguments, sizeof(call.Arguments));
+            record.Result = s64(result);
+            record.EntryTSC = call.EntryTSC;
+            record.ExitTSC = now;
+        }
+    }
+
+    void complete(Process* process, u64 result) {
+        if (process->Syscall.Pending)
+            finish(process, result);
+    }
+
+    void resume(Process* process) {
+        complete(process, process->CPU.RAX);
+    }
+
+    usz read(u64& cursor, Record* out, usz count) {
+        if (Head > RingSize and cursor < Head - RingSize)
+            cursor = Head - RingSize;
+        usz copied = 0;
+        for (; copied < count and cursor < Head; ++copied, ++cursor)
+            out[copied] = Ring[cursor % RingSize];
+        return copied;
+    }
+
+    usz statistics(Statistics* out, usz count) {
+        if (count > LENSOR_OS_NUM_SYSCALLS) count = LENSOR_OS_NUM_SYSCALLS;
+        for (usz i = 0; i < count; ++i) {
+            out[i] = Stats[i];
+            out[i].TotalTime = TSC::to_nanoseconds(out[i].TotalTime);
+            out[i].MaxTime = TSC::to_nanoseconds(out[i].MaxTime);
+        }
+        return count;
+    }
+}
+
+void syscall_trace_enter(CPUState* cpu, u64 fourthArgument) {
+    Process* process = Scheduler::CurrentProcess->value();
+    if (not SyscallTrace::Counting and not process->Traced) return;
+    SyscallTrace::Call& call = process->Syscall;
+    call.Pending = true;
+    call.Number = cpu->RAX;
+    call.Arguments[0] = cpu->RDI;
+    call.Arguments[1] = cpu->RSI;
+    call.Arguments[2] = cpu->RDX;
+    call.Arguments[3] = fourthArgument;
+    call.Arguments[4] = cpu->R8;
+    call.Arguments[5] = cpu->R9;
+    // Taken last, so as not to count any of the above.
+    call.EntryTSC = TSC::read();
+}
+
+u64 syscall_trace_exit(u64 result) {
+    // NOTE: This is the process that made the call, as only calls that
+    // block switch processes, and those never return here.
+    SyscallTrace::complete(Scheduler::CurrentProcess->value(), result);
+    return result;
+}
@@ -0,0 +1,119 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_SYSCALL_TRACE_H
+#define LENSOR_OS_SYSCALL_TRACE_H
+
+#include <integers.h>
+
+struct CPUState;
+struct Process;
+
+/// Records of the system calls made by traced processes, kept in a
+/// ring that userspace may read (i.e. `systrace`), and counts and
+/// latency histograms of every system call made by anyone. Neither
+/// costs anything while nothing is traced and counting is off, as the
+/// system call handlers only call in here while `syscall_tracing` is
+/// set.
+namespace SyscallTrace {
+    /// The layout must match that of `struct systrace_record` in libc.
+    struct Record {
+        /// Counts up from zero; a gap means records were overwritten
+        /// before they were read.
+        u64 Sequence;
+        u64 PID;
+        u64 Number;
+        u64 Arguments[6];
+        /// What the process was returned, which may be set long after
+        /// the call was made, for calls that block.
+        s64 Result;
+        u64 EntryTSC;
+        u64 ExitTSC;
+    };
+
+    static constexpr usz HistogramBuckets = 16;
+
+    /// The layout must match that of `struct systrace_stats` in libc.
+    /// Kept in time stamp counter cycles, and converted to nanoseconds
+    /// when copied out to userspace.
+    struct Statistics {
+        u64 Count;
+        u64 TotalTime;
+        u64 MaxTime;
+        /// Bucket zero counts calls that took less than 128ns, bucket N
+        /// those that took [2^(N+6), 2^(N+7)) nanoseconds, and the last
+        /// bucket everything longer.
+        u64 Histogram[HistogramBuckets];
+    };
+
+    /// The system call a process is in the middle of, if any.
+    struct Call {
+        bool Pending { false };
+        u64 Number { 0 };
+        u64 Arguments[6] {};
+        u64 EntryTSC { 0 };
+    };
+
+    static constexpr usz RingSize = 512;
+
+    /// What `sys$45_systrace` may be asked to do; these must match the
+    /// values of `SYSTRACE_*` in libc.
+    enum Operation : u64 {
+        /// Start (or stop) tracing the given process.
+        TRACE = 0,
+        /// Start (or stop) counting every system call.
+        COUNT = 1,
+        /// Copy records out of the ring; see `read`.
+        READ = 2,
+        /// Copy statistics out; see `statistics`.
+        STATISTICS = 3,
+        RESET = 4,
+    };
+
+    /// Record the system calls made by PROCESS, or stop doing so.
+    void set_traced(Process*, bool);
+    /// Keep statistics of every system call, or stop doing so.
+    void set_counting(bool);
+    void reset_statistics();
+
+    /// Finish the call PROCESS is in the middle of, if any, as having
+    /// returned RESULT.
+    void complete(Process*, u64 result);
+    /// Called when switching to PROCESS; completes a call it blocked in
+    /// with whatever it is being returned.
+    void resume(Process*);
+
+    /// Copy up to COUNT records from the ring into OUT, starting with
+    /// the one numbered CURSOR (or the oldest there is, if that has
+    /// been overwritten), and move CURSOR past them.
+    /// @return The number of records copied.
+    usz read(u64& cursor, Record* out, usz count);
+    /// Copy the statistics of up to COUNT system calls, in order of
+    /// number, into OUT.
+    /// @return The number of entries copied.
+    usz statistics(Statistics* out, usz count);
+}
+
+/// Called from `syscalls.asm`, around every system call while set.
+extern "C" bool syscall_tracing;
+extern "C" void syscall_trace_enter(CPUState* cpu, u64 fourthArgument);
+/// Returns RESULT, so that it remains in RAX.
+extern "C" u64 syscall_trace_exit(u64 result);
+
+#endif /* LENSOR_OS_SYSCALL_TRACE_H */
@@ -23,9 +23,48 @@
 
 extern syscalls             ; Table of system call functions declared in "syscalls.h"
 extern num_syscalls         ; Number of system call functions defined within syscalls table.
+extern syscall_tracing      ; Set while system calls are traced or counted; see "syscall_trace.h".
+extern syscall_trace_enter
+extern syscall_trace_exit
+
+;;; Offsets within the saved `CPUState`; see `x86_64/cpu.h`.
+%define CPU_RCX 0x10
+%define CPU_RDX 0x18
+%define CPU_RSI 0x20
+%define CPU_RDI 0x28
+%define CPU_R8  0x38
+%define CPU_R9  0x40
+%define CPU_R10 0x48
+%define CPU_RAX 0x88
+
+;;; Call the system call in RAX, with the `CPUState` at RSP, by way of
+;;; `syscall_trace_enter` and `syscall_trace_exit`. The argument is the
+;;; offset of the saved register that holds the fourth argument. Every
+;;; argument is reloaded from the saved state, as the hooks are free to
+;;; clobber them.
+%macro TRACED_SYSTEM_CALL 1
+    mov rdi, rsp
+    mov rsi, [rsp + %1]
+    call syscall_trace_enter
+    mov rdi, [rsp + CPU_RDI]
+    mov rsi, [rsp + CPU_RSI]
+    mov rdx, [rsp + CPU_RDX]
+    mov rcx, [rsp + %1]
+    mov r8, [rsp + CPU_R8]
+    mov r9, [rsp + CPU_R9]
+    mov rax, [rsp + CPU_RAX]
+    lea r10, [rel syscalls]
+    mov r11, rsp
+    call [r10 + rax * 8]
+    mov rdi, rax
+    call syscall_trace_exit     ; Hands back the result in RAX.
+%endmacro
 
 do_swapgs:
-    cmp QWORD [rsp + 0x08], 0x08
+;;; Swap in the kernel's GS base when coming from userspace, and back
+;;; out when returning to it; the code segment of the interrupt frame
+;;; tells which. Above the return address are the frame's RIP, then CS.
+    cmp QWORD [rsp + 0x10], 0x08
     je skip_swap
     swapgs
 skip_swap:
@@ -62,6 +101,8 @@ system_call_handler_asm:
     push rbx
     push rsp
 ;;; Execute the system call.
+    cmp BYTE [rel syscall_tracing], 0
+    jne traced_system_call
     mov r11, rdx                ; mul and friends clobber RDX, we need to save it.
     mov rbx, 8                  ; 8 = sizeof(pointer) in 64 bit.
     mul rbx                     ; Get byte offset within syscall table of syscall entry.
@@ -70,6 +111,7 @@ system_call_handler_asm:
     mov rdx, r11                ; Restore clobbered RDX.
     mov r11, rsp
     call [rel r10]              ; Call function at syscalls table base address + syscall number offset.
+system_call_return:
 ;;; Restore CPU state, then return from interrupt.
     add rsp, 8                  ; Eat `rsp` off the stack.
     pop rbx
@@ -86,11 +128,111 @@ system_call_handler_asm:
     pop r13
     pop r14
     pop r15
-    pop fs
-    pop gs
+    add rsp, 8                  ; Eat `fs`; reloading it would clear the TLS base.
+    add rsp, 8                  ; Eat `gs`; reloading it would clear the GS base.
     add rsp, 8                  ; Eat `rax` off the stack.
     call do_swapgs
 invalid_syscall:                ; If system call code is invalid, jump directly to exit.
     iretq                       ; iretq -> interrupt return quad word (64 bit)
+traced_system_call:
+    TRACED_SYSTEM_CALL CPU_RCX
+    jmp system_call_return
 
 GLOBAL system_call_handler_asm
+
+;;; Offsets within `PerCPU`, found at the base of GS; see `x86_64/cpu.h`.
+%define PERCPU_KERNEL_STACK 0x00
+%define PERCPU_USER_STACK   0x08
+
+;;; Fast System Call Handler
+;;; Entered through the `syscall` instruction, with interrupts masked
+;;; (see `SFMASK` in `syscalls.cpp`). The CPU doesn't switch stacks or
+;;; save anything but RIP (into rcx) and RFLAGS (into r11), and so the
+;;; fourth argument is passed in r10 instead of rcx.
+;;; Registers Used:
+;;;   rax  --  System Call Code
+;;;
+;;; The same state is saved as in `system_call_handler_asm`, including
+;;; an interrupt frame, as blocking syscalls (and fork) store it in the
+;;; process, to be resumed later with `iretq` by the scheduler.
+system_call_fast_handler_asm:
+    swapgs
+    mov [gs:PERCPU_USER_STACK], rsp
+    mov rsp, [gs:PERCPU_KERNEL_STACK]
+    and rsp, -16                ; Aligned, as an interrupt would.
+;;; Interrupt frame.
+    push 0x18 | 0b11            ; SS: Ring 3 User Data
+    push QWORD [gs:PERCPU_USER_STACK]
+    push r11                    ; RFLAGS
+    push 0x20 | 0b11            ; CS: Ring 3 User Code
+    push rcx                    ; RIP
+    cmp rax, [rel num_syscalls]
+    jae fast_invalid_syscall
+    push rax
+    sub rsp, 16                 ; `gs` and `fs`, which are never restored.
+    push r15
+    push r14
+    push r13
+    push r12
+    push r11                    ; Clobbered by `sysret`; RFLAGS, as it will be then.
+    push r10
+    push r9
+    push r8
+    push rbp
+    push rdi
+    push rsi
+    push rdx
+    push rcx                    ; Clobbered by `sysret`; RIP, as it will be then.
+    push rbx
+    push rsp
+;;; Execute the system call.
+    cmp BYTE [rel syscall_tracing], 0
+    jne fast_traced_system_call
+    mov rcx, r10                ; 4th argument, where C++ expects it.
+    lea r10, [rel syscalls]
+    mov r11, rsp
+    call [r10 + rax * 8]
+fast_system_call_return:
+;;; Restore CPU state. Unlike `iretq`, `sysret` doesn't restore the
+;;; stack pointer, and takes RIP and RFLAGS from rcx and r11.
+    add rsp, 8                  ; Eat `rsp` off the stack.
+    pop rbx
+    add rsp, 8                  ; Eat `rcx`.
+    pop rdx
+    pop rsi
+    pop rdi
+    pop rbp
+    pop r8
+    pop r9
+    pop r10
+    add rsp, 8                  ; Eat `r11`.
+    pop r12
+    pop r13
+    pop r14
+    pop r15
+    add rsp, 16                 ; Eat `fs` and `gs`.
+    add rsp, 8                  ; Eat `rax`; it holds the return value.
+;;; The system call may have changed where to return to. `sysret` can
+;;; only return to 64-bit user code, and faults in ring 0 (!) given a
+;;; non-canonical RIP; leave anything else to `iretq`.
+    cmp QWORD [rsp + 0x08], 0x20 | 0b11
+    jne fast_return_iretq
+    mov rcx, [rsp]              ; RIP
+    mov r11, rcx
+    shl r11, 16
+    sar r11, 16
+    cmp r11, rcx
+    jne fast_return_iretq
+    mov r11, [rsp + 0x10]       ; RFLAGS
+    mov rsp, [rsp + 0x18]       ; RSP
+    swapgs
+    o64 sysret
+fast_invalid_syscall:
+fast_return_iretq:
+    swapgs
+    iretq
+fast_traced_system_call:
+    TRACED_SYSTEM_CALL CPU_R10
+    jmp fast_system_call_return
+
+GLOBAL system_call_fast_handler_asm
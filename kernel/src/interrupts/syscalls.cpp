@@ -35,6 +35,9 @@
 #include <elf_loader.h>
 #include <event.h>
 #include <file.h>
+#include <futex.h>
+#include <io_ring.h>
+#include <interrupts/syscall_trace.h>
 #include <interrupts/syscalls.h>
 #include <linked_list.h>
 #include <memory/common.h>
@@ -47,8 +50,12 @@
 #include <storage/filesystem_drivers/socket.h>
 #include <storage/file_metadata.h>
 #include <time.h>
+#include <tsc.h>
+#include <tss.h>
 #include <virtual_filesystem.h>
 #include <vfs_forward.h>
+#include <x86_64/cpu.h>
+#include <x86_64/msr.h>
 
 // Uncomment the following directive for extra debug information output.
 //#define DEBUG_SYSCALLS
@@ -80,6 +87,90 @@ void sys$1_close(ProcessFileDescriptor fd) {
     SYSTEM->virtual_filesystem().close(fd);
 }
 
+/// Passed as the position to `read_file` and `write_file` to use the
+/// "cursor" of the file metadata, and move it forward past whatever
+/// was read or written.
+constexpr usz CurrentOffset = usz(-1);
+
+/// Read from the file at FD into BUFFER, starting POSITION bytes into
+/// the file.
+/// @return The number of bytes read, -1 on error, or -2 if the caller
+///   should block until there is something to read.
+static ssz read_file(ProcFD fd, u8* buffer, u64 byteCount, usz position = CurrentOffset) {
+    VFS& vfs = SYSTEM->virtual_filesystem();
+    auto meta = vfs.file(fd);
+    if (not meta) return -1;
+
+    usz offset = position == CurrentOffset ? meta->offset : position;
+
+    // If we have read the entire file, offset will be equal to (or greater
+    // than) the file's size. This means there is nothing to possibly read.
+    if (offset >= meta->file_size())
+        return 0;
+
+    // Truncate a read that would attempt to read past the end of the file.
+    if (offset + byteCount > meta->file_size())
+        byteCount = meta->file_size() - offset;
+
+    ssz rc = vfs.pread(fd, buffer, byteCount, offset);
+
+    // If data was read, move the "cursor" of the file metadata forward, so
+    // that next time we read we will get new data.
+    if (rc > 0 and position == CurrentOffset)
+        meta->offset += rc;
+
+    return rc;
+}
+
+/// Write BUFFER to the file at FD, starting POSITION bytes into the
+/// file.
+/// @return The number of bytes written, -1 on error, or -2 if the
+///   caller should block until there is room to write.
+static ssz write_file(ProcFD fd, u8* buffer, u64 byteCount, usz position = CurrentOffset) {
+    VFS& vfs = SYSTEM->virtual_filesystem();
+    if (position != CurrentOffset)
+        return vfs.pwrite(fd, buffer, byteCount, position);
+
+    ssz rc = vfs.write(fd, buffer, byteCount, 0);
+
+    // If data was written, move the "cursor" of the file metadata
+    // forward, so that next time we write it goes after this.
+    if (rc > 0) {
+        if (auto meta = vfs.file(fd))
+            meta->offset += rc;
+    }
+
+    return rc;
+}
+
+/// Put the current process to sleep until whoever is waiting on the
+/// file at FD (to be written to, or read from) wakes it up, at which
+/// point the syscall returns -2 so that it is retried. If TIMEOUT is
+/// set, give up after the file's timeout, if it has one.
+[[noreturn]] static void sleep_on_file(CPUState* cpu, ProcFD fd, bool timeout) {
+    auto* process = Scheduler::CurrentProcess->value();
+
+    // Save CPU state so that we will return to the right spot when
+    // the process is run again.
+    memcpy(&process->CPU, cpu, sizeof(CPUState));
+
+    // NOTE: The file metadata shared pointer must be gone by the time
+    // we yield, or it would never get cleaned up.
+    usz milliseconds = 0;
+    if (auto meta = SYSTEM->virtual_filesystem().file(fd))
+        milliseconds = meta->timeout;
+    if (timeout and milliseconds)
+        process->set_timeout(milliseconds_to_ticks(milliseconds), usz(-1));
+
+    // Set state to SLEEPING so that after we yield, the scheduler
+    // won't switch back to us until the file has been written to,
+    // or something of that nature.
+    process->State = Process::SLEEPING;
+
+    // Bye!
+    Scheduler::yield();
+}
+
 int sys$2_read(ProcessFileDescriptor fd, u8* buffer, u64 byteCount) {
     CPUState* cpu = nullptr;
     asm volatile ("mov %%r11, %0\n"
@@ -101,41 +192,9 @@ int sys$2_read(ProcessFileDescriptor fd, u8* buffer, u64 byteCount) {
         return 0;
     }
 
-    VFS& vfs = SYSTEM->virtual_filesystem();
-    auto meta = vfs.file(fd);
-
-    // If we have read the entire file, offset will be equal to (or greater
-    // than) the file's size. This means there is nothing to possibly read.
-    if (meta->offset >= meta->file_size())
-        return 0;
-
-    // Truncate a read that would attempt to read past the end of the file.
-    if (meta->offset + byteCount > meta->file_size())
-        byteCount = meta->file_size() - meta->offset;
-
-    auto* process = Scheduler::CurrentProcess->value();
-
-    // NOTE: nothing in this flow may call yield itself, as the above file
-    // metadata shared pointer would become dangling and never get cleaned up.
-    ssz rc = vfs.read(fd, buffer, byteCount, 0);
-    if (rc == -2) {
-        // Save CPU state so that we will return to the right spot when
-        // the process is run again.
-        memcpy(&process->CPU, cpu, sizeof(CPUState));
-
-        // Set state to SLEEPING so that after we yield, the scheduler
-        // won't switch back to us until the file has been written to,
-        // or something of that nature.
-        process->State = Process::SLEEPING;
-
-        // Bye!
-        Scheduler::yield();
-    }
-
-    // If data was read, move the "cursor" of the file metadata forward, so
-    // that next time we read we will get new data.
-    if (rc > 0)
-        meta->offset += rc;
+    ssz rc = read_file(fd, buffer, byteCount);
+    // Give up on the read if nothing comes in before the file's timeout.
+    if (rc == -2) sleep_on_file(cpu, fd, true);
 
     return rc;
 }
@@ -161,27 +220,10 @@ int sys$3_write(ProcessFileDescriptor fd, u8* buffer, u64 byteCount) {
         return 0;
     }
 
-    VFS& vfs = SYSTEM->virtual_filesystem();
-
     // Save CPU state in case write blocks, aka calls yield.
     memcpy(&Scheduler::CurrentProcess->value()->CPU, cpu, sizeof(CPUState));
-    ssz rc = vfs.write(fd, buffer, byteCount, 0);
-    if (rc == -2) {
-        // Set state to SLEEPING so that after we yield, the scheduler
-        // won't switch back to us until the file has been written to,
-        // or something of that nature.
-        Scheduler::CurrentProcess->value()->State = Process::SLEEPING;
-
-        // Bye!
-        Scheduler::yield();
-    }
-
-    // If data was read, move the "cursor" of the file metadata forward, so
-    // that next time we read we will get new data.
-    if (rc > 0) {
-        auto meta = vfs.file(fd);
-        meta->offset += rc;
-    }
+    ssz rc = write_file(fd, buffer, byteCount);
+    if (rc == -2) sleep_on_file(cpu, fd, false);
 
     return rc;
 }
@@ -198,6 +240,8 @@ void sys$5_exit(int status) {
            , status
            );
     {
+        // Exiting ends every thread of the process, not just this one.
+        Scheduler::remove_other_threads(Scheduler::CurrentProcess->value(), status);
         pid_t pid = Scheduler::CurrentProcess->value()->ProcessID;
         bool success = Scheduler::remove_process(pid, status);
         if (not success){
@@ -238,8 +282,8 @@ void* sys$6_map(void* address, usz size, u64 flags) {
 
     // If address is NULL, pick an address to place memory at.
     if (not address) {
-        address = (void*)process->next_region_vaddr;
-        process->next_region_vaddr += pages * PAGE_SIZE;
+        address = (void*)process->Group->next_region_vaddr;
+        process->Group->next_region_vaddr += pages * PAGE_SIZE;
     }
 
     // FIXME: Major problem: we need to check for overlapping regions
@@ -275,7 +319,7 @@ void sys$7_unmap(void* address) {
     Process* process = Scheduler::CurrentProcess->value();
 
     // Search current process' memories for matching address.
-    auto* region = process->Memories.head();
+    auto* region = process->Group->Memories.head();
     for (; region; region = region->next())
         if (region->value().vaddr == address)
             break;
@@ -340,20 +384,22 @@ int sys$9_waitpid(pid_t pid) {
         return returnStatus;
     }
 
-    Process *process = Scheduler::process(pid);
+    // Waiting is on the process as a whole, which outlives it's
+    // original thread if that exits first.
+    ThreadGroup* group = Scheduler::thread_group(pid);
     // Return immediately if PID isn't valid.
     // FIXME: Return meaningful value here, or something. Basically, -1
     // may be returned by the waited-upon process. We need to return
     // something here or signify somehow before returning that waitpid had
     // this failure.
-    if (not process) {
+    if (not group) {
         std::print("[SYS$]:ERROR:waitpid: Could not find process at PID {}\n", pid);
         return -1;
     }
 
     DBGMSG("  pid {} waiting on {}\n\n", thisPID, pid);
     // Add to WAITING list of process that we are waiting for.
-    process->WaitingList.push_back(thisPID);
+    group->Waiters.push_back(thisPID);
 
     // Save cpu state into process cache so that we return to the
     // proper place when set off running again.
@@ -437,6 +483,9 @@ void sys$11_exec(const char *path, const char **args) {
             args_vector.push_back(s);
         }
 
+        // The new program starts out with a single thread: this one.
+        Scheduler::remove_other_threads(process, -1);
+
         // Replace current process with new process.
         bool success = ELF::ReplaceUserspaceElf64Process(process, fds.Process, args_vector);
         if (not success) {
@@ -465,7 +514,7 @@ void sys$12_repfd(ProcessFileDescriptor fd, ProcessFileDescriptor replaced) {
     bool result = SYSTEM->virtual_filesystem().dup2(process, fd, replaced);
     if (not result) {
         std::print("  ERROR OCCURED: repfd failed (pid={}  fd={}  replaced={})\n", process->ProcessID, fd, replaced);
-        for (const auto& [procfd, sysfd] : process->FileDescriptors.pairs())
+        for (const auto& [procfd, sysfd] : process->Group->FileDescriptors.pairs())
             std::print("  {}: {}\n", procfd, sysfd);
     }
     // TODO: Use result/handle error in some way.
@@ -704,6 +753,7 @@ int sys$20_listen(ProcFD socketFD, int backlog) {
     }
 
     data->ClientServer = SocketData::SERVER;
+    data->Listening = true;
     data->ConnectionQueue.reserve(backlog);
 
     std::print("[SYS$]:listen: socket {} in process {} is now listening!\n", socketFD, Scheduler::CurrentProcess->value()->ProcessID);
@@ -757,16 +807,12 @@ int sys$21_connect(ProcFD socketFD, const SocketAddress* givenAddress, usz addre
         std::print("[SYS$]:connect: server process associated with socket bound to address has closed; sorry!\n");
         return error;
     }
-    ProcFD serverProcFD = serverData->FD;
 
     serverData->ConnectionQueue.push_back(SocketConnection{data->Address, data, process->ProcessID});
     std::print("[SYS$]:connect: socket {} connected to address!\n", socketFD);
 
     // READY_TO_READ for a listening socket means a connection is waiting to be accepted.
-    Event e;
-    e.Type = EventType::READY_TO_READ;
-    e.Filter.ProcessFD = serverProcFD;
-    gEvents.notify(e, serverProcess);
+    serverData->Events.notify(EventType::READY_TO_READ, serverData->ConnectionQueue.size());
 
     // Unblock server socket's corresponding process, if needed.
     if (serverData->WaitingOnConnection) {
@@ -781,6 +827,41 @@ int sys$21_connect(ProcFD socketFD, const SocketAddress* givenAddress, usz addre
     return success;
 }
 
+/// Pop the first connection off of the queue of the listening socket
+/// DATA, which must not be empty.
+/// @return A file descriptor for the server's end of the connection.
+static ProcFD accept_connection(SocketData* data) {
+    /// Pop the first connection off the queue
+    SocketConnection connexion = data->ConnectionQueue.front();
+    data->ConnectionQueue.pop_front();
+
+    auto* clientProcess = Scheduler::process(connexion.Socket->PID);
+    if (not clientProcess) {
+        std::print("[SYS$]:accept:ERROR: Server could not get connecting client process at PID {} (maybe it was closed)...\n", connexion.Socket->PID);
+        return ProcFD::Invalid;
+    }
+
+    // Make a shallow copy of the client socket.
+    SocketData* client = new SocketData;
+    *client = *connexion.Socket;
+
+    // LENSOR sockets have an intrusive refcount...
+    if (client->Type == SocketType::LENSOR)
+        ((SocketBuffers*)client->Data)->RefCount++;
+
+    client->ClientServer = SocketData::SERVER;
+
+    /// Return a file descriptor that references the client's socket data, but
+    /// is a new file metadata.
+    auto f = FileMetadata::Make(FileMetadata::FileType::Regular, "client_socket", fsd(SYSTEM->virtual_filesystem().SocketsDriver), SOCKET_RX_BUFFER_SIZE, client);
+    auto fds = SYSTEM->virtual_filesystem().add_file(f);
+    if (fds.invalid()) {
+        std::print("[SYS$]:accept:ERROR: Could not add file to accept connection, sorry.\n");
+        return ProcFD::Invalid;
+    }
+    return fds.Process;
+}
+
 ProcFD sys$22_accept(ProcFD socketFD, const SocketAddress* address, usz* addressLength) {
     CPUState* cpu = nullptr;
     asm volatile ("mov %%r11, %0\n"
@@ -796,12 +877,14 @@ ProcFD sys$22_accept(ProcFD socketFD, const SocketAddress* address, usz* address
         return ProcFD::Invalid;
 
     SocketData* data = nullptr;
+    usz timeout = 0;
     {
         auto file = SYSTEM->virtual_filesystem().file(socketFD);
         if (not file) {
             std::print("[SYS$]:accept:ERROR: File descriptor invalid.\n");
             return ProcFD::Invalid;
         }
+        timeout = file->timeout;
 
         // TODO: Validate that socketFD actually refers to a socket.
 
@@ -813,35 +896,7 @@ ProcFD sys$22_accept(ProcFD socketFD, const SocketAddress* address, usz* address
 
     if (data->ConnectionQueue.size()) {
         std::print("[SYS$]:accept: Connection already exists, returning immediately\n");
-        /// Pop the first connection off the queue
-        SocketConnection connexion = data->ConnectionQueue.front();
-        data->ConnectionQueue.pop_front();
-
-        auto* clientProcess = Scheduler::process(connexion.Socket->PID);
-        if (not clientProcess) {
-            std::print("[SYS$]:accept:ERROR: Server could not get connecting client process at PID {} (maybe it was closed)...\n", connexion.Socket->PID);
-            return ProcFD::Invalid;
-        }
-
-        // Make a shallow copy of the client socket.
-        SocketData* data = new SocketData;
-        *data = *connexion.Socket;
-
-        // LENSOR sockets have an intrusive refcount...
-        if (data->Type == SocketType::LENSOR)
-            ((SocketBuffers*)data->Data)->RefCount++;
-
-        data->ClientServer = SocketData::SERVER;
-
-        /// Return a file descriptor that references the client's socket data, but
-        /// is a new file metadata.
-        auto f = FileMetadata::Make(FileMetadata::FileType::Regular, "client_socket", fsd(SYSTEM->virtual_filesystem().SocketsDriver), SOCKET_RX_BUFFER_SIZE, data);
-        auto fds = SYSTEM->virtual_filesystem().add_file(f);
-        if (fds.invalid()) {
-            std::print("[SYS$]:accept:ERROR: Could not add file to accept connection, sorry.\n");
-            return ProcFD::Invalid;
-        }
-        return fds.Process;
+        return accept_connection(data);
     }
     std::print("[SYS$]:accept: No waiting connections, blocking\n");
     // Block this process until a connection is made to this socket.
@@ -850,6 +905,8 @@ ProcFD sys$22_accept(ProcFD socketFD, const SocketAddress* address, usz* address
     // for some reason other than an incoming connection.
     memcpy(&process->CPU, cpu, sizeof(CPUState));
     process->set_return_value(usz(ProcFD::Invalid));
+    if (timeout)
+        process->set_timeout(milliseconds_to_ticks(timeout), usz(ProcFD::Invalid));
     process->State = Process::SLEEPING;
     Scheduler::yield();
 }
@@ -863,23 +920,127 @@ EventQueueHandle sys$23_kqueue() {
     /// Choose a handle
     // TODO: Better way of choosing handle.
     auto handle = EventQueueHandle::Invalid;
-    if (not process->EventQueues.size()) handle = EventQueueHandle(1);
-    else handle = EventQueueHandle((int)process->EventQueues.back().ID + 1);
+    if (not process->Group->EventQueues.size()) handle = EventQueueHandle(1);
+    else handle = EventQueueHandle((int)process->Group->EventQueues.back()->ID + 1);
 
     /// Add an event queue with the chosen handle to the process' event queues.
     if (handle != EventQueueHandle::Invalid) {
-        EventQueue<Process::EventQueueSize> queue;
-        queue.ID = handle;
-        process->EventQueues.push_back(std::move(queue));
+        auto* queue = new EventQueue;
+        queue->ID = handle;
+        queue->Group = process->Group.get();
+        process->Group->EventQueues.push_back(queue);
     }
 
     return handle;
 }
 
-int sys$24_kevent(EventQueueHandle handle, const Event* changelist, int numChanges, Event* eventlist, int maxEvents) {
+/// Find the queue that is referenced by HANDLE for PROCESS, if any.
+static EventQueue* event_queue(Process* process, EventQueueHandle handle) {
+    auto& queues = process->Group->EventQueues;
+    auto queue = std::find_if(queues.begin(), queues.end(), [&](const auto* q) {
+        return q->ID == handle;
+    });
+    if (queue == queues.end()) return nullptr;
+    return *queue;
+}
+
+/// @return How many bytes the file REGISTRATION (of the current
+///   process) listens to may be read or written without blocking, or
+///   -1 if it isn't ready; see `FilesystemDriver::ready`.
+static ssz readiness(const EventRegistration* registration) {
+    auto file = SYSTEM->virtual_filesystem().file(registration->Filter.ProcessFD);
+    if (not file) return -1;
+    return file->filesystem_driver()->ready(file.get(), registration->Type);
+}
+
+/// Fill EVENTLIST with up to MAX_EVENTS events that are ready in QUEUE.
+/// Level-triggered READY_TO_READ and READY_TO_WRITE registrations are
+/// checked again before being reported, and go back on the ready list
+/// for as long as their file stays ready; oneshot registrations are
+/// removed once reported.
+/// @return The number of events stored.
+static int collect_events(EventQueue* queue, Event* eventlist, int maxEvents) {
+    // Anything put back on the ready list is left for the next call.
+    EventRegistration* last = queue->last_ready();
+    int count = 0;
+    while (count < maxEvents) {
+        EventRegistration* registration = queue->pop_ready();
+        if (not registration) break;
+        bool wasLast = registration == last;
+
+        bool level = registration->Source and not (registration->Flags & EVENT_FLAG_EDGE);
+        ssz bytes = level ? readiness(registration) : 0;
+        if (bytes >= 0) {
+            Event& event = eventlist[count++];
+            event.Type = registration->Type;
+            event.Flags = registration->Flags;
+            event.Filter = registration->Filter;
+            memcpy(&event.Data[0], &registration->Data[0], sizeof(event.Data));
+            if (level) {
+                auto* data = reinterpret_cast<EventData_ReadyToReadWrite*>(&event.Data[0]);
+                data->BytesAvailable = usz(bytes);
+            }
+            if (registration->Flags & EVENT_FLAG_ONESHOT)
+                queue->unregister_listening(registration);
+            else if (level)
+                queue->make_ready(registration, &event.Data[0], sizeof(event.Data));
+        }
+        if (wasLast) break;
+    }
+    return count;
+}
+
+/// Apply the change to QUEUE of PROCESS that CHANGE describes.
+static void apply_event_change(Process* process, EventQueue* queue, const Event& change) {
+    if (change.Type >= EventType::COUNT) return;
+    if (change.Flags & EVENT_FLAG_DELETE) {
+        queue->unregister_listening(change.Type, change.Filter);
+        if (change.Type == EventType::TIMER)
+            gEvents.remove_timer(process, change.Filter);
+        return;
+    }
+
+    EventSource* source = nullptr;
+    if (change.Type == EventType::READY_TO_READ or change.Type == EventType::READY_TO_WRITE) {
+        auto file = SYSTEM->virtual_filesystem().file(change.Filter.ProcessFD);
+        if (not file) {
+            std::print("[SYS$]:kevent:ERROR: Refusing to listen to invalid file descriptor {}\n", change.Filter.ProcessFD);
+            return;
+        }
+        source = file->filesystem_driver()->event_source(file.get(), change.Type);
+    }
+    if (change.Type == EventType::TIMER
+        and not queue->listens(change.Type, change.Filter)
+        and not gEvents.add_timer(process, change.Filter)) {
+        std::print("[SYS$]:kevent:ERROR: Refusing to add timer with a period of zero\n");
+        return;
+    }
+    auto* registration = queue->register_listening(change.Type, change.Filter, change.Flags, source);
+    if (not registration or not source) return;
+
+    // Report a file that is ready already, rather than waiting for it to
+    // change first.
+    ssz bytes = readiness(registration);
+    if (bytes >= 0) {
+        EventData_ReadyToReadWrite data{usz(bytes)};
+        queue->post(registration, &data, sizeof(data));
+    }
+}
+
+/// @param timeoutMilliseconds
+///   How long to block waiting for an event when there are none
+///   ready. Zero returns immediately, and a negative value blocks
+///   until an event arrives.
+/// @return The number of events written to eventlist (zero on
+///   timeout), -2 if the call should be retried (without the
+///   changelist) because an event has arrived, or -1 on error.
+int sys$24_kevent(EventQueueHandle handle, const Event* changelist, int numChanges, Event* eventlist, int maxEvents, ssz timeoutMilliseconds) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
     DBGMSG(sys$_dbgfmt, 24, "kevent");
 
-    static constexpr const int success {0};
     static constexpr const int error {-1};
 
     if (handle == EventQueueHandle::Invalid) {
@@ -899,32 +1060,26 @@ int sys$24_kevent(EventQueueHandle handle, const Event* changelist, int numChang
         return error;
     }
 
-    // Find queue that is referenced by this handle for this process.
-    EventQueue<Process::EventQueueSize>* queue = std::find_if(process->EventQueues.begin(), process->EventQueues.end(), [&](const auto& q) {
-        return q.ID == handle;
-    });
+    auto* queue = event_queue(process, handle);
     if (not queue) return error;
 
     // Apply changes from changelist, if any.
-    // TODO: Allow for unregistering, we need a special event type for that.
-    for (int i = 0; i < numChanges; ++i) {
-        queue->register_listening(changelist[i].Type, changelist[i].Filter);
-    }
+    for (int i = 0; i < numChanges; ++i)
+        apply_event_change(process, queue, changelist[i]);
 
-    if (not queue->has_events()) {
-        // TODO:
-        // If there are no events in the queue, we must block until an
-        // event is ready in this queue. However, if there are no
-        // events being listened to by the queue, return.
-        return error;
-    }
-    // If there are events in the event queue already, we can fill the
-    // event list with up to maxEvents events, popping them off the event
-    // queue.
-    for (int i = 0; i < maxEvents and queue->has_events(); ++i)
-        *eventlist++ = queue->pop();
+    int count = collect_events(queue, eventlist, maxEvents);
+    if (count or not maxEvents or timeoutMilliseconds == 0)
+        return count;
 
-    return success;
+    // Block until an event is pushed to this queue or one of the files
+    // it listens to becomes ready, or we time out.
+    memcpy(&process->CPU, cpu, sizeof(CPUState));
+    process->set_return_value(0);
+    process->BlockedOnEventQueue = handle;
+    if (timeoutMilliseconds > 0)
+        process->set_timeout(milliseconds_to_ticks(timeoutMilliseconds), 0);
+    process->State = Process::SLEEPING;
+    Scheduler::yield();
 }
 
 // DirectoryEntry defined in `/kernel/src/storage/file_metadata.cpp`
@@ -949,6 +1104,917 @@ int sys$25_directory_data(const char* path, DirectoryEntry* dirp, usz count) {
     return vfs.directory_data(path, count, dirp);
 }
 
+/// Set the nice value of the process with the given PID, or of the
+/// calling process if PID is zero. Nice values range from -20 (most
+/// favourable) to 19 (least favourable).
+/// @return 0 on success, -1 if PID or nice is invalid.
+int sys$26_setpriority(pid_t pid, int nice) {
+    DBGMSG(sys$_dbgfmt, 26, "setpriority");
+    DBGMSG("  pid: {}, nice: {}\n\n", pid, nice);
+    if (pid == 0) pid = Scheduler::CurrentProcess->value()->ProcessID;
+    if (not Scheduler::set_priority(pid, nice)) {
+        std::print("[SYS$]:setpriority:ERROR: Could not set nice value of process {} to {}\n", pid, nice);
+        return -1;
+    }
+    return 0;
+}
+
+/// Block the calling process for at least the given amount of time.
+/// NOTE: Resolution is that of the system timer tick.
+int sys$27_nanosleep(u64 nanoseconds) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 27, "nanosleep");
+    DBGMSG("  nanoseconds: {}\n\n", nanoseconds);
+
+    if (not nanoseconds) return 0;
+
+    auto* process = Scheduler::CurrentProcess->value();
+    memcpy(&process->CPU, cpu, sizeof(CPUState));
+    process->set_timeout(nanoseconds_to_ticks(nanoseconds), 0);
+    process->State = Process::SLEEPING;
+    Scheduler::yield();
+}
+
+/// Set how long a blocking read or accept on the given file descriptor
+/// may wait before failing. Zero milliseconds means wait forever.
+int sys$28_timeout(ProcFD fd, usz milliseconds) {
+    DBGMSG(sys$_dbgfmt, 28, "timeout");
+    DBGMSG("  fd: {}, milliseconds: {}\n\n", fd, milliseconds);
+    auto file = SYSTEM->virtual_filesystem().file(fd);
+    if (not file) {
+        std::print("[SYS$]:timeout:ERROR: File descriptor invalid.\n");
+        return -1;
+    }
+    file->timeout = milliseconds;
+    return 0;
+}
+
+/// Loading a non-canonical address into FS_BASE faults in the kernel,
+/// so only addresses in the lower (user) half are accepted as a
+/// thread's TLS base.
+static bool valid_fs_base(u64 base) {
+    return base < 0x0000800000000000;
+}
+
+/// Start a new thread within the current process, running `entry(arg)`
+/// on the given stack. The new thread shares everything with the
+/// current one (memory, files, event queues), except for it's registers,
+/// it's stack, and the base of the FS segment, which is set to TLS.
+/// @param stackTop
+///   The initial stack pointer; it is used as-is, so it should be laid
+///   out as if `entry` were just called (i.e. `stackTop + 8` aligned to
+///   16 bytes).
+/// @return The thread ID (a PID) of the new thread, or -1 on failure.
+pid_t sys$29_thread_create(void* entry, void* arg, void* stackTop, void* tls) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 29, "thread_create");
+    DBGMSG("  entry: {}, arg: {}, stack: {}, tls: {}\n\n", entry, arg, stackTop, tls);
+
+    Process* process = Scheduler::CurrentProcess->value();
+    if (not process->valid_address(entry)
+        or not process->valid_address((u8*)stackTop - 1)) {
+        std::print("[SYS$]:thread_create:ERROR: Invalid entry point or stack: {}, {}\n", entry, stackTop);
+        return -1;
+    }
+    if (not valid_fs_base((u64)tls)) {
+        std::print("[SYS$]:thread_create:ERROR: Invalid TLS base: {}\n", tls);
+        return -1;
+    }
+
+    Process* thread = new Process;
+    thread->State = Process::ProcessState::SLEEPING;
+    // Must be set before the thread is added, so that it is counted
+    // among the group's threads.
+    thread->Group = process->Group;
+    Scheduler::add_process(thread);
+    thread->ParentProcess = process->ParentProcess;
+    thread->Nice = process->Nice;
+    thread->Weight = process->Weight;
+    thread->Affinity = process->Affinity;
+    SyscallTrace::set_traced(thread, process->Traced);
+    thread->CR3 = process->CR3;
+    thread->ExecutablePath = process->ExecutablePath;
+    thread->WorkingDirectory = process->WorkingDirectory;
+
+    // Same segments and flags as the calling thread, but starting fresh
+    // at the entry point.
+    memcpy(&thread->CPU, cpu, sizeof(CPUState));
+    thread->CPU.Frame.ip = (u64)entry;
+    thread->CPU.Frame.sp = (u64)stackTop;
+    thread->CPU.RSP = (u64)stackTop;
+    thread->CPU.RDI = (u64)arg;
+    thread->FSBase = (u64)tls;
+
+    Scheduler::make_runnable(thread);
+    return thread->ProcessID;
+}
+
+/// Exit the current thread only; the process as a whole exits along
+/// with it's last thread.
+void sys$30_thread_exit(int status) {
+    DBGMSG(sys$_dbgfmt, 30, "thread_exit");
+    DBGMSG("  status: {}\n\n", status);
+    pid_t tid = Scheduler::CurrentProcess->value()->ProcessID;
+    if (not Scheduler::remove_process(tid, status))
+        std::print("[SYS$]:thread_exit: Failure to remove thread {}\n", tid);
+    Scheduler::yield();
+}
+
+/// Wait for the thread with the given ID, within the current process,
+/// to exit, and return it's exit status. Each thread may only be
+/// joined once.
+int sys$31_thread_join(pid_t tid) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 31, "thread_join");
+    DBGMSG("  tid: {}\n\n", tid);
+
+    Process* process = Scheduler::CurrentProcess->value();
+    auto& exited = process->Group->ExitedThreads;
+    auto zombie = std::find_if(exited, [&tid](const auto& zombie) {
+        return zombie.PID == tid;
+    });
+    if (zombie != exited.end()) {
+        int returnStatus = zombie->ReturnStatus;
+        exited.erase(zombie);
+        return returnStatus;
+    }
+
+    Process* thread = Scheduler::process(tid);
+    if (not thread or thread == process or thread->Group != process->Group) {
+        std::print("[SYS$]:thread_join:ERROR: {} is not another thread of process {}\n", tid, process->Group->Leader);
+        return -1;
+    }
+
+    // The thread's exit status is handed to us when it is destroyed.
+    thread->WaitingList.push_back(process->ProcessID);
+    memcpy(&process->CPU, cpu, sizeof(CPUState));
+    process->State = Process::ProcessState::SLEEPING;
+    Scheduler::yield();
+}
+
+/// Wait on, or wake waiters of, the 32-bit futex word at ADDRESS.
+/// WAIT: sleep until woken, iff the word still holds VALUE. Returns 0
+///       when woken, or -2 straight away if the value differed (the
+///       caller should re-check whatever it was waiting for).
+/// WAKE: wake up to VALUE waiters, returning how many were woken.
+ssz sys$32_futex(u32* address, int operation, u32 value) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 32, "futex");
+    DBGMSG("  address: {}, operation: {}, value: {}\n\n", (void*)address, operation, value);
+
+    Process* process = Scheduler::CurrentProcess->value();
+    if (not process->valid_address(address) or (usz)address % alignof(u32)) {
+        std::print("[SYS$]:futex:ERROR: Invalid address: {}\n", (void*)address);
+        return -1;
+    }
+    // Keyed by physical address, so that shared memory works too.
+    usz paddr = (usz)Memory::physical_address(process->CR3, address);
+    if (not paddr) return -1;
+
+    switch (operation) {
+    case Futex::WAIT:
+        // Nothing can change the word between this check and going to
+        // sleep; interrupts are disabled, and there is one CPU.
+        if (*address != value) return -2;
+        Futex::wait(process, paddr);
+        memcpy(&process->CPU, cpu, sizeof(CPUState));
+        process->State = Process::ProcessState::SLEEPING;
+        Scheduler::yield();
+    case Futex::WAKE:
+        return (ssz)Futex::wake(paddr, value);
+    default:
+        return -1;
+    }
+}
+
+/// Set the base of the calling thread's FS segment; used for TLS.
+/// @return 0 on success, -1 if BASE isn't a user address.
+int sys$33_set_tls(void* base) {
+    DBGMSG(sys$_dbgfmt, 33, "set_tls");
+    DBGMSG("  base: {}\n\n", base);
+    if (not valid_fs_base((u64)base)) {
+        std::print("[SYS$]:set_tls:ERROR: Invalid TLS base: {}\n", base);
+        return -1;
+    }
+    Scheduler::set_fs_base(Scheduler::CurrentProcess->value(), (u64)base);
+    return 0;
+}
+
+/// Restrict the process with the given PID, or the calling process if
+/// PID is zero, to the CPUs set in MASK (bit N is CPU N). SIZE is the
+/// size of MASK in bytes; CPUs past the 64th are ignored.
+/// @return 0 on success, -1 if PID is invalid or no CPU in MASK is online.
+int sys$34_sched_setaffinity(pid_t pid, usz size, const u64* mask) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 34, "sched_setaffinity");
+    DBGMSG("  pid: {}, size: {}, mask: {}\n\n", pid, size, (void*)mask);
+    if (!mask || !size) return -1;
+    auto* caller = Scheduler::CurrentProcess->value();
+    if (not caller->valid_address(mask) or not caller->valid_address((const u8*)mask + size - 1)) {
+        std::print("[SYS$]:sched_setaffinity:ERROR: Invalid mask address: {}\n", (void*)mask);
+        return -1;
+    }
+    u64 cpus = 0;
+    memcpy(&cpus, mask, size < sizeof(u64) ? size : sizeof(u64));
+    if (pid == 0) pid = caller->ProcessID;
+    if (not Scheduler::set_affinity(pid, cpus)) return -1;
+    // Move off of this CPU straight away if no longer allowed on it.
+    auto* process = Scheduler::CurrentProcess->value();
+    if (pid == process->ProcessID && !(cpus & (u64(1) << Scheduler::this_cpu()))) {
+        memcpy(&process->CPU, cpu, sizeof(CPUState));
+        process->CPU.RAX = 0;
+        Scheduler::yield();
+    }
+    return 0;
+}
+
+/// Store the CPUs the process with the given PID (or the calling
+/// process, if zero) may run on in MASK, which is SIZE bytes.
+/// Only CPUs that are online are included.
+/// @return The number of bytes stored, or -1.
+ssz sys$35_sched_getaffinity(pid_t pid, usz size, u64* mask) {
+    DBGMSG(sys$_dbgfmt, 35, "sched_getaffinity");
+    DBGMSG("  pid: {}, size: {}, mask: {}\n\n", pid, size, (void*)mask);
+    if (!mask || size < sizeof(u64)) return -1;
+    auto* caller = Scheduler::CurrentProcess->value();
+    if (not caller->valid_address(mask) or not caller->valid_address((u8*)mask + size - 1)) {
+        std::print("[SYS$]:sched_getaffinity:ERROR: Invalid mask address: {}\n", (void*)mask);
+        return -1;
+    }
+    Process* process = pid == 0 ? caller : Scheduler::process(pid);
+    if (!process) return -1;
+    *mask = process->Affinity & Scheduler::online_cpus();
+    return sizeof(u64);
+}
+
+/// Copy the scheduler statistics of the process with the given PID, or
+/// of the calling process if PID is zero, into STATS. Times are given
+/// in nanoseconds.
+/// @return 0 on success, -1 if PID or STATS is invalid.
+int sys$36_sched_stats(pid_t pid, SchedulerStats* stats) {
+    DBGMSG(sys$_dbgfmt, 36, "sched_stats");
+    DBGMSG("  pid: {}, stats: {}\n\n", pid, (void*)stats);
+    auto* caller = Scheduler::CurrentProcess->value();
+    if (not caller->valid_address(stats) or not caller->valid_address((u8*)(stats + 1) - 1)) {
+        std::print("[SYS$]:sched_stats:ERROR: Invalid stats address: {}\n", (void*)stats);
+        return -1;
+    }
+    if (pid == 0) pid = caller->ProcessID;
+    SchedulerStats out;
+    if (not Scheduler::stats(pid, out)) return -1;
+    out.Runtime = TSC::to_nanoseconds(out.Runtime);
+    out.WaitTime = TSC::to_nanoseconds(out.WaitTime);
+    out.MaxWaitTime = TSC::to_nanoseconds(out.MaxWaitTime);
+    out.WakeupLatency = TSC::to_nanoseconds(out.WakeupLatency);
+    out.MaxWakeupLatency = TSC::to_nanoseconds(out.MaxWakeupLatency);
+    memcpy(stats, &out, sizeof(SchedulerStats));
+    return 0;
+}
+
+/// Map submission and completion rings into the calling process, with
+/// room for ENTRIES submissions (rounded up to a power of two, at most
+/// `IORing::MaxEntries`) and twice as many completions. The rings follow
+/// the returned header, at the offsets given within it.
+/// @return The address of the header, or NULL if ENTRIES is invalid or
+///   the process already has rings.
+IORingHeader* sys$37_io_setup(u32 entries) {
+    DBGMSG(sys$_dbgfmt, 37, "io_setup");
+    DBGMSG("  entries: {}\n\n", entries);
+    Process* process = Scheduler::CurrentProcess->value();
+    IORingHeader* header = process->Group->Ring.setup(process, entries);
+    if (not header)
+        std::print("[SYS$]:io_setup:ERROR: Could not set up rings of {} entries for process {}\n", entries, process->ProcessID);
+    return header;
+}
+
+/// The most events a single KEVENT submission collects at once.
+constexpr u64 IORingEventMax = 1024;
+
+/// Carry out a submission from PROCESS' rings, just like the equivalent
+/// syscall would, except without ever blocking.
+/// @return What to complete it with, or -2 if it would have blocked.
+static ssz io_ring_perform(Process* process, const IORingSubmission& submission) {
+    ProcFD fd = ProcFD(ssz(submission.FD));
+    void* address = (void*)submission.Address;
+    switch (submission.Op) {
+    case IORingSubmission::NOP:
+        return 0;
+
+    case IORingSubmission::READ:
+        if (not process->valid_address(address)) return -1;
+        return read_file(fd, (u8*)address, submission.Length);
+
+    case IORingSubmission::WRITE:
+        if (not process->valid_address(address)) return -1;
+        return write_file(fd, (u8*)address, submission.Length);
+
+    case IORingSubmission::ACCEPT: {
+        SocketData* data = nullptr;
+        if (auto file = SYSTEM->virtual_filesystem().file(fd))
+            data = (SocketData*)file->driver_data();
+        if (not data) return -1;
+        if (data->ConnectionQueue.size())
+            return ssz(accept_connection(data));
+        // `connect` wakes us up once there is something to accept.
+        data->WaitingOnConnection = true;
+        return -2;
+    }
+
+    case IORingSubmission::CONNECT:
+        if (not process->valid_address(address)
+            or submission.Length > sizeof(SocketAddress))
+            return -1;
+        return sys$21_connect(fd, (const SocketAddress*)address, submission.Length);
+
+    case IORingSubmission::KEVENT: {
+        auto handle = EventQueueHandle(submission.FD);
+        auto* queue = event_queue(process, handle);
+        if (not queue) return -1;
+        u64 length = std::min(submission.Length, IORingEventMax);
+        if (length and (not process->valid_address(address)
+                        or not process->valid_address((u8*)((Event*)address + length) - 1)))
+            return -1;
+        ssz count = collect_events(queue, (Event*)address, int(length));
+        if (not count) {
+            // NOTE: Only the last of these waiting on a queue gets the
+            // process woken up when an event comes in.
+            process->BlockedOnEventQueue = handle;
+            return -2;
+        }
+        return count;
+    }
+
+    case IORingSubmission::WAITPID: {
+        pid_t pid = submission.Argument;
+        auto zombie = std::find_if(process->Zombies, [&pid](const auto& zombie) {
+            return zombie.PID == pid;
+        });
+        if (zombie != process->Zombies.end()) {
+            int returnStatus = zombie->ReturnStatus;
+            process->Zombies.erase(zombie);
+            return returnStatus;
+        }
+        ThreadGroup* waited = Scheduler::thread_group(pid);
+        if (not waited) return -1;
+        // We get woken up when it exits, and reap it's zombie then.
+        auto& waiting = waited->RingWaiters;
+        if (std::find(waiting.begin(), waiting.end(), process->ProcessID) == waiting.end())
+            waiting.push_back(process->ProcessID);
+        return -2;
+    }
+
+    default:
+        return -1;
+    }
+}
+
+/// Carry out up to TOSUBMIT operations from the calling process'
+/// submission ring, after retrying those held back because they would
+/// have blocked, and post the results to the completion ring. Held back
+/// operations are retried in the order they were submitted, every time
+/// the process enters.
+/// If fewer than MINCOMPLETE completions are then waiting to be
+/// consumed, and some operations are still held back, sleep until one
+/// of them might be able to make progress. Userspace should then look
+/// at the completion ring and, if need be, enter again.
+/// @return The number of completions waiting, -2 after having slept,
+///   or -1 if the process has no rings.
+ssz sys$38_io_enter(u32 toSubmit, u32 minComplete) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 38, "io_enter");
+    DBGMSG("  toSubmit: {}, minComplete: {}\n\n", toSubmit, minComplete);
+
+    Process* process = Scheduler::CurrentProcess->value();
+    IORing& ring = process->Group->Ring;
+    if (not ring.active()) return -1;
+
+    auto run = [&](const IORingSubmission& submission) {
+        ssz rc = io_ring_perform(process, submission);
+        if (rc == -2) ring.defer(submission);
+        else ring.complete(submission, rc);
+    };
+
+    for (const auto& submission : ring.take_deferred())
+        run(submission);
+
+    IORingSubmission submission;
+    for (; toSubmit and ring.take(submission); --toSubmit)
+        run(submission);
+
+    u32 ready = ring.ready();
+    if (ready >= minComplete or not ring.pending()) return ready;
+
+    // Whatever the held back operations are waiting on wakes us up.
+    memcpy(&process->CPU, cpu, sizeof(CPUState));
+    process->set_return_value(usz(-2));
+    process->BlockedOnIORing = true;
+    process->State = Process::SLEEPING;
+    Scheduler::yield();
+}
+
+/// One of the buffers given to `readv` or `writev`. The layout must
+/// match that of `struct iovec` in libc.
+struct IOVector {
+    u8* Base;
+    usz Length;
+};
+
+/// The most buffers `readv` and `writev` accept at once.
+constexpr int IOVectorMax = 1024;
+
+/// Read into each of the COUNT buffers in VECTORS in turn, as if they
+/// were one big buffer given to `read`.
+/// @return The total number of bytes read, or -1 on error.
+ssz sys$39_readv(ProcFD fd, const IOVector* vectors, int count) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 39, "readv");
+    DBGMSG("  fd: {}, vectors: {}, count: {}\n\n", fd, (void*)vectors, count);
+
+    Process* process = Scheduler::CurrentProcess->value();
+    if (count < 0 or count > IOVectorMax) return -1;
+    if (count and (not process->valid_address(vectors)
+                   or not process->valid_address((const u8*)(vectors + count) - 1))) {
+        std::print("[SYS$]:readv:ERROR: vectors address invalid: {}\n", (void*)vectors);
+        return -1;
+    }
+
+    ssz total = 0;
+    for (int i = 0; i < count; ++i) {
+        if (not vectors[i].Length) continue;
+        if (not process->valid_address(vectors[i].Base)) return total ? total : -1;
+        ssz rc = read_file(fd, vectors[i].Base, vectors[i].Length);
+        // Only block if nothing has been read yet.
+        if (rc == -2 and not total) sleep_on_file(cpu, fd, true);
+        if (rc < 0) return total ? total : rc;
+        total += rc;
+        // A short read means there is nothing more to be had for now.
+        if (usz(rc) < vectors[i].Length) break;
+    }
+    return total;
+}
+
+/// Write each of the COUNT buffers in VECTORS in turn, as if they were
+/// one big buffer given to `write`.
+/// @return The total number of bytes written, or -1 on error.
+ssz sys$40_writev(ProcFD fd, const IOVector* vectors, int count) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 40, "writev");
+    DBGMSG("  fd: {}, vectors: {}, count: {}\n\n", fd, (void*)vectors, count);
+
+    Process* process = Scheduler::CurrentProcess->value();
+    if (count < 0 or count > IOVectorMax) return -1;
+    if (count and (not process->valid_address(vectors)
+                   or not process->valid_address((const u8*)(vectors + count) - 1))) {
+        std::print("[SYS$]:writev:ERROR: vectors address invalid: {}\n", (void*)vectors);
+        return -1;
+    }
+
+    ssz total = 0;
+    for (int i = 0; i < count; ++i) {
+        if (not vectors[i].Length) continue;
+        if (not process->valid_address(vectors[i].Base)) return total ? total : -1;
+        ssz rc = write_file(fd, vectors[i].Base, vectors[i].Length);
+        // Only block if nothing has been written yet.
+        if (rc == -2 and not total) sleep_on_file(cpu, fd, false);
+        if (rc < 0) return total ? total : rc;
+        total += rc;
+        if (usz(rc) < vectors[i].Length) break;
+    }
+    return total;
+}
+
+/// Like `read`, but starting POSITION bytes into the file, and leaving
+/// the file's offset alone.
+ssz sys$41_pread(ProcFD fd, u8* buffer, u64 byteCount, usz position) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 41, "pread");
+    DBGMSG("  fd: {}, buffer: {}, byteCount: {}, position: {}\n\n", fd, (void*)buffer, byteCount, position);
+
+    if (not Scheduler::CurrentProcess->value()->valid_address(buffer)) {
+        std::print("[SYS$]:pread:ERROR: buffer address invalid: {}\n", (void*)buffer);
+        return -1;
+    }
+    if (position == CurrentOffset) return -1;
+
+    ssz rc = read_file(fd, buffer, byteCount, position);
+    if (rc == -2) sleep_on_file(cpu, fd, true);
+    return rc;
+}
+
+/// Like `write`, but starting POSITION bytes into the file, and
+/// leaving the file's offset alone.
+ssz sys$42_pwrite(ProcFD fd, u8* buffer, u64 byteCount, usz position) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 42, "pwrite");
+    DBGMSG("  fd: {}, buffer: {}, byteCount: {}, position: {}\n\n", fd, (void*)buffer, byteCount, position);
+
+    if (not Scheduler::CurrentProcess->value()->valid_address(buffer)) {
+        std::print("[SYS$]:pwrite:ERROR: buffer address invalid: {}\n", (void*)buffer);
+        return -1;
+    }
+    if (position == CurrentOffset) return -1;
+
+    ssz rc = write_file(fd, buffer, byteCount, position);
+    if (rc == -2) sleep_on_file(cpu, fd, false);
+    return rc;
+}
+
+/// Move up to BYTECOUNT bytes from the file at IN to the file at OUT,
+/// without going through userspace. A null position means to use (and
+/// move along) the file's own offset, like `read` and `write` do.
+/// When the file at OUT can be written in place (pipes, sockets), the
+/// data is read straight into its buffer; otherwise, it goes through
+/// a kernel bounce buffer.
+/// @return The number of bytes moved, or -1 on error. If nothing could
+///   be moved without blocking, -2, with BLOCKEDON set to the file
+///   that the caller should sleep on.
+static ssz transfer(ProcFD out, usz* outPosition, ProcFD in, usz* inPosition, usz byteCount, ProcFD& blockedOn) {
+    VFS& vfs = SYSTEM->virtual_filesystem();
+    usz total = 0;
+    while (total < byteCount) {
+        ssz rc = 0;
+        auto sink = vfs.file(out);
+        if (not sink) return total ? ssz(total) : -1;
+        auto driver = sink->filesystem_driver();
+
+        u8* space = nullptr;
+        ssz room = driver->reserve_write(sink.get(), space);
+        if (room == -2) {
+            blockedOn = out;
+            return total ? ssz(total) : -2;
+        }
+        if (room > 0) {
+            usz n = std::min(byteCount - total, usz(room));
+            rc = read_file(in, space, n, inPosition ? *inPosition : CurrentOffset);
+            if (rc > 0) driver->commit_write(sink.get(), usz(rc));
+            if (rc == -2) blockedOn = in;
+        } else {
+            // NOTE: A single CPU runs syscalls with interrupts off, so
+            // nothing else can be using this at the same time.
+            static constinit u8 bounce[PAGE_SIZE];
+            usz n = std::min(byteCount - total, sizeof(bounce));
+            // Only read as much as the sink can take without blocking,
+            // as there is no giving back what was read from a pipe or
+            // socket. Sinks that never say are regular files, which
+            // don't block.
+            if (driver->event_source(sink.get(), EventType::READY_TO_WRITE)) {
+                ssz ready = driver->ready(sink.get(), EventType::READY_TO_WRITE);
+                if (ready <= 0) {
+                    blockedOn = out;
+                    return total ? ssz(total) : -2;
+                }
+                n = std::min(n, usz(ready));
+            }
+            rc = read_file(in, bounce, n, inPosition ? *inPosition : CurrentOffset);
+            if (rc == -2) blockedOn = in;
+            if (rc > 0) {
+                ssz written = write_file(out, bounce, usz(rc), outPosition ? *outPosition : CurrentOffset);
+                if (written == -2) blockedOn = out;
+                if (written > 0 and outPosition) *outPosition += usz(written);
+                // If the write came up short anyway, move a source read
+                // at it's own offset back to just after what was
+                // written; one read at INPOSITION only moves along by
+                // what was written below.
+                usz unwritten = usz(rc) - usz(std::max(written, ssz(0)));
+                if (unwritten and not inPosition) {
+                    auto source = vfs.file(in);
+                    if (source and not source->filesystem_driver()->event_source(source.get(), EventType::READY_TO_READ))
+                        source->offset -= std::min(unwritten, source->offset);
+                }
+                rc = written;
+            }
+        }
+
+        if (rc <= 0) {
+            if (total) return ssz(total);
+            return rc;
+        }
+        if (inPosition) *inPosition += usz(rc);
+        total += usz(rc);
+    }
+    return ssz(total);
+}
+
+/// Move up to BYTECOUNT bytes from the file at IN to the file at OUT.
+/// If OFFSET is not null, read from there in IN (and update it to
+/// after what was read), leaving IN's offset alone.
+ssz sys$43_sendfile(ProcFD out, ProcFD in, usz* offset, usz byteCount) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 43, "sendfile");
+    DBGMSG("  out: {}, in: {}, offset: {}, byteCount: {}\n\n", out, in, (void*)offset, byteCount);
+
+    if (offset and not Scheduler::CurrentProcess->value()->valid_address(offset)) {
+        std::print("[SYS$]:sendfile:ERROR: offset address invalid: {}\n", (void*)offset);
+        return -1;
+    }
+
+    ProcFD blockedOn = in;
+    ssz rc = transfer(out, nullptr, in, offset, byteCount, blockedOn);
+    if (rc == -2) sleep_on_file(cpu, blockedOn, blockedOn == in);
+    return rc;
+}
+
+/// Like `sendfile`, but both sides may be given a position to use in
+/// place of the file's own offset. Pipes and sockets ignore positions.
+ssz sys$44_splice(ProcFD in, usz* inOffset, ProcFD out, usz* outOffset, usz byteCount) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 44, "splice");
+    DBGMSG("  in: {}, inOffset: {}, out: {}, outOffset: {}, byteCount: {}\n\n", in, (void*)inOffset, out, (void*)outOffset, byteCount);
+
+    auto* process = Scheduler::CurrentProcess->value();
+    if (inOffset and not process->valid_address(inOffset)) {
+        std::print("[SYS$]:splice:ERROR: input offset address invalid: {}\n", (void*)inOffset);
+        return -1;
+    }
+    if (outOffset and not process->valid_address(outOffset)) {
+        std::print("[SYS$]:splice:ERROR: output offset address invalid: {}\n", (void*)outOffset);
+        return -1;
+    }
+
+    ProcFD blockedOn = in;
+    ssz rc = transfer(out, outOffset, in, inOffset, byteCount, blockedOn);
+    if (rc == -2) sleep_on_file(cpu, blockedOn, blockedOn == in);
+    return rc;
+}
+
+/// Trace system calls; see `SyscallTrace`.
+///   TRACE:      Trace the process with PID A (or the calling process,
+///               if zero) if B is set, or stop tracing it otherwise.
+///   COUNT:      Keep statistics of every system call if A is set.
+///   READ:       Copy at most C records into the buffer at B, starting
+///               at the sequence number A points to, which is updated.
+///   STATISTICS: Copy the statistics of at most B system calls into the
+///               buffer at A. Times are given in nanoseconds.
+///   RESET:      Zero the statistics of every system call.
+/// @return The number of records or statistics copied for READ and
+///   STATISTICS, otherwise 0, or -1 if anything is invalid.
+ssz sys$45_systrace(u64 operation, u64 a, u64 b, u64 c) {
+    DBGMSG(sys$_dbgfmt, 45, "systrace");
+    DBGMSG("  operation: {}, a: {}, b: {}, c: {}\n\n", operation, a, b, c);
+    Process* process = Scheduler::CurrentProcess->value();
+    switch (operation) {
+    case SyscallTrace::TRACE: {
+        Process* traced = a ? Scheduler::process(pid_t(a)) : process;
+        if (not traced) return -1;
+        SyscallTrace::set_traced(traced, b);
+        return 0;
+    }
+    case SyscallTrace::COUNT:
+        SyscallTrace::set_counting(a);
+        return 0;
+    case SyscallTrace::READ: {
+        auto* cursor = (u64*)a;
+        auto* records = (SyscallTrace::Record*)b;
+        if (not process->valid_address(cursor) or not process->valid_address(records)) return -1;
+        if (c and not process->valid_address((u8*)(records + c) - 1)) return -1;
+        return ssz(SyscallTrace::read(*cursor, records, c));
+    }
+    case SyscallTrace::STATISTICS: {
+        auto* stats = (SyscallTrace::Statistics*)a;
+        if (not process->valid_address(stats)) return -1;
+        if (b and not process->valid_address((u8*)(stats + b) - 1)) return -1;
+        return ssz(SyscallTrace::statistics(stats, b));
+    }
+    case SyscallTrace::RESET:
+        SyscallTrace::reset_statistics();
+        return 0;
+    }
+    return -1;
+}
+
+/// Something done to the files of a process started by `spawn`, before
+/// it runs. The layout must match that of `struct spawn_action` in libc.
+struct SpawnAction {
+    enum : u64 {
+        /// Make NewFD refer to what FD does, like `repfd`.
+        DUP2 = 0,
+        /// Close FD.
+        CLOSE = 1,
+    } Type;
+    ProcFD FD;
+    ProcFD NewFD;
+};
+
+/// The most actions `spawn` accepts at once.
+constexpr usz SpawnActionMax = 64;
+
+/// Start the executable at PATH as a new child of the calling process,
+/// without copying the caller's address space first, as `fork` would.
+/// ARGS are passed along like they are by `exec`. The child starts out
+/// with the files of the caller open, and then has each of the COUNT
+/// ACTIONS applied to those in turn. If AFFINITY is not null, the child
+/// may only run on the CPUs set in it (see `sched_setaffinity`) from
+/// the start, rather than on those of the caller.
+/// @return The PID of the child, or -1 if it couldn't be started.
+pid_t sys$46_spawn(const char* path, const char** args, const SpawnAction* actions, usz count, const u64* affinity) {
+    DBGMSG(sys$_dbgfmt, 46, "spawn");
+    DBGMSG("  path: {}, args: {}, actions: {}, count: {}, affinity: {}\n\n", (void*)path, (void*)args, (void*)actions, count, (void*)affinity);
+
+    Process* process = Scheduler::CurrentProcess->value();
+    if (not process->valid_address(path)) {
+        std::print("[SYS$]:spawn:ERROR: path address invalid: {}\n", (void*)path);
+        return pid_t(-1);
+    }
+    if (count > SpawnActionMax) return pid_t(-1);
+    if (count and (not process->valid_address(actions)
+                   or not process->valid_address((u8*)(actions + count) - 1))) {
+        std::print("[SYS$]:spawn:ERROR: actions address invalid: {}\n", (void*)actions);
+        return pid_t(-1);
+    }
+    if (affinity and (not process->valid_address(affinity)
+                      or not process->valid_address((const u8*)(affinity + 1) - 1))) {
+        std::print("[SYS$]:spawn:ERROR: affinity address invalid: {}\n", (void*)affinity);
+        return pid_t(-1);
+    }
+    if (affinity and not (*affinity & Scheduler::online_cpus())) return pid_t(-1);
+
+    VFS& vfs = SYSTEM->virtual_filesystem();
+    FileDescriptors fds = vfs.open(path);
+    if (fds.invalid()) {
+        std::print("[SYS$]:spawn:ERROR: Could not open {}\n", path);
+        return pid_t(-1);
+    }
+
+    // The strings are copied onto the child's stack before this returns.
+    std::vector<std::string_view> argv;
+    argv.push_back(path);
+    for (const char** it = args; it and *it; ++it)
+        argv.push_back(*it);
+
+    Process* child = ELF::SpawnUserspaceElf64Process(process, fds.Process, argv);
+    // Closed before the files are copied, so the child doesn't get it.
+    vfs.close(fds.Process);
+    if (not child) return pid_t(-1);
+
+    CopyFileDescriptors(process, child);
+    for (usz i = 0; i < count; ++i) {
+        const SpawnAction& action = actions[i];
+        bool ok = false;
+        switch (action.Type) {
+        case SpawnAction::DUP2: ok = vfs.dup2(child, action.FD, action.NewFD); break;
+        case SpawnAction::CLOSE: ok = vfs.close(child, action.FD); break;
+        }
+        if (not ok) {
+            std::print("[SYS$]:spawn:ERROR: Action {} failed (type={} fd={} newfd={})\n", i, u64(action.Type), action.FD, action.NewFD);
+            // The caller never hears of this child, so it mustn't be
+            // left with a zombie of it either.
+            child->ParentProcess = pid_t(-1);
+            Scheduler::remove_process(child->ProcessID, -1);
+            return pid_t(-1);
+        }
+    }
+
+    if (affinity) child->Affinity = *affinity;
+    Scheduler::make_runnable(child);
+    return child->ProcessID;
+}
+
+/// A file `poll` is asked about. The layout must match that of
+/// `struct pollfd` in libc.
+struct PollFD {
+    s32 FD;
+    s16 Events;
+    s16 ReturnedEvents;
+
+    enum : s16 {
+        /// May be read from without blocking.
+        IN = 1 << 0,
+        /// May be written to without blocking.
+        OUT = 1 << 2,
+        /// FD isn't open; only ever returned.
+        INVALID = 1 << 5,
+    };
+};
+
+/// The most files `poll` accepts at once.
+constexpr usz PollFDMax = 1024;
+
+/// Store in each of the COUNT FDS which of it's requested events it is
+/// ready for. Files that never become ready (i.e. regular files) always
+/// are, as reading them never blocks.
+/// @return How many of FDS have any events.
+static usz poll_files(PollFD* fds, usz count) {
+    auto& vfs = SYSTEM->virtual_filesystem();
+    usz ready = 0;
+    for (usz i = 0; i < count; ++i) {
+        PollFD& pfd = fds[i];
+        pfd.ReturnedEvents = 0;
+        if (pfd.FD < 0) continue;
+        auto file = vfs.file(ProcFD(pfd.FD));
+        if (not file) {
+            pfd.ReturnedEvents = PollFD::INVALID;
+            ++ready;
+            continue;
+        }
+        auto driver = file->filesystem_driver();
+        auto check = [&](s16 flag, EventType type) {
+            if (not (pfd.Events & flag)) return;
+            if (not driver->event_source(file.get(), type)
+                or driver->ready(file.get(), type) >= 0)
+                pfd.ReturnedEvents |= flag;
+        };
+        check(PollFD::IN, EventType::READY_TO_READ);
+        check(PollFD::OUT, EventType::READY_TO_WRITE);
+        if (pfd.ReturnedEvents) ++ready;
+    }
+    return ready;
+}
+
+/// Wait until any of the COUNT files in FDS is ready for one of the
+/// events requested of it, using the same event sources as `kevent`.
+/// @param timeoutMilliseconds
+///   How long to block when none are ready. Zero returns immediately,
+///   and a negative value blocks until one is.
+/// @return The number of FDS with events returned (zero on timeout),
+///   -2 if the call should be retried because one of them may have
+///   become ready, or -1 on error.
+ssz sys$47_poll(PollFD* fds, usz count, ssz timeoutMilliseconds) {
+    CPUState* cpu = nullptr;
+    asm volatile ("mov %%r11, %0\n"
+                  : "=r"(cpu)
+                  );
+    DBGMSG(sys$_dbgfmt, 47, "poll");
+
+    Process* process = Scheduler::CurrentProcess->value();
+    if (count > PollFDMax) return -1;
+    if (count and (not process->valid_address(fds)
+                   or not process->valid_address((u8*)(fds + count) - 1))) {
+        std::print("[SYS$]:poll:ERROR: fds address invalid: {}\n", (void*)fds);
+        return -1;
+    }
+
+    // Whatever a previous call was waiting for is looked at afresh.
+    if (process->PollQueue) process->PollQueue->clear();
+
+    usz ready = poll_files(fds, count);
+    if (ready or timeoutMilliseconds == 0) return ssz(ready);
+
+    if (not process->PollQueue) {
+        process->PollQueue = new EventQueue;
+        process->PollQueue->ID = EventQueueHandle::Poll;
+        process->PollQueue->Group = process->Group.get();
+    }
+    auto& vfs = SYSTEM->virtual_filesystem();
+    for (usz i = 0; i < count; ++i) {
+        if (fds[i].FD < 0) continue;
+        auto file = vfs.file(ProcFD(fds[i].FD));
+        if (not file) continue;
+        EventFilter filter;
+        filter.ProcessFD = ProcFD(fds[i].FD);
+        if (fds[i].Events & PollFD::IN)
+            process->PollQueue->register_listening(EventType::READY_TO_READ, filter, EVENT_FLAG_EDGE,
+                                                   file->filesystem_driver()->event_source(file.get(), EventType::READY_TO_READ));
+        if (fds[i].Events & PollFD::OUT)
+            process->PollQueue->register_listening(EventType::READY_TO_WRITE, filter, EVENT_FLAG_EDGE,
+                                                   file->filesystem_driver()->event_source(file.get(), EventType::READY_TO_WRITE));
+    }
+
+    // Block until one of the files notifies us, or we time out.
+    memcpy(&process->CPU, cpu, sizeof(CPUState));
+    process->set_return_value(0);
+    process->BlockedOnEventQueue = EventQueueHandle::Poll;
+    if (timeoutMilliseconds > 0)
+        process->set_timeout(milliseconds_to_ticks(timeoutMilliseconds), 0);
+    process->State = Process::SLEEPING;
+    Scheduler::yield();
+}
+
 // TODO: Reorder this
 // FIXME: Make it easier to reorder this (maybe separate the number
 // from the name? I don't know, something to make this easier...)
@@ -997,4 +2063,55 @@ void* syscalls[LENSOR_OS_NUM_SYSCALLS] = {
     (void*)sys$24_kevent,
 
     (void*)sys$25_directory_data,
+
+    (void*)sys$26_setpriority,
+    (void*)sys$27_nanosleep,
+    (void*)sys$28_timeout,
+
+    (void*)sys$29_thread_create,
+    (void*)sys$30_thread_exit,
+    (void*)sys$31_thread_join,
+
+    (void*)sys$32_futex,
+    (void*)sys$33_set_tls,
+
+    (void*)sys$34_sched_setaffinity,
+    (void*)sys$35_sched_getaffinity,
+    (void*)sys$36_sched_stats,
+
+    (void*)sys$37_io_setup,
+    (void*)sys$38_io_enter,
+
+    (void*)sys$39_readv,
+    (void*)sys$40_writev,
+    (void*)sys$41_pread,
+    (void*)sys$42_pwrite,
+
+    (void*)sys$43_sendfile,
+    (void*)sys$44_splice,
+
+    (void*)sys$45_systrace,
+    (void*)sys$46_spawn,
+
+    (void*)sys$47_poll,
 };
+
+constinit PerCPU gPerCPU;
+
+void initialize_fast_syscalls() {
+    gPerCPU.KernelStack = TSS::kernel_stack();
+    // Within the kernel, GS is based at the per-CPU data; `swapgs`
+    // swaps userspace's base (zero) in and out.
+    MSR::write(MSR::GS_BASE, (u64)&gPerCPU);
+    MSR::write(MSR::KERNEL_GS_BASE, 0);
+    // `syscall` loads CS from bits 32-47 and SS from that plus eight.
+    // `sysret` loads SS from bits 48-63 plus eight, and CS from that
+    // plus sixteen; see `GDT`.
+    MSR::write(MSR::STAR, u64(0x10) << 48 | u64(0x08) << 32);
+    MSR::write(MSR::LSTAR, (u64)system_call_fast_handler_asm);
+    // Clear TF, IF, DF, IOPL, NT, and AC on entry; interrupts stay off
+    // during syscalls, just like through the `int 0x80` gate.
+    MSR::write(MSR::SFMASK, 0x47700);
+    MSR::write(MSR::EFER, MSR::read(MSR::EFER) | 1);
+    std::print("[SYS$]: Fast syscalls enabled\n");
+}
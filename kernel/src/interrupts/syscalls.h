@@ -22,7 +22,7 @@
 
 #include <integers.h>
 
-constexpr usz LENSOR_OS_NUM_SYSCALLS = 26;
+constexpr usz LENSOR_OS_NUM_SYSCALLS = 48;
 extern void* syscalls[LENSOR_OS_NUM_SYSCALLS];
 
 // Defined in `syscalls.cpp`
@@ -31,5 +31,11 @@ extern usz num_syscalls;
 
 // Defined in `syscalls.asm`
 extern "C" void system_call_handler_asm();
+extern "C" void system_call_fast_handler_asm();
+
+/// Enable the `syscall` instruction, a faster way into the kernel than
+/// `int 0x80` (which keeps working). Must be called after the TSS is
+/// set up, and before any userspace process runs.
+void initialize_fast_syscalls();
 
 #endif
@@ -0,0 +1,125 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <io_ring.h>
+
+#include <memory.h>
+#include <memory/common.h>
+#include <memory/physical_memory_manager.h>
+#include <memory/virtual_memory_manager.h>
+#include <scheduler.h>
+#include <utility>
+
+static_assert(sizeof(IORingSubmission) == 40, "IORingSubmission layout must match libc's io_sqe");
+static_assert(sizeof(IORingCompletion) == 16, "IORingCompletion layout must match libc's io_cqe");
+static_assert(sizeof(IORingHeader) == 48, "IORingHeader layout must match libc's io_ring");
+
+IORingHeader* IORing::setup(Process* process, u32 entries) {
+    if (Header or not entries or entries > MaxEntries) return nullptr;
+    u32 submissions = 1;
+    while (submissions < entries) submissions <<= 1;
+    u32 completions = submissions * 2;
+
+    usz submissionOffset = sizeof(IORingHeader);
+    usz completionOffset = submissionOffset + submissions * sizeof(IORingSubmission);
+    usz size = completionOffset + completions * sizeof(IORingCompletion);
+    usz pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    void* paddr = Memory::request_pages(pages);
+    if (not paddr) return nullptr;
+    void* vaddr = (void*)process->Group->next_region_vaddr;
+    process->Group->next_region_vaddr += pages * PAGE_SIZE;
+
+    usz flags = 0;
+    flags |= (usz)Memory::PageTableFlag::Present;
+    flags |= (usz)Memory::PageTableFlag::UserSuper;
+    flags |= (usz)Memory::PageTableFlag::ReadWrite;
+    process->add_memory_region(vaddr, paddr, pages * PAGE_SIZE, flags);
+    Memory::map_pages(process->CR3, vaddr, paddr, flags, pages, Memory::ShowDebug::No);
+
+    // We are within a syscall of PROCESS, so it's memory is right here.
+    memset(vaddr, 0, pages * PAGE_SIZE);
+    Header = (IORingHeader*)vaddr;
+    Header->SubmissionEntries = submissions;
+    Header->CompletionEntries = completions;
+    Header->SubmissionOffset = submissionOffset;
+    Header->CompletionOffset = completionOffset;
+    Submissions = (IORingSubmission*)((u8*)vaddr + submissionOffset);
+    Completions = (IORingCompletion*)((u8*)vaddr + completionOffset);
+    SubmissionMask = submissions - 1;
+    CompletionMask = completions - 1;
+    SubmissionHead = 0;
+    CompletionTail = 0;
+    return Header;
+}
+
+void IORing::reset() {
+    Pending.clear();
+    Header = nullptr;
+    Submissions = nullptr;
+    Completions = nullptr;
+    SubmissionMask = 0;
+    CompletionMask = 0;
+    SubmissionHead = 0;
+    CompletionTail = 0;
+}
+
+bool IORing::take(IORingSubmission& submission) {
+    if (not Header) return false;
+    // Everything taken off the ring must be able to complete without
+    // overwriting a completion userspace hasn't seen yet.
+    if (ready() + Pending.size() > CompletionMask) return false;
+    u32 tail = __atomic_load_n(&Header->SubmissionTail, __ATOMIC_ACQUIRE);
+    if (tail == SubmissionHead) return false;
+    // Copied out of shared memory before being looked at, so that
+    // userspace can't change it from underneath us.
+    memcpy(&submission, &Submissions[SubmissionHead & SubmissionMask], sizeof(IORingSubmission));
+    ++SubmissionHead;
+    __atomic_store_n(&Header->SubmissionHead, SubmissionHead, __ATOMIC_RELEASE);
+    return true;
+}
+
+void IORing::complete(const IORingSubmission& submission, ssz result) {
+    if (not Header) return;
+    IORingCompletion& completion = Completions[CompletionTail & CompletionMask];
+    completion.UserData = submission.UserData;
+    completion.Result = result;
+    ++CompletionTail;
+    __atomic_store_n(&Header->CompletionTail, CompletionTail, __ATOMIC_RELEASE);
+    Header->Pending = Pending.size();
+}
+
+void IORing::defer(const IORingSubmission& submission) {
+    if (not Header) return;
+    Pending.push_back(submission);
+    Header->Pending = Pending.size();
+}
+
+std::vector<IORingSubmission> IORing::take_deferred() {
+    std::vector<IORingSubmission> deferred = std::move(Pending);
+    return deferred;
+}
+
+u32 IORing::ready() const {
+    if (not Header) return 0;
+    u32 ready = CompletionTail - __atomic_load_n(&Header->CompletionHead, __ATOMIC_ACQUIRE);
+    // Userspace may have scribbled over it's head; never trust it to
+    // be more than a ring behind.
+    return ready > CompletionMask + 1 ? CompletionMask + 1 : ready;
+}
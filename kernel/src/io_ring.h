@@ -0,0 +1,138 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_IO_RING_H
+#define LENSOR_OS_IO_RING_H
+
+#include <integers.h>
+#include <vector>
+
+struct Process;
+
+/// One operation asked of the kernel through a process' submission
+/// ring. The layout must match that of `struct io_sqe` in libc.
+struct IORingSubmission {
+    enum Operation : u8 {
+        NOP = 0,
+        /// Read LENGTH bytes from FD into ADDRESS.
+        READ,
+        /// Write LENGTH bytes at ADDRESS to FD.
+        WRITE,
+        /// Accept a connection on the listening socket FD.
+        ACCEPT,
+        /// Connect the socket FD to the LENGTH byte address at ADDRESS.
+        CONNECT,
+        /// Wait for events on the event queue FD, and store up to
+        /// LENGTH of them (but no more than 1024) at ADDRESS.
+        KEVENT,
+        /// Wait for the process with PID ARGUMENT to exit.
+        WAITPID,
+        COUNT
+    };
+    u8 Op { NOP };
+    u8 Flags { 0 };
+    u16 Reserved { 0 };
+    s32 FD { -1 };
+    u64 Address { 0 };
+    u64 Length { 0 };
+    u64 Argument { 0 };
+    /// Handed back, untouched, in the completion.
+    u64 UserData { 0 };
+};
+
+/// The result of a submitted operation, in the process' completion
+/// ring. The layout must match that of `struct io_cqe` in libc.
+struct IORingCompletion {
+    u64 UserData;
+    /// What the equivalent syscall would have returned.
+    s64 Result;
+};
+
+/// The start of the memory shared with userspace, which the rings
+/// follow. Userspace only ever writes the submission tail (after
+/// filling in submissions) and the completion head (after consuming
+/// completions); everything else is written by the kernel, which keeps
+/// it's own copies of it.
+struct IORingHeader {
+    u32 SubmissionHead;
+    u32 SubmissionTail;
+    u32 CompletionHead;
+    u32 CompletionTail;
+    u32 SubmissionEntries;
+    u32 CompletionEntries;
+    /// Submissions taken off the ring that have yet to complete (i.e.
+    /// because they would block).
+    u32 Pending;
+    u32 Reserved;
+    /// Byte offsets of the rings from the start of this header.
+    u64 SubmissionOffset;
+    u64 CompletionOffset;
+};
+
+/// A pair of submission and completion rings mapped into a process, so
+/// that many operations can be handed to the kernel in a single entry.
+/// The rings live in userspace memory, and so may only be touched from
+/// within a syscall of the process they belong to.
+struct IORing {
+    static constexpr u32 MaxEntries = 256;
+
+    /// Map rings of ENTRIES submissions (rounded up to a power of two),
+    /// and twice as many completions, into PROCESS.
+    /// @return The userspace address of the header, or NULL.
+    IORingHeader* setup(Process* process, u32 entries);
+
+    bool active() const { return Header; }
+
+    /// Forget about the rings, i.e. when the memory they are in is
+    /// about to be unmapped.
+    void reset();
+
+    /// Take the next submission off the ring, if there is one and there
+    /// is certain to be room for it's completion.
+    bool take(IORingSubmission&);
+
+    /// Post a completion for SUBMISSION.
+    void complete(const IORingSubmission& submission, ssz result);
+
+    /// Hold on to SUBMISSION, which would have blocked, to be tried
+    /// again later.
+    void defer(const IORingSubmission& submission);
+
+    /// Hand over every deferred submission, in the order they were
+    /// deferred, leaving none.
+    std::vector<IORingSubmission> take_deferred();
+
+    /// The number of completions userspace has yet to consume.
+    u32 ready() const;
+
+    /// The number of deferred submissions.
+    usz pending() const { return Pending.size(); }
+
+private:
+    std::vector<IORingSubmission> Pending;
+    IORingHeader* Header { nullptr };
+    IORingSubmission* Submissions { nullptr };
+    IORingCompletion* Completions { nullptr };
+    u32 SubmissionMask { 0 };
+    u32 CompletionMask { 0 };
+    u32 SubmissionHead { 0 };
+    u32 CompletionTail { 0 };
+};
+
+#endif /* LENSOR_OS_IO_RING_H */
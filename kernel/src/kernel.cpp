@@ -78,31 +78,22 @@ extern "C" void kmain(BootInfo* bInfo) {
     gPIT.wait();                                           // Rest
     gPIT.play_sound(392, MACCYS_STEP_LENGTH_MILLISECONDS); // G4
 
-    // Tasks that need done by a kernel thread and done frequently should go
-    // in this loop.
+    // From here on, this is the idle task: the scheduler only runs it
+    // when no process is runnable. Background work that need not be done
+    // right away goes in this loop, before halting until an interrupt.
     for (;;) {
         // Free pages which previously housed page maps (or portions thereof).
-        if (Scheduler::PageMapsToFree.size() > 15) {
-            // TODO: Abstract x86_64
-            // Disable interrupts; we do this to prevent a timer interrupt causing a
-            // yield away from this thread, which could invalidate the iterator in the
-            // following loop.
-            asm ("cli");
-            //std::print("[KERNEL]: Disabled interrupts; freeing {} page tables\n", Scheduler::PageMapsToFree.size());
+        Scheduler::free_page_maps();
 
-            for (Memory::PageTable* table : Scheduler::PageMapsToFree) {
-                //std::print("[KERNEL]: Freeing page table at {}\n", (void*)table);
-                Memory::free_page_map(table);
-            }
+        // Zero free pages ahead of time, one at a time, so that new page
+        // tables don't have to wait for it.
+        // TODO: Abstract x86_64
+        asm ("cli");
+        bool zeroed = Memory::prepare_zeroed_pages(1);
+        asm ("sti");
 
-            // Once we free a page map, we no longer need to free it.
-            Scheduler::PageMapsToFree.clear();
-
-            // TODO: Abstract x86_64
-            // Enable interrupts (allow yielding away as it now won't cause iterator invalidation or anything)
-            //std::print("[KERNEL]: Enabling interrupts after freeing page tables\n");
-            asm ("sti");
-        }
+        // Nothing left to do; wait for something to happen.
+        if (not zeroed) Scheduler::idle_wait();
     }
 
     // KERNEL INACTIVE
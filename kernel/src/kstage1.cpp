@@ -49,12 +49,16 @@
 #include <random_lfsr.h>
 #include <rtc.h>
 #include <scheduler.h>
+#include <storage/device_drivers/block_cache.h>
 #include <storage/filesystem_drivers/file_allocation_table.h>
 #include <storage/storage_device_driver.h>
 #include <system.h>
+#include <time_page.h>
 #include <tests.h>
+#include <tsc.h>
 #include <uart.h>
 #include <utf.h>
+#include <work_queue.h>
 
 #include <bit>
 #include <format>
@@ -80,6 +84,7 @@ void prepare_interrupts() {
     gIDT.install_handler((u64)rtc_handler,                      PIC_IRQ8);
     gIDT.install_handler((u64)mouse_handler,                    PIC_IRQ12);
     gIDT.install_handler((u64)divide_by_zero_handler,           0x00);
+    gIDT.install_handler((u64)device_not_available_handler,     0x07);
     gIDT.install_handler((u64)double_fault_handler,             0x08);
     gIDT.install_handler((u64)stack_segment_fault_handler,      0x0c);
     gIDT.install_handler((u64)general_protection_fault_handler, 0x0d);
@@ -286,8 +291,11 @@ void discover_filesystems() {
                                "  Unique GUID: {}\n",
                                partition->Driver->type_guid(),
                                partition->Driver->unique_guid());
-                    if (auto FAT = FileAllocationTableDriver::try_create(sdd(partition->Driver))) {
-                        std::print("  Found valid File Allocation Table filesystem\n");
+                    // Without the memory for a cache, go to the device directly.
+                    auto cache = BlockCacheDriver::try_create(sdd(partition->Driver));
+                    if (auto FAT = FileAllocationTableDriver::try_create(cache ? sdd(cache) : sdd(partition->Driver))) {
+                        std::print("  Found valid File Allocation Table filesystem\n"
+                                   "  Block cache: {} KiB\n", cache ? TO_KiB(cache->capacity()) : 0);
                         static bool foundEFI = false;
                         std::string mountPath;
                         if (!foundEFI && partition->Partition.TypeGUID == GPT::PartitionType$EFISystem) {
@@ -306,8 +314,10 @@ void discover_filesystems() {
                 if (controller->Driver) {
                     std::print("[kstage1]: AHCI port {}:\n", controller->Driver->port_number());
                     std::print("  Checking for valid File Allocation Table filesystem\n");
-                    if (auto FAT = FileAllocationTableDriver::try_create(sdd(controller->Driver))) {
-                        std::print("  Found valid File Allocation Table filesystem\n");
+                    auto cache = BlockCacheDriver::try_create(sdd(controller->Driver));
+                    if (auto FAT = FileAllocationTableDriver::try_create(cache ? sdd(cache) : sdd(controller->Driver))) {
+                        std::print("  Found valid File Allocation Table filesystem\n"
+                                   "  Block cache: {} KiB\n", cache ? TO_KiB(cache->capacity()) : 0);
                         // TODO: Name EFI SYSTEM partition something else to make it separate from
                         // regular partitions. Eventually should probably also disallow writing to
                         // EFI SYSTEM mount path unless in very specific circumstances controlled
@@ -367,6 +377,10 @@ void probe_cpu() {
          * To peek further down the rabbit hole, check out the following link:
          *   https://wiki.osdev.org/Detecting_CPU_Topology_(80x86)#Using_CPUID
          */
+        // MONITOR/MWAIT let the idle task sleep until a memory write
+        // (or an interrupt), rather than only an interrupt.
+        if (regs.C & static_cast<u32>(CPUID_FEATURE::ECX_MONITOR))
+            SystemCPU->set_mwait_capable();
         if (regs.D & static_cast<u32>(CPUID_FEATURE::EDX_FXSR)) {
             SystemCPU->set_fxsr_capable();
             asm volatile ("fxsave %0" :: "m"(fxsave_region));
@@ -436,6 +450,23 @@ void probe_cpu() {
                               ::: "rax", "rcx", "rdx");
                 SystemCPU->set_avx_enabled();
             }
+            else if (SystemCPU->sse_enabled()) {
+                // XCR0 only has x87 state enabled at reset; without the
+                // SSE bit, XSAVE/XRSTOR would skip the xmm registers.
+                asm volatile ("xor %%rcx, %%rcx\n"
+                              "xgetbv\n"
+                              "or $0b11, %%eax\n"
+                              "xsetbv\n"
+                              ::: "rax", "rcx", "rdx");
+            }
+            // Size of the save area for the components now enabled in
+            // XCR0, and whether XSAVEOPT may be used to write it.
+            CPUIDRegisters xsaveRegs;
+            cpuid(0x0d, 0, xsaveRegs);
+            SystemCPU->set_xsave_area_size(xsaveRegs.B);
+            cpuid(0x0d, 1, xsaveRegs);
+            if (xsaveRegs.A & 0b1)
+                SystemCPU->set_xsaveopt_capable();
         }
     }
 #endif
@@ -573,6 +604,11 @@ void kstage2(BootInfo* bInfo) {
                , __FG_DEFAULT
                );
 
+    // Scheduler statistics are kept in time stamp counter cycles.
+    TSC::calibrate();
+    // Userspace tells the time from a page the kernel keeps up to date.
+    TimePage::initialize();
+
     // Setup network device(s)
     for (auto& dev : SYSTEM->Devices) {
         if (dev->major() == SYSDEV_MAJOR_NETWORK
@@ -585,6 +621,11 @@ void kstage2(BootInfo* bInfo) {
     // The scheduler is the system in place that switches between processes
     // while a CPU is running.
     Scheduler::initialize();
+    // Needs the TSS, set up by the scheduler.
+    initialize_fast_syscalls();
+
+    // Interrupt handlers and syscalls defer work to a kernel thread.
+    gWorkQueue.start("[kworker]");
 
     if (!vfs.mounts().empty()) {
         // Another userspace program
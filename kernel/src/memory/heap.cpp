@@ -148,8 +148,7 @@ void expand_heap(u64 numBytes) {
     // NOTE: We don't use map_pages here because we request a new page for each one mapped.
     for (u64 i = 0; i < numPages * PAGE_SIZE; i += PAGE_SIZE) {
         // Map virtual heap position to physical memory address returned by page frame allocator.
-        void* addr = Memory::request_page();
-        memset(addr, 0, PAGE_SIZE);
+        void* addr = Memory::request_zeroed_page();
         Scheduler::map_pages_in_all_processes
             ((void*)((u64)sHeapEnd + i), addr
              , (u64)Memory::PageTableFlag::Present
@@ -26,6 +26,7 @@
 #include <debug.h>
 #include <efi_memory.h>
 #include <link_definitions.h>
+#include <memory.h>
 #include <memory/common.h>
 #include <memory/paging.h>
 #include <memory/virtual_memory_manager.h>
@@ -223,6 +224,36 @@ namespace Memory {
         return nullptr;
     }
 
+    /* Pages zeroed ahead of time. These remain locked while they
+     *   wait here, so they count towards used memory.
+     */
+    constexpr u64 ZeroedPagesMax = 64;
+    void* ZeroedPages[ZeroedPagesMax];
+    u64 ZeroedPagesCount { 0 };
+
+    void* request_zeroed_page() {
+        if (ZeroedPagesCount)
+            return ZeroedPages[--ZeroedPagesCount];
+        void* addr = request_page();
+        memset(addr, 0, PAGE_SIZE);
+        return addr;
+    }
+
+    u64 prepare_zeroed_pages(u64 numberOfPages) {
+        u64 zeroed = 0;
+        // Never hoard memory that is needed elsewhere.
+        while (zeroed < numberOfPages
+               && ZeroedPagesCount < ZeroedPagesMax
+               && TotalFreePages > ZeroedPagesMax * 4)
+        {
+            void* addr = request_page();
+            memset(addr, 0, PAGE_SIZE);
+            ZeroedPages[ZeroedPagesCount++] = addr;
+            ++zeroed;
+        }
+        return zeroed;
+    }
+
     constexpr u64 InitialPageBitmapMaxAddress = MiB(64);
     constexpr u64 InitialPageBitmapPageCount = InitialPageBitmapMaxAddress / PAGE_SIZE;
     constexpr u64 InitialPageBitmapSize = InitialPageBitmapPageCount / 8;
@@ -43,6 +43,17 @@ namespace Memory {
      *   pages free, while locking all of them before returning.
      */
     void* request_pages(u64 numberOfPages);
+    /* Return the physical address of a free page filled with zeros,
+     *   preferably one zeroed ahead of time by `prepare_zeroed_pages`.
+     */
+    void* request_zeroed_page();
+    /* Zero up to `numberOfPages` free pages ahead of time, to be handed
+     *   out by `request_zeroed_page`. Meant to be called when there is
+     *   nothing better to do (i.e. by the idle task).
+     * Returns the number of pages zeroed; zero once there is no room
+     *   left to keep any more.
+     */
+    u64 prepare_zeroed_pages(u64 numberOfPages);
 
     void lock_page(void* address);
     void lock_pages(void* address, u64 numberOfPages);
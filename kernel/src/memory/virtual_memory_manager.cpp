@@ -80,8 +80,7 @@ namespace Memory {
         PDE = pageMapLevelFour->entries[indexer.page_directory_pointer()];
         PageTable* PDP;
         if (!PDE.flag(PageTableFlag::Present)) {
-            PDP = (PageTable*)request_page();
-            memset(PDP, 0, PAGE_SIZE);
+            PDP = (PageTable*)request_zeroed_page();
             PDE.set_address((u64)PDP);
         }
         PDE.or_flag_if(PageTableFlag::Present,       present);
@@ -100,8 +99,7 @@ namespace Memory {
         PDE = PDP->entries[indexer.page_directory()];
         PageTable* PD;
         if (!PDE.flag(PageTableFlag::Present)) {
-            PD = (PageTable*)request_page();
-            memset(PD, 0, PAGE_SIZE);
+            PD = (PageTable*)request_zeroed_page();
             PDE.set_address((u64)PD);
         }
         PDE.or_flag_if(PageTableFlag::Present,       present);
@@ -120,8 +118,7 @@ namespace Memory {
         PDE = PD->entries[indexer.page_table()];
         PageTable* PT;
         if (!PDE.flag(PageTableFlag::Present)) {
-            PT = (PageTable*)request_page();
-            memset(PT, 0, PAGE_SIZE);
+            PT = (PageTable*)request_zeroed_page();
             PDE.set_address((u64)PT);
         }
         PDE.or_flag_if(PageTableFlag::Present,       present);
@@ -194,6 +191,33 @@ namespace Memory {
         unmap(ActivePageMap, virtualAddress, d);
     }
 
+    void* physical_address(PageTable* pageMapLevelFour, void* virtualAddress) {
+        if (pageMapLevelFour == nullptr)
+            return nullptr;
+
+        u64 virt = u64(virtualAddress);
+        PageMapIndexer indexer(virt);
+        PageDirectoryEntry PDE;
+        PDE = pageMapLevelFour->entries[indexer.page_directory_pointer()];
+        if (!PDE.flag(PageTableFlag::Present)) return nullptr;
+        auto* PDP = (PageTable*)PDE.address();
+        PDE = PDP->entries[indexer.page_directory()];
+        if (!PDE.flag(PageTableFlag::Present)) return nullptr;
+        // 1GiB page.
+        if (PDE.flag(PageTableFlag::LargerPages))
+            return (void*)((PDE.address() & ~u64(0x3fffffff)) | (virt & 0x3fffffff));
+        auto* PD = (PageTable*)PDE.address();
+        PDE = PD->entries[indexer.page_table()];
+        if (!PDE.flag(PageTableFlag::Present)) return nullptr;
+        // 2MiB page.
+        if (PDE.flag(PageTableFlag::LargerPages))
+            return (void*)((PDE.address() & ~u64(0x1fffff)) | (virt & 0x1fffff));
+        auto* PT = (PageTable*)PDE.address();
+        PDE = PT->entries[indexer.page()];
+        if (!PDE.flag(PageTableFlag::Present)) return nullptr;
+        return (void*)(PDE.address() | (virt & 0xfff));
+    }
+
     void unmap_pages(PageTable* pageTable, void* virtualAddress, usz pageCount, ShowDebug d) {
         if (d == Memory::ShowDebug::Yes) {
             std::print("Attempting to unmap {} pages starting at virtual {} in page table at {}\n"
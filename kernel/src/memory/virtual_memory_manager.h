@@ -92,6 +92,11 @@ namespace Memory {
                , ShowDebug d = ShowDebug::No
                );
 
+    /* Return the physical address the given virtual address is mapped
+     *   to in the given page map level four, or NULL if it isn't present.
+     */
+    void* physical_address(PageTable*, void* virtualAddress);
+
     /* Load the given address into control register three to update
      *   the virtual to physical mapping the CPU is using currently.
      */
@@ -0,0 +1,116 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <rcu.h>
+
+#include <scheduler.h>
+#include <spinlock.h>
+#include <work_queue.h>
+
+namespace RCU {
+    /// Taken with interrupts disabled, as quiescent states are reported
+    /// from the timer interrupt.
+    static constinit Spinlock Lock { "RCU" };
+
+    /// Callbacks queued while a grace period was already in progress;
+    /// they wait for the next one to begin and end.
+    static constinit Callback* Pending { nullptr };
+    static constinit Callback** PendingTail { &Pending };
+    /// Callbacks waiting on the grace period in progress.
+    static constinit Callback* Waiting { nullptr };
+    static constinit Callback** WaitingTail { &Waiting };
+    /// Callbacks whose grace period has ended, waiting to be run.
+    static constinit Callback* Done { nullptr };
+    static constinit Callback** DoneTail { &Done };
+
+    /// CPUs yet to pass through a quiescent state in the grace period
+    /// in progress; zero when there is none.
+    static constinit u64 CPUsToPass { 0 };
+    static constinit u64 GracePeriods { 0 };
+
+    static void run_callbacks_work(Work*) { run_callbacks(); }
+    static constinit Work RunCallbacks { run_callbacks_work };
+
+    /// Move pending callbacks to a new grace period, if there are any
+    /// and none is in progress. Must be called with `Lock` held.
+    static void start_grace_period() {
+        if (CPUsToPass || !Pending) return;
+        Waiting = Pending;
+        WaitingTail = PendingTail;
+        Pending = nullptr;
+        PendingTail = &Pending;
+        // Every CPU that is up must pass through a quiescent state.
+        CPUsToPass = Scheduler::online_cpus();
+    }
+
+    void call(Callback* callback) {
+        callback->Next = nullptr;
+        u64 flags = Lock.lock_irqsave();
+        *PendingTail = callback;
+        PendingTail = &callback->Next;
+        start_grace_period();
+        Lock.unlock_irqrestore(flags);
+    }
+
+    void quiescent(usz cpu) {
+        // Checked without the lock first, as this is called on every
+        // tick and there is usually no grace period to end.
+        if (!(__atomic_load_n(&CPUsToPass, __ATOMIC_RELAXED) & (u64(1) << cpu)))
+            return;
+
+        u64 flags = Lock.lock_irqsave();
+        CPUsToPass &= ~(u64(1) << cpu);
+        bool ended = CPUsToPass == 0 && Waiting;
+        if (ended) {
+            *DoneTail = Waiting;
+            DoneTail = WaitingTail;
+            Waiting = nullptr;
+            WaitingTail = &Waiting;
+            GracePeriods += 1;
+            start_grace_period();
+        }
+        Lock.unlock_irqrestore(flags);
+
+        // Callbacks free memory and such, which is better not done from
+        // within the timer interrupt.
+        if (ended) gWorkQueue.queue(&RunCallbacks);
+    }
+
+    void run_callbacks() {
+        u64 flags = Lock.lock_irqsave();
+        Callback* callback = Done;
+        Done = nullptr;
+        DoneTail = &Done;
+        // Interrupts stay disabled while running callbacks, as whatever
+        // they free is also freed from syscalls, which aren't expecting
+        // to be interrupted.
+        Lock.unlock();
+        while (callback) {
+            // Read first, as the callback may free itself.
+            Callback* next = callback->Next;
+            callback->Function(callback);
+            callback = next;
+        }
+        read_unlock(flags);
+    }
+
+    u64 grace_periods() {
+        return __atomic_load_n(&GracePeriods, __ATOMIC_RELAXED);
+    }
+}
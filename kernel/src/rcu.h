@@ -0,0 +1,131 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_RCU_H
+#define LENSOR_OS_RCU_H
+
+#include <integers.h>
+
+/// Read-copy-update: readers of a shared structure take no locks at
+/// all, while writers publish a new copy (or unlink an old element)
+/// and free what they replaced only once every reader that could have
+/// seen it is gone.
+///
+/// The kernel isn't preemptible, so read-side critical sections are
+/// just regions with interrupts disabled; a CPU that passes through a
+/// context switch (or takes a timer interrupt with interrupts enabled)
+/// can't be inside one. Once every CPU has done so since a callback
+/// was queued, the grace period is over and the callback is run.
+///
+/// Readers must not block, yield, or otherwise sleep while within a
+/// read-side critical section.
+namespace RCU {
+    /// A callback to be run after a grace period. Like `Work`, these
+    /// are intrusive: the owner must keep it alive (and at the same
+    /// address) until it has been run. The callback may free it.
+    struct Callback {
+        using Function_t = void(*)(Callback*);
+
+        Function_t Function { nullptr };
+        /// Free for use by the owner (i.e. to find the object to free
+        /// from within the callback).
+        void* Data { nullptr };
+
+        /// Constant expressions, so that static callbacks are
+        /// initialised at compile time (global constructors are never run).
+        constexpr Callback() = default;
+        constexpr Callback(Function_t function, void* data = nullptr)
+            : Function(function), Data(data) {}
+
+        /// Callbacks are linked into a list by address.
+        Callback(const Callback&) = delete;
+        Callback& operator=(const Callback&) = delete;
+
+    private:
+        friend void call(Callback*);
+        friend void run_callbacks();
+        Callback* Next { nullptr };
+    };
+
+    /// Enter a read-side critical section. May be nested.
+    /// @return The previous interrupt state, for `read_unlock()`.
+    [[nodiscard]] inline u64 read_lock() {
+        u64 flags;
+        asm volatile ("pushfq\n"
+                      "pop %0\n"
+                      "cli\n"
+                      : "=r"(flags)
+                      :: "memory");
+        return flags;
+    }
+
+    /// Leave a read-side critical section, restoring the interrupt
+    /// state `read_lock()` returned.
+    inline void read_unlock(u64 flags) {
+        asm volatile ("push %0\n"
+                      "popfq\n"
+                      :: "r"(flags)
+                      : "memory", "cc");
+    }
+
+    /// A read-side critical section for the lifetime of the locker.
+    class ReadLocker {
+    public:
+        ReadLocker() : Flags(read_lock()) {}
+        ~ReadLocker() { read_unlock(Flags); }
+
+        ReadLocker(const ReadLocker&) = delete;
+        ReadLocker& operator=(const ReadLocker&) = delete;
+
+    private:
+        u64 Flags;
+    };
+
+    /// Load a pointer published with `assign()`; everything it points
+    /// to is seen as it was when it was published.
+    template <typename T>
+    inline T* dereference(T* const& pointer) {
+        return __atomic_load_n(&pointer, __ATOMIC_ACQUIRE);
+    }
+
+    /// Publish a pointer to readers. Everything written to the object
+    /// beforehand is visible to anybody who sees the new pointer.
+    template <typename T>
+    inline void assign(T*& pointer, T* value) {
+        __atomic_store_n(&pointer, value, __ATOMIC_RELEASE);
+    }
+
+    /// Run the callback once every reader that may currently hold a
+    /// reference to something it frees is gone. Safe to call from
+    /// interrupt handlers. Callbacks are run from the kernel's work
+    /// queue, in the order they were queued, with interrupts disabled.
+    void call(Callback*);
+
+    /// Tell RCU that this CPU is not within a read-side critical
+    /// section. Called by the scheduler on every tick and context switch.
+    void quiescent(usz cpu = 0);
+
+    /// Run every callback whose grace period has ended.
+    void run_callbacks();
+
+    /// Number of grace periods that have ended since boot.
+    u64 grace_periods();
+}
+
+#endif /* LENSOR_OS_RCU_H */
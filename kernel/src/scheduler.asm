@@ -22,8 +22,14 @@
 extern scheduler_switch_process
 ;; A pointer to a function that increments timer ticks by one.
 extern timer_tick
+;; A pointer to a function that switches to the next runnable process
+;; without charging the current one for a timer tick.
+extern scheduler_reschedule_process
 do_swapgs:
-    cmp QWORD [rsp + 0x8], 0x8
+;;; Swap in the kernel's GS base when coming from userspace, and back
+;;; out when returning to it; the code segment of the interrupt frame
+;;; tells which. Above the return address are the frame's RIP, then CS.
+    cmp QWORD [rsp + 0x10], 0x08
     je skip_swap
     swapgs
 skip_swap:
@@ -83,12 +89,41 @@ yield_asm_impl:
     pop r13
     pop r14
     pop r15
-    pop fs
-    pop gs
+    add rsp, 8                  ; Eat `fs`; reloading it would clear the TLS base.
+    add rsp, 8                  ; Eat `gs`; reloading it would clear the GS base.
     pop rax
     call do_swapgs
     iretq
 
+;;; Software interrupt used by the idle task to give up the CPU as soon
+;;; as an interrupt makes a process runnable, rather than waiting for the
+;;; next timer tick. Same as `irq0_handler`, minus the timer tick and the
+;;; end of interrupt (this is not an IRQ).
+GLOBAL reschedule_handler
+reschedule_handler:
+    call do_swapgs
+    push rax
+    push gs
+    push fs
+    push r15
+    push r14
+    push r13
+    push r12
+    push r11
+    push r10
+    push r9
+    push r8
+    push rbp
+    push rdi
+    push rsi
+    push rdx
+    push rcx
+    push rbx
+    push rsp
+    mov rdi, rsp
+    call [rel scheduler_reschedule_process]
+    jmp yield_asm_impl
+
 GLOBAL yield_asm
 yield_asm:
     mov rsp, rdi
@@ -20,6 +20,7 @@
 #include <scheduler.h>
 
 #include <format>
+#include <futex.h>
 #include <integers.h>
 #include <interrupts/idt.h>
 #include <interrupts/interrupts.h>
@@ -29,8 +30,14 @@
 #include <memory/physical_memory_manager.h>
 #include <memory/virtual_memory_manager.h>
 #include <pit.h>
+#include <rcu.h>
+#include <spinlock.h>
+#include <tsc.h>
 #include <vfs_forward.h>
 #include <system.h>
+#include <time_page.h>
+#include <work_queue.h>
+#include <x86_64/msr.h>
 
 #ifdef x86_64
 #    include <tss.h>
@@ -40,8 +47,38 @@
 void(*scheduler_switch_process)(CPUState*)
     __attribute__((no_caller_saved_registers));
 
+void(*scheduler_reschedule_process)(CPUState*)
+    __attribute__((no_caller_saved_registers));
+
 void(*timer_tick)();
 
+/// Called from `irq0_handler` in `scheduler.asm` on every timer interrupt,
+/// before switching processes, so that anything woken by a timer gets a
+/// chance to run straight away.
+void scheduler_timer_tick() {
+    pit_tick();
+    TimePage::tick();
+    gTimerWheel.run(gPIT.get());
+}
+
+void Process::unblock(bool setReturn, usz returnValue) {
+    gTimerWheel.cancel(&BlockTimer);
+    BlockedOnEventQueue = EventQueueHandle::Invalid;
+    BlockedOnIORing = false;
+    if (setReturn) set_return_value(returnValue);
+    Scheduler::make_runnable(this, true);
+}
+
+void Process::set_timeout(u64 ticks, usz returnValue) {
+    BlockTimer.Function = [](Timer* timer) {
+        auto* process = static_cast<Process*>(timer->Data);
+        process->unblock(true, process->BlockTimerReturnValue);
+    };
+    BlockTimer.Data = this;
+    BlockTimerReturnValue = returnValue;
+    gTimerWheel.add_relative(&BlockTimer, ticks);
+}
+
 void Process::destroy(int status) {
     //std::print("Destroying process {}\n", ProcessID);
 
@@ -54,14 +91,18 @@ void Process::destroy(int status) {
         SYSTEM->set_init(NULL);
     }
 
-    // Add zombie entry to parent process.
-    // FIXME: Do we need to copy all of our zombies over as well?
-    Process *parent = Scheduler::process(ParentProcess);
-    if (parent) {
-        ZombieState zombie{ProcessID, status};
-        //std::print("[SCHED]: Adding zombie ({}, {}) to process {}\n", zombie.PID, zombie.ReturnStatus, ParentProcess);
-        parent->Zombies.push_back(zombie);
-    }
+    Scheduler::fpu_release(this);
+
+    // Nothing may wake up a process that no longer exists.
+    gTimerWheel.cancel(&BlockTimer);
+    Futex::cancel(this);
+    delete PollQueue;
+    PollQueue = nullptr;
+
+    // Whatever system call this process was in (i.e. `exit`) will
+    // never return.
+    SyscallTrace::complete(this, u64(status));
+    SyscallTrace::set_traced(this, false);
 
     // Run all of the programs in the WaitingList.
     for(pid_t pid : WaitingList) {
@@ -72,26 +113,84 @@ void Process::destroy(int status) {
             waitingProcess->unblock(true, status);
         }
     }
+
+    // If other threads of this process are still running, only this
+    // thread goes away; everything shared is left for the last one.
+    std::erase(Group->Threads, ProcessID);
+    if (not Group->Threads.empty()) {
+        // Anything already waiting has been given the status above;
+        // otherwise keep it around for a later join.
+        if (WaitingList.empty())
+            Group->ExitedThreads.push_back({ProcessID, status});
+        return;
+    }
+
+    for (pid_t pid : Group->Waiters)
+        if (Process* waitingProcess = Scheduler::process(pid))
+            waitingProcess->unblock(true, status);
+    Group->Waiters.clear();
+    for (pid_t pid : Group->RingWaiters)
+        if (Process* waitingProcess = Scheduler::process(pid))
+            if (waitingProcess->BlockedOnIORing)
+                waitingProcess->unblock(false, 0);
+    Group->RingWaiters.clear();
+
+    // Add zombie entry to parent process, on behalf of the process as a
+    // whole (which is known by the PID of it's original thread).
+    // FIXME: Do we need to copy all of our zombies over as well?
+    Process *parent = Scheduler::process(ParentProcess);
+    if (parent) {
+        ZombieState zombie{Group->Leader, status};
+        //std::print("[SCHED]: Adding zombie ({}, {}) to process {}\n", zombie.PID, zombie.ReturnStatus, ParentProcess);
+        parent->Zombies.push_back(zombie);
+    }
+
     // Free memory regions. This includes mmap()ed memory as
     // well as loaded program regions, the stack, etc.
-    for(const auto& region : Memories) {
+    for(const auto& region : Group->Memories) {
         // FIXME: Should we unmap virtual as well?
         Memory::free_pages(region.paddr, region.pages);
     }
     // Clear memories list.
-    while (Memories.remove(0))
+    while (Group->Memories.remove(0))
         ;
 
+    for (EventTimer* timer : Group->EventTimers) {
+        gTimerWheel.cancel(&timer->Entry);
+        delete timer;
+    }
+    Group->EventTimers.clear();
+
+    for (EventQueue* queue : Group->EventQueues)
+        delete queue;
+    Group->EventQueues.clear();
+
     // Close open files.
     // NOTE: There *should* be none; libc should close all open files on destruction.
-    for (const auto& [procfd, fd] : FileDescriptors.pairs()) {
+    for (const auto& [procfd, fd] : Group->FileDescriptors.pairs()) {
         std::print("Process {} leaked file descriptor {}, closing...\n", ProcessID, procfd);
         SYSTEM->virtual_filesystem().close(this, procfd);
     }
 
+    // A kernel thread shares the kernel's page map, but it's stack can
+    // only be freed once nothing is running on it any longer.
+    if (KernelThread) {
+        auto* work = new Work([](Work* self) {
+            Memory::free_pages(self->Data, Scheduler::KernelThreadStackPages);
+            delete self;
+        }, KernelStack);
+        gWorkQueue.queue(work);
+        KernelStack = nullptr;
+        return;
+    }
+
     // FIXME: Abstract x86_64 specific stuff!!
-    // TODO/FIXME: Actually free or use these somewhere, or something.
     Scheduler::PageMapsToFree.push_back(CR3);
+    // The idle task frees these when there's nothing else to do; don't
+    // let them pile up if that's never.
+    static constinit Work FreePageMaps([](Work*) { Scheduler::free_page_maps(); });
+    if (Scheduler::PageMapsToFree.size() >= 16)
+        gWorkQueue.queue(&FreePageMaps);
 }
 
 namespace Scheduler {
@@ -102,17 +201,418 @@ namespace Scheduler {
     }
 
     Process StartupProcess;
+    Process* IdleProcess { &StartupProcess };
 
     SinglyLinkedList<Process*>* ProcessQueue { nullptr };
     SinglyLinkedListNode<Process*>* CurrentProcess { nullptr };
+    SinglyLinkedListNode<Process*>* IdleNode { nullptr };
+
+    /// Every process, hashed by PID, for `process()`. Buckets are read
+    /// within an RCU read-side critical section, and removed processes
+    /// are only freed after a grace period, so lookups take no locks;
+    /// the lock only serialises adding and removing processes.
+    constexpr usz PIDTableSize = 64;
+    Process* PIDTable[PIDTableSize] {};
+    constinit Spinlock PIDTableLock { "PIDTable" };
+
+    static Process*& pid_bucket(pid_t pid) {
+        return PIDTable[usz(pid) % PIDTableSize];
+    }
+
+    static void pid_table_add(Process* process) {
+        u64 flags = PIDTableLock.lock_irqsave();
+        Process*& bucket = pid_bucket(process->ProcessID);
+        process->PIDNext = bucket;
+        RCU::assign(bucket, process);
+        PIDTableLock.unlock_irqrestore(flags);
+    }
+
+    static void pid_table_remove(Process* process) {
+        u64 flags = PIDTableLock.lock_irqsave();
+        // The removed process keeps it's link, so that a reader already
+        // standing on it may carry on down the bucket.
+        for (Process** link = &pid_bucket(process->ProcessID); *link; link = &(*link)->PIDNext) {
+            if (*link == process) {
+                RCU::assign(*link, process->PIDNext);
+                break;
+            }
+        }
+        PIDTableLock.unlock_irqrestore(flags);
+    }
+
+    u64 IdleTicks { 0 };
+    /// Written whenever a process is made runnable; the idle task
+    /// `monitor`s this so that `mwait` returns as soon as it changes.
+    volatile u64 RunQueueWrites { 0 };
     std::vector<Memory::PageTable*> PageMapsToFree;
 
+    /// Virtual runtime charged (at nice 0) for every timer tick a process
+    /// is running for.
+    constexpr u64 TickNanoseconds = 1'000'000'000 / PIT_FREQUENCY;
+
+    /// The most a waking process' virtual runtime may lag behind the
+    /// minimum. This lets interactive processes that sleep a lot run
+    /// as soon as they are woken up, without letting them bank up
+    /// enough credit to starve everything else.
+    constexpr u64 SleeperCredit = TickNanoseconds * 2;
+
+    /// Weight of each nice value, from -20 to 19. Each step of nice
+    /// is about a 10% difference in CPU time (1.25x weight).
+    constexpr u64 NiceToWeight[Process::NiceMax - Process::NiceMin + 1] = {
+        /* -20 */ 88761, 71755, 56483, 46273, 36291,
+        /* -15 */ 29154, 23254, 18705, 14949, 11916,
+        /* -10 */  9548,  7620,  6100,  4904,  3906,
+        /*  -5 */  3121,  2501,  1991,  1586,  1277,
+        /*   0 */  1024,   820,   655,   526,   423,
+        /*   5 */   335,   272,   215,   172,   137,
+        /*  10 */   110,    87,    70,    56,    45,
+        /*  15 */    36,    29,    23,    18,    15,
+    };
+
+    /// Monotonically increasing floor of virtual runtime across all
+    /// runnable processes. New and waking processes are placed
+    /// relative to this, so they neither starve others nor get starved.
+    u64 MinVRuntime { 0 };
+
+    /// Binary min-heap of runnable processes (other than the current
+    /// one), keyed by virtual runtime. Each process keeps it's own
+    /// index within the heap so that it may be removed in O(log n).
+    struct ProcessRunQueue {
+        using Node = SinglyLinkedListNode<Process*>;
+
+        bool empty() const { return Heap.size() == 0; }
+        Node* top() { return Heap[0]; }
+
+        static bool less(const Process* a, const Process* b) {
+            if (a->VRuntime != b->VRuntime) return a->VRuntime < b->VRuntime;
+            return a->ProcessID < b->ProcessID;
+        }
+
+        void push(Node* node) {
+            if (node->value()->RunQueueIndex != Process::NotQueued) return;
+            Heap.push_back(node);
+            node->value()->RunQueueIndex = Heap.size() - 1;
+            sift_up(Heap.size() - 1);
+        }
+
+        Node* pop() {
+            Node* out = Heap[0];
+            remove_at(0);
+            return out;
+        }
+
+        void remove(Process* process) {
+            if (process->RunQueueIndex == Process::NotQueued) return;
+            remove_at(process->RunQueueIndex);
+        }
+
+        std::vector<Node*> Heap;
+
+    private:
+        void remove_at(usz index) {
+            usz last = Heap.size() - 1;
+            Heap[index]->value()->RunQueueIndex = Process::NotQueued;
+            if (index != last) {
+                Heap[index] = Heap[last];
+                Heap[index]->value()->RunQueueIndex = index;
+            }
+            Heap.pop_back();
+            if (index < Heap.size()) {
+                sift_up(index);
+                sift_down(index);
+            }
+        }
+
+        void swap(usz a, usz b) {
+            Node* tmp = Heap[a];
+            Heap[a] = Heap[b];
+            Heap[b] = tmp;
+            Heap[a]->value()->RunQueueIndex = a;
+            Heap[b]->value()->RunQueueIndex = b;
+        }
+
+        void sift_up(usz index) {
+            while (index) {
+                usz parent = (index - 1) / 2;
+                if (!less(Heap[index]->value(), Heap[parent]->value())) break;
+                swap(index, parent);
+                index = parent;
+            }
+        }
+
+        void sift_down(usz index) {
+            for (;;) {
+                usz smallest = index;
+                usz left = 2 * index + 1;
+                usz right = left + 1;
+                if (left < Heap.size() && less(Heap[left]->value(), Heap[smallest]->value()))
+                    smallest = left;
+                if (right < Heap.size() && less(Heap[right]->value(), Heap[smallest]->value()))
+                    smallest = right;
+                if (smallest == index) break;
+                swap(index, smallest);
+                index = smallest;
+            }
+        }
+    } RunQueue;
+
+    /// Add `nanoseconds` of CPU time, weighted by nice value, to the
+    /// virtual runtime of the given process.
+    void charge(Process* process, u64 nanoseconds) {
+        process->VRuntime += nanoseconds * NiceToWeight[-Process::NiceMin] / process->Weight;
+    }
+
+    void update_min_vruntime() {
+        // The idle task has no virtual runtime to speak of.
+        bool idle = CurrentProcess->value() == IdleProcess;
+        if (idle && RunQueue.empty()) return;
+        u64 vruntime = idle ? RunQueue.top()->value()->VRuntime : CurrentProcess->value()->VRuntime;
+        if (!RunQueue.empty() && RunQueue.top()->value()->VRuntime < vruntime)
+            vruntime = RunQueue.top()->value()->VRuntime;
+        if (vruntime > MinVRuntime) MinVRuntime = vruntime;
+    }
+
+    SinglyLinkedListNode<Process*>* node(Process* process) {
+        for (auto* it = ProcessQueue->head(); it; it = it->next())
+            if (it->value() == process) return it;
+        return nullptr;
+    }
+
+    void make_runnable(Process* process, bool sleeper) {
+        if (process == IdleProcess) return;
+        if (sleeper && process->State != Process::RUNNING) {
+            u64 floor = MinVRuntime > SleeperCredit ? MinVRuntime - SleeperCredit : 0;
+            if (process->VRuntime < floor) process->VRuntime = floor;
+        }
+        bool woken = process->State != Process::RUNNING;
+        process->State = Process::RUNNING;
+        // The current process is put back on the queue when it is switched away from.
+        if (CurrentProcess && CurrentProcess->value() == process) return;
+        if (process->RunQueueIndex != Process::NotQueued) return;
+        auto* it = node(process);
+        if (it) {
+            process->QueuedAt = TSC::read();
+            process->Woken = woken && sleeper;
+            RunQueue.push(it);
+            RunQueueWrites = RunQueueWrites + 1;
+        }
+    }
+
+    static void load_fs_base(u64 base) {
+        MSR::write(MSR::FS_BASE, base);
+    }
+
+    void set_fs_base(Process* process, u64 base) {
+        process->FSBase = base;
+        if (CurrentProcess && CurrentProcess->value() == process)
+            load_fs_base(base);
+    }
+
+    bool set_priority(pid_t pid, int nice) {
+        if (nice < Process::NiceMin || nice > Process::NiceMax) return false;
+        Process* process = Scheduler::process(pid);
+        if (!process) return false;
+        process->Nice = nice;
+        process->Weight = NiceToWeight[nice - Process::NiceMin];
+        return true;
+    }
+
+    /// Update the statistics of the processes switched from and to.
+    static void account_switch(Process* outgoing, Process* incoming) {
+        // Carry on as if nothing happened; the process keeps running.
+        if (outgoing == incoming) return;
+        u64 now = TSC::read();
+        if (outgoing) {
+            outgoing->Stats.Runtime += now - outgoing->SwitchedInAt;
+            if (outgoing != IdleProcess) {
+                if (outgoing->State == Process::RUNNING) {
+                    outgoing->Stats.InvoluntarySwitches += 1;
+                    outgoing->QueuedAt = now;
+                    outgoing->Woken = false;
+                } else outgoing->Stats.VoluntarySwitches += 1;
+            }
+        }
+        incoming->SwitchedInAt = now;
+        if (incoming == IdleProcess || !incoming->QueuedAt) return;
+
+        SchedulerStats& stats = incoming->Stats;
+        u64 waited = now - incoming->QueuedAt;
+        stats.Waits += 1;
+        stats.WaitTime += waited;
+        if (waited > stats.MaxWaitTime) stats.MaxWaitTime = waited;
+        usz bucket = 0;
+        for (u64 us = TSC::to_microseconds(waited); us && bucket < SchedulerStats::HistogramBuckets - 1; us >>= 1)
+            bucket += 1;
+        stats.WaitHistogram[bucket] += 1;
+        if (incoming->Woken) {
+            stats.Wakeups += 1;
+            stats.WakeupLatency += waited;
+            if (waited > stats.MaxWakeupLatency) stats.MaxWakeupLatency = waited;
+        }
+    }
+
+    bool stats(pid_t pid, SchedulerStats& out) {
+        Process* process = Scheduler::process(pid);
+        if (!process) return false;
+        out = process->Stats;
+        if (CurrentProcess && CurrentProcess->value() == process)
+            out.Runtime += TSC::read() - process->SwitchedInAt;
+        return true;
+    }
+
+    /// FIXME: Set a bit for each application processor, once they are
+    /// brought up to run processes.
+    u64 OnlineCPUs { 1 };
+
+    u64 online_cpus() { return OnlineCPUs; }
+
+    usz this_cpu() { return 0; }
+
+    bool set_affinity(pid_t pid, u64 mask) {
+        if (!(mask & OnlineCPUs)) return false;
+        Process* process = Scheduler::process(pid);
+        if (!process) return false;
+        process->Affinity = mask;
+        return true;
+    }
+
+    static bool allowed_here(const Process* process) {
+        return process->Affinity & (u64(1) << this_cpu());
+    }
+
+    Process* FPUOwner { nullptr };
+
+    enum class FPUSaveMethod {
+        /// No way to save state; the FPU is left alone (and shared).
+        NONE,
+        FXSAVE,
+        XSAVE,
+        /// Like XSAVE, but skips components that are unmodified since
+        /// they were last restored.
+        XSAVEOPT,
+    };
+    FPUSaveMethod FPUMethod { FPUSaveMethod::NONE };
+    /// Tracks CR0.TS so that it is only written when it changes.
+    bool FPUTrapArmed { false };
+
+    /// State loaded the first time a process uses the FPU, so that it
+    /// does not see the registers of whatever process used it last.
+    /// x87 control word at byte 0, MXCSR at byte 24; an all-zero XSAVE
+    /// header puts every other component in it's initial state.
+    alignas(64) u8 InitialFPUState[Process::FPUStateMax] {
+        0x7f, 0x03, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        0x80, 0x1f, 0, 0,
+    };
+
+    void fpu_initialize() {
+        CPUDescription& cpu = SYSTEM->cpu();
+        if (cpu.xsave_enabled() && cpu.xsave_area_size()
+            && cpu.xsave_area_size() <= Process::FPUStateMax)
+        {
+            FPUMethod = cpu.xsaveopt_capable() ? FPUSaveMethod::XSAVEOPT : FPUSaveMethod::XSAVE;
+        }
+        else if (cpu.fxsr_enabled()) {
+            if (cpu.xsave_enabled()) {
+                std::print("[SCHED]: XSAVE area ({} bytes) does not fit in process, "
+                           "falling back to fxsave; AVX state will not be preserved!\n"
+                           , cpu.xsave_area_size());
+            }
+            FPUMethod = FPUSaveMethod::FXSAVE;
+        }
+        static constexpr const char* names[] { "none", "fxsave", "xsave", "xsaveopt" };
+        std::print("[SCHED]: Saving FPU state lazily using {}\n", names[usz(FPUMethod)]);
+    }
+
+    void fpu_save(Process* process) {
+        switch (FPUMethod) {
+        case FPUSaveMethod::NONE:
+            return;
+        case FPUSaveMethod::FXSAVE:
+            asm volatile ("fxsave64 %0" : "=m"(process->FPUState));
+            break;
+        case FPUSaveMethod::XSAVE:
+            // EDX:EAX is the mask of components to save; all of them.
+            asm volatile ("xsave64 %0" : "=m"(process->FPUState) : "a"(-1), "d"(-1));
+            break;
+        case FPUSaveMethod::XSAVEOPT:
+            asm volatile ("xsaveopt64 %0" : "+m"(process->FPUState) : "a"(-1), "d"(-1));
+            break;
+        }
+        process->FPUStateSet = true;
+    }
+
+    void fpu_restore(const u8 (&state)[Process::FPUStateMax]) {
+        switch (FPUMethod) {
+        case FPUSaveMethod::NONE:
+            return;
+        case FPUSaveMethod::FXSAVE:
+            asm volatile ("fxrstor64 %0" :: "m"(state));
+            break;
+        case FPUSaveMethod::XSAVE:
+        case FPUSaveMethod::XSAVEOPT:
+            asm volatile ("xrstor64 %0" :: "m"(state), "a"(-1), "d"(-1));
+            break;
+        }
+    }
+
+    /// Set CR0.TS iff the process about to run does not own the FPU.
+    void fpu_switch(Process* next) {
+        if (FPUMethod == FPUSaveMethod::NONE) return;
+        bool arm = next != FPUOwner;
+        if (arm == FPUTrapArmed) return;
+        if (arm) {
+            asm volatile ("mov %%cr0, %%rax\n"
+                          "or $0b1000, %%rax\n"
+                          "mov %%rax, %%cr0\n"
+                          ::: "rax");
+        }
+        else asm volatile ("clts");
+        FPUTrapArmed = arm;
+    }
+
+    bool fpu_trap() {
+        if (!CurrentProcess) return false;
+        Process* process = CurrentProcess->value();
+        asm volatile ("clts");
+        FPUTrapArmed = false;
+        if (FPUOwner == process) return true;
+        if (FPUOwner) fpu_save(FPUOwner);
+        fpu_restore(process->FPUStateSet ? process->FPUState : InitialFPUState);
+        FPUOwner = process;
+        return true;
+    }
+
+    void fpu_sync(Process* process) {
+        // The owner is always the running process, so TS is clear.
+        if (process == FPUOwner) fpu_save(process);
+    }
+
+    void fpu_release(Process* process) {
+        process->FPUStateSet = false;
+        if (process != FPUOwner) return;
+        FPUOwner = nullptr;
+        // The process may keep running (exec); make sure it traps to
+        // pick up a clean state.
+        if (CurrentProcess && CurrentProcess->value() == process)
+            fpu_switch(process);
+    }
+
     void print_debug() {
         std::print("[SCHED]: Debug information:\n"
-                 "  Process Queue:\n");
+                 "  Idle: {} of {} ticks\n"
+                 "  Process Queue:\n"
+                 , IdleTicks, gPIT.get());
         ProcessQueue->for_each([](auto* it) {
             Process& process = *it->value();
             std::print("    Process {} at {}\n"
+                       "      Nice:     {} (weight {})\n"
+                       "      Affinity: {:#x}\n"
+                       "      VRuntime: {}ns\n"
+                       "      Runtime:  {}ns ({} voluntary, {} involuntary switches)\n"
+                       "      Waited:   {}ns over {} waits (at most {}ns)\n"
+                       "      Wakeups:  {} ({}ns until run, at most {}ns)\n"
                        "      CR3:      {}\n"
                        "      RAX:      {:#016x}\n"
                        "      RBX:      {:#016x}\n"
@@ -137,6 +637,15 @@ namespace Scheduler {
                        "        RSP:    {:#016x}\n"
                        "        SS:     {:#016x}\n"
                        , process.ProcessID, (void*) &process
+                       , process.Nice, process.Weight
+                       , process.Affinity
+                       , process.VRuntime
+                       , TSC::to_nanoseconds(process.Stats.Runtime)
+                       , process.Stats.VoluntarySwitches, process.Stats.InvoluntarySwitches
+                       , TSC::to_nanoseconds(process.Stats.WaitTime), process.Stats.Waits
+                       , TSC::to_nanoseconds(process.Stats.MaxWaitTime)
+                       , process.Stats.Wakeups, TSC::to_nanoseconds(process.Stats.WakeupLatency)
+                       , TSC::to_nanoseconds(process.Stats.MaxWakeupLatency)
                        , (void*) process.CR3
                        , u64(process.CPU.RAX)
                        , u64(process.CPU.RBX)
@@ -161,18 +670,30 @@ namespace Scheduler {
                        , u64(process.CPU.Frame.ss)
                        );
             std::print("      File Descriptors:\n");
-            for (const auto& [procfd, fd] : process.FileDescriptors.pairs()) {
-                std::print("        {} -> {}\n", s64(procfd), s64(fd));
+            if (process.Group) {
+                for (const auto& [procfd, fd] : process.Group->FileDescriptors.pairs()) {
+                    std::print("        {} -> {}\n", s64(procfd), s64(fd));
+                }
             }
         });
         std::print("\n");
     }
 
     Process* process(pid_t pid) {
-        for (SinglyLinkedListNode<Process*>* it = Scheduler::ProcessQueue->head(); it; it = it->next()) {
-            if (it->value()->ProcessID == pid) {
-                return it->value();
-            }
+        RCU::ReadLocker reader;
+        for (Process* it = RCU::dereference(pid_bucket(pid)); it; it = RCU::dereference(it->PIDNext))
+            if (it->ProcessID == pid) return it;
+        return nullptr;
+    }
+
+    ThreadGroup* thread_group(pid_t pid) {
+        if (Process* leader = process(pid))
+            return leader->Group and leader->Group->Leader == pid ? leader->Group.get() : nullptr;
+        // The original thread may have exited before the others.
+        for (auto* it = ProcessQueue->head(); it; it = it->next()) {
+            Process* thread = it->value();
+            if (thread->Group and thread->Group->Leader == pid)
+                return thread->Group.get();
         }
         return nullptr;
     }
@@ -184,34 +705,62 @@ namespace Scheduler {
     pid_t add_process(Process* process) {
         pid_t pid = request_pid();
         process->ProcessID = pid;
+        // Start level with everything else that is runnable.
+        process->VRuntime = MinVRuntime;
+        if (process->Group) {
+            if (process->Group->Threads.empty())
+                process->Group->Leader = pid;
+            process->Group->Threads.push_back(pid);
+        }
         ProcessQueue->add_end(process);
+        pid_table_add(process);
         //std::print("[SCHED]: Added process.\n");
         //print_debug();
         return pid;
     }
 
     bool remove_process(pid_t pid, int status) {
-        Process* processToRemove = nullptr;
+        SinglyLinkedListNode<Process*>* processToRemoveNode = nullptr;
         int processToRemoveIndex = 0;
         for (SinglyLinkedListNode<Process*>* it = ProcessQueue->head(); it; it = it->next()) {
-            Process* process = it->value();
-            if (process->ProcessID == pid) {
-                processToRemove = process;
+            if (it->value()->ProcessID == pid) {
+                processToRemoveNode = it;
                 break;
             }
             processToRemoveIndex += 1;
         }
-        if (processToRemove) {
-            ProcessQueue->remove(processToRemoveIndex);
+        if (processToRemoveNode) {
+            Process* processToRemove = processToRemoveNode->value();
             // Ensure scheduler doesn't **somehow** run this process after it's destroyed.
+            RunQueue.remove(processToRemove);
             processToRemove->State = Process::SLEEPING;
             processToRemove->destroy(status);
-            delete processToRemove;
+            // Let the next switch know there is no outgoing process to
+            // put back on the run queue.
+            if (processToRemoveNode == CurrentProcess)
+                CurrentProcess = nullptr;
+            ProcessQueue->remove(processToRemoveIndex);
+            pid_table_remove(processToRemove);
+            processToRemove->FreeCallback.Function = [](RCU::Callback* callback) {
+                delete static_cast<Process*>(callback->Data);
+            };
+            processToRemove->FreeCallback.Data = processToRemove;
+            RCU::call(&processToRemove->FreeCallback);
             return true;
         }
         return false;
     }
 
+    void remove_other_threads(Process* process, int status) {
+        if (!process->Group) return;
+        // Copied, as removing a thread modifies the group's thread list.
+        std::vector<pid_t> threads = process->Group->Threads;
+        for (pid_t tid : threads)
+            if (tid != process->ProcessID)
+                remove_process(tid, status);
+        process->Group->ExitedThreads.clear();
+    }
+
     bool initialize() {
 #ifdef x86_64
         // The Task State Segment in x86_64 is used
@@ -219,11 +768,13 @@ namespace Scheduler {
         TSS::initialize();
 #endif
 
-        // IRQ handler in assembly increments PIT ticks counter using this
-        // function.
-        timer_tick = pit_tick;
+        // IRQ handler in assembly increments PIT ticks counter and runs
+        // expired timers using this function.
+        timer_tick = scheduler_timer_tick;
         // IRQ handler in assembly switches processes using this function.
         scheduler_switch_process = scheduler_switch;
+        // Software interrupt used by the idle task uses this function.
+        scheduler_reschedule_process = scheduler_reschedule;
 
         // Setup currently executing code as the start process with PID 0.
         StartupProcess.CR3 = Memory::active_page_map();
@@ -237,12 +788,20 @@ namespace Scheduler {
             return false;
         }
         ProcessQueue->add(&StartupProcess);
+        pid_table_add(&StartupProcess);
         CurrentProcess = ProcessQueue->head();
+        // The startup process only does background housekeeping and
+        // halts; it runs whenever the run queue is empty (see `idle_wait`).
+        IdleNode = CurrentProcess;
+        RunQueue.Heap.reserve(32);
+
+        fpu_initialize();
 
 #ifdef x86_64
         // Install IRQ0 handler found in `scheduler.asm` (over-write default
         // system timer handler).
         gIDT.install_handler((u64)irq0_handler, PIC_IRQ0);
+        gIDT.install_handler((u64)reschedule_handler, SCHEDULER_RESCHEDULE_VECTOR);
         gIDT.flush();
         std::print("Flushed IDT after installing new IRQ0 handler\n");
 #endif
@@ -250,77 +809,62 @@ namespace Scheduler {
         return true;
     }
 
-    enum class IncludeGivenProcess {
-        Yes = 0,
-        No = 1,
-    };
-
-    SinglyLinkedListNode<Process*>* find_next_viable_process_after
-    (SinglyLinkedListNode<Process*>* startProcess
-     , IncludeGivenProcess include = IncludeGivenProcess::No)
-    {
-        auto* NextProcess = startProcess;
-
-        if (NextProcess && include == IncludeGivenProcess::No)
-            NextProcess = NextProcess->next();
-
-        while (NextProcess && NextProcess->value()) {
-            if (NextProcess->value()->State == Process::RUNNING) break;
-            // Advance process pointer.
-            NextProcess = NextProcess->next();
-        }
-
-        return NextProcess;
-    }
-
-    SinglyLinkedListNode<Process*>* next_viable_process
-    (SinglyLinkedListNode<Process*>* startProcess
-     , IncludeGivenProcess include = IncludeGivenProcess::No)
-    {
-        auto* NextProcess = find_next_viable_process_after(startProcess, include);
-        if (NextProcess == nullptr) {
-            NextProcess = find_next_viable_process_after(ProcessQueue->head(), IncludeGivenProcess::Yes);
-            if (NextProcess == nullptr) {
-                // Process list has zero viable processes.
-                // FIXME: I honestly don't know how to handle this correctly.
-                // Hang forever.
-                std::print("[SCHED]: I don't know what to do when there are no processes!\n");
-                hang();
+    /// Pick the process with the smallest virtual runtime off of the run
+    /// queue, or the idle task if there is nothing left to run.
+    SinglyLinkedListNode<Process*>* next_viable_process() {
+        // Processes that may not run on this CPU are set aside, and put
+        // back once something has been picked. There can only be so
+        // many, so give up and idle if there are more than that.
+        constexpr usz SetAsideMax = 8;
+        SinglyLinkedListNode<Process*>* setAside[SetAsideMax];
+        usz setAsideCount = 0;
+        auto* chosen = IdleNode;
+        while (not RunQueue.empty()) {
+            auto* next = RunQueue.pop();
+            // Only runnable processes belong on the queue, but be
+            // defensive about something setting the state out from
+            // under us.
+            if (next->value()->State != Process::RUNNING) continue;
+            if (!allowed_here(next->value())) {
+                setAside[setAsideCount++] = next;
+                if (setAsideCount == SetAsideMax) break;
+                continue;
             }
+            chosen = next;
+            break;
         }
-        return NextProcess;
+        for (usz i = 0; i < setAsideCount; ++i)
+            RunQueue.push(setAside[i]);
+        return chosen;
     }
 
     void switch_process_impl(CPUState *cpu) {
-        // Handle single viable process or end of queue.
-        if (CurrentProcess->next() == nullptr) {
-            // If there is only one viable process,
-            // this is a short-cut to do nothing.
-            if(CurrentProcess == ProcessQueue->head())
-                return;
+        RCU::quiescent();
 
-            // Otherwise, we are at the end of the queue,
-            // and must reset back to the beginning of it.
-            CurrentProcess = next_viable_process(ProcessQueue->head()
-                                                 , IncludeGivenProcess::Yes);
-        }
-        else CurrentProcess = next_viable_process(CurrentProcess);
+        Process* outgoing = CurrentProcess ? CurrentProcess->value() : nullptr;
+
+        // If the outgoing process may still run, it goes back on the
+        // queue to compete with everything else. `CurrentProcess` is
+        // NULL when the outgoing process was just removed.
+        if (CurrentProcess && CurrentProcess != IdleNode
+            && CurrentProcess->value()->State == Process::RUNNING)
+            RunQueue.push(CurrentProcess);
+
+        CurrentProcess = next_viable_process();
+        update_min_vruntime();
+        account_switch(outgoing, CurrentProcess->value());
+        SyscallTrace::resume(CurrentProcess->value());
 
         // Update state of CPU that will be restored.
         memcpy(cpu, &CurrentProcess->value()->CPU, sizeof(CPUState));
 
-        if (SYSTEM->cpu().fxsr_enabled() && CurrentProcess->value()->CPUExtraSet) {
-            // Get 512-byte aligned address.
-            usz i = (512 - ((usz)&CurrentProcess->value()->CPUExtra[0] % 512)) % 512;
-            //std::print("Restoring FPU state using fxrstor64 at {}...\n", addr);
-            asm volatile("fxrstor64 %0"
-                         :: "m"(CurrentProcess->value()->CPUExtra[i])
-                         );
-            //std::print("Restored FPU state using fxrstor64 at {}...\n", addr);
-        }
+        // FPU state is swapped in lazily, on first use.
+        fpu_switch(CurrentProcess->value());
 
-        // Use new process' page map.
-        Memory::flush_page_map(CurrentProcess->value()->CR3);
+        // Use new process' page map. Threads of the same process share
+        // one, and there's no reason to throw out the TLB for them.
+        if (Memory::active_page_map() != CurrentProcess->value()->CR3)
+            Memory::flush_page_map(CurrentProcess->value()->CR3);
         // Update ES and DS to SS.
         asm("xor %%rax, %%rax\n\t"
             "movq %0, %%rax\n\t"
@@ -329,34 +873,102 @@ namespace Scheduler {
             :: "r"(cpu->Frame.ss)
             : "rax"
             );
-        // Eventually, FS and GS will be used for TLS, or Thread Local Storage.
-        // Update FS and GS to SS.
-        cpu->FS = cpu->Frame.ss;
-        cpu->GS = cpu->Frame.ss;
+        // FS is used by userspace for TLS, or Thread Local Storage; the
+        // selector is left alone and only it's base is swapped.
+        load_fs_base(CurrentProcess->value()->FSBase);
     }
 
     /// Called from `irq0_handler` in `scheduler.asm`
-    /// A stupid simple round-robin process switcher.
+    /// Charge the current process for the tick it just ran, then switch
+    /// to whichever runnable process has the least virtual runtime.
     void switch_process(CPUState* cpu) {
+        // Read-side critical sections run with interrupts disabled, so
+        // there can't be one in progress on this CPU.
+        RCU::quiescent();
+
+        Process* process = CurrentProcess->value();
+        if (process == IdleProcess) {
+            // Anything runnable at all takes priority over idling.
+            IdleTicks += 1;
+            if (RunQueue.empty()) return;
+        }
+        else {
+            charge(process, TickNanoseconds);
+
+            // Keep running the current process if it is still the most
+            // deserving; this saves a full save/restore of it's state.
+            if (process->State == Process::RUNNING && allowed_here(process)
+                && (RunQueue.empty() || !RunQueue.less(RunQueue.top()->value(), process)))
+            {
+                update_min_vruntime();
+                return;
+            }
+        }
+
         // Save CPU state into process
+        memcpy(&process->CPU, cpu, sizeof(CPUState));
+
+        switch_process_impl(cpu);
+    }
+
+    void reschedule(CPUState* cpu) {
+        // A kernel thread going to sleep switches away even if the only
+        // thing left to run is the idle task.
+        if (RunQueue.empty() && CurrentProcess->value()->State == Process::RUNNING)
+            return;
         memcpy(&CurrentProcess->value()->CPU, cpu, sizeof(CPUState));
+        switch_process_impl(cpu);
+    }
 
-        // Save extra context depending on system features
-        // (i.e. xmm registers with fxsave/fxrestore)
-        if (SYSTEM->cpu().fxsr_enabled()) {
-            //std::print("Saving FPU state using fxsave64 at {}...\n", addr);
-            asm volatile("fxsave64 %0\n\t"
-                         :: "m"(CurrentProcess->value()->CPUExtra[0])
-                         );
-            CurrentProcess->value()->CPUExtraSet = true;
-            //std::print("Saved fpu state using fxsave at {}...\n", addr);
+    void idle_wait() {
+        // Interrupts are disabled while checking the run queue so that
+        // a wakeup can't sneak in between the check and the halt; `sti`
+        // only takes effect after the following instruction, so the
+        // `hlt` or `mwait` is reached before any interrupt is serviced.
+        asm volatile ("cli");
+        if (RunQueue.empty()) {
+            if (SYSTEM->cpu().mwait_capable()) {
+                asm volatile ("monitor" :: "a"(&RunQueueWrites), "c"(0), "d"(0));
+                if (RunQueue.empty())
+                    asm volatile ("sti\n"
+                                  "mwait\n"
+                                  :: "a"(0), "c"(0));
+            }
+            else asm volatile ("sti\n"
+                               "hlt\n");
         }
+        asm volatile ("sti");
+        // Whatever woke us may have made a process runnable; run it now
+        // rather than on the next timer tick.
+        if (!RunQueue.empty())
+            asm volatile ("int %0" :: "i"(SCHEDULER_RESCHEDULE_VECTOR));
+    }
 
-        // TODO: Check all processes that called `wait(ms)`, and run/
-        // unstop them if the timestamp is greater than the calculated
-        // one.
+    u64 idle_ticks() { return IdleTicks; }
 
-        switch_process_impl(cpu);
+    void free_page_maps() {
+        // TODO: Abstract x86_64
+        // Disable interrupts; a process exiting meanwhile would
+        // invalidate the iterator in the following loop.
+        u64 flags;
+        asm volatile ("pushfq\n"
+                      "pop %0\n"
+                      "cli\n"
+                      : "=r"(flags));
+        for (Memory::PageTable* table : PageMapsToFree) {
+            //std::print("[KERNEL]: Freeing page table at {}\n", (void*)table);
+            Memory::free_page_map(table);
+        }
+        // Once we free a page map, we no longer need to free it.
+        PageMapsToFree.clear();
+        asm volatile ("push %0\n"
+                      "popfq\n"
+                      :: "r"(flags) : "cc");
+    }
+
+    void sleep_kernel_thread() {
+        CurrentProcess->value()->State = Process::SLEEPING;
+        asm volatile ("int %0" :: "i"(SCHEDULER_RESCHEDULE_VECTOR));
     }
 
     // Defined in `scheduler.asm`
@@ -368,6 +980,67 @@ namespace Scheduler {
         // iretq to the new process, bb.
         yield_asm(&newstate);
     }
+
+    [[noreturn]] void kernel_thread_entry(void(*function)(void*), void* data) {
+        function(data);
+        asm volatile ("cli");
+        remove_process(CurrentProcess->value()->ProcessID, 0);
+        yield();
+    }
+
+    Process* create_kernel_thread(void(*function)(void*), void* data, const char* name) {
+        void* stack = Memory::request_pages(KernelThreadStackPages);
+        if (!stack) return nullptr;
+
+        auto* thread = new Process;
+        thread->KernelThread = true;
+        thread->KernelStack = stack;
+        thread->ExecutablePath = name;
+        thread->CR3 = StartupProcess.CR3;
+        thread->CPU = {};
+        // Arguments to `kernel_thread_entry`.
+        thread->CPU.RDI = (u64)function;
+        thread->CPU.RSI = (u64)data;
+        thread->CPU.Frame.ip = (u64)kernel_thread_entry;
+        thread->CPU.Frame.cs = 0x08;
+        thread->CPU.Frame.ss = 0x10;
+        // Interrupts enabled (IF), plus the always-set reserved bit.
+        thread->CPU.Frame.flags = 0x202;
+        // As if `kernel_thread_entry` was called: the stack is 16-byte
+        // aligned before the (non-existent) return address is pushed.
+        thread->CPU.Frame.sp = (u64)stack + KernelThreadStackPages * PAGE_SIZE - 8;
+
+        add_process(thread);
+        make_runnable(thread);
+        return thread;
+    }
+}
+
+void CopyFileDescriptors(Process* original, Process* newProcess) {
+    // FIXME: We need a better way of doing this.
+    // ProcFDs need to remain equal, while the values that they index
+    // in the sparse_vector need to be replaced with a new shared ptr.
+    std::vector<ProcFD> garbage_fds_to_erase;
+    for (const auto& [procfd, sysfd] : original->Group->FileDescriptors.pairs()) {
+        // In order to account for holes in the file descriptors vector
+        // we are copying from, we need to push garbage values until we
+        // reach the expected procfd...
+        while (newProcess->Group->FileDescriptors.allocated_size() < (usz)procfd) {
+            auto [fd, success] = newProcess->Group->FileDescriptors.push_back(sysfd);
+            if (!success) break;
+            std::print("Pushing garbage: {}...\n", fd);
+            garbage_fds_to_erase.push_back(fd);
+        }
+
+        auto f = SYSTEM->virtual_filesystem().file(sysfd);
+        //std::print("[FORK]: Copying \"{}\" (ProcFD {}) to process {}\n", f->name(), procfd, newProcess->ProcessID);
+        SYSTEM->virtual_filesystem().add_file(std::move(f), newProcess);
+    }
+
+    for (auto fd : garbage_fds_to_erase) {
+        std::print("Clearing garbage at {}...\n", fd);
+        newProcess->Group->FileDescriptors.erase(fd);
+    }
 }
 
 pid_t CopyUserspaceProcess(Process* original) {
@@ -377,6 +1050,12 @@ pid_t CopyUserspaceProcess(Process* original) {
     newProcess->State = Process::ProcessState::SLEEPING;
     Scheduler::add_process(newProcess);
     newProcess->ParentProcess = original->ProcessID;
+    // Children inherit the priority of their parent.
+    newProcess->Nice = original->Nice;
+    newProcess->Weight = original->Weight;
+    newProcess->Affinity = original->Affinity;
+    // Tracing follows children, as they are part of what was traced.
+    SyscallTrace::set_traced(newProcess, original->Traced);
 
     // Copy current page table (fork)
     // TODO: Use clone_pag_map_copy_on_write, and remove "copy each
@@ -398,7 +1077,7 @@ pid_t CopyUserspaceProcess(Process* original) {
     //std::print("[SCHED]: Allocated new process {} at {}\n", newProcess->ProcessID, (void*)newProcess);
 
     // Copy each memory region's contents into newly allocated memory.
-    for (const auto& memory : original->Memories) {
+    for (const auto& memory : original->Group->Memories) {
         Memory::Region newMemory{memory};
         // FIXME: NO reason these have to be physically contiguous.
         usz newMemoryPages = usz(Memory::request_pages(memory.pages));
@@ -434,42 +1113,22 @@ pid_t CopyUserspaceProcess(Process* original) {
         newProcess->add_memory_region(newMemory);
     }
 
-    // Copy file descriptors.
-    // FIXME: We need a better way of doing this.
-    // ProcFDs need to remain equal, while the values that they index
-    // in the sparse_vector need to be replaced with a new shared ptr.
-    std::vector<ProcFD> garbage_fds_to_erase;
-    for (const auto& [procfd, sysfd] : original->FileDescriptors.pairs()) {
-        // In order to account for holes in the file descriptors vector
-        // we are copying from, we need to push garbage values until we
-        // reach the expected procfd...
-        while (newProcess->FileDescriptors.allocated_size() < (usz)procfd) {
-            auto [fd, success] = newProcess->FileDescriptors.push_back(sysfd);
-            if (!success) break;
-            std::print("Pushing garbage: {}...\n", fd);
-            garbage_fds_to_erase.push_back(fd);
-        }
-
-        auto f = SYSTEM->virtual_filesystem().file(sysfd);
-        //std::print("[FORK]: Copying \"{}\" (ProcFD {}) to process {}\n", f->name(), procfd, newProcess->ProcessID);
-        SYSTEM->virtual_filesystem().add_file(std::move(f), newProcess);
-    }
-
-    for (auto fd : garbage_fds_to_erase) {
-        std::print("Clearing garbage at {}...\n", fd);
-        newProcess->FileDescriptors.erase(fd);
-    }
+    CopyFileDescriptors(original, newProcess);
 
     // Copy PWD
     newProcess->ExecutablePath = original->ExecutablePath;
     newProcess->WorkingDirectory = original->WorkingDirectory;
 
     newProcess->CPU = original->CPU;
-    newProcess->next_region_vaddr = original->next_region_vaddr;
+    Scheduler::fpu_sync(original);
+    memcpy(newProcess->FPUState, original->FPUState, sizeof(Process::FPUState));
+    newProcess->FPUStateSet = original->FPUStateSet;
+    newProcess->FSBase = original->FSBase;
+    newProcess->Group->next_region_vaddr = original->Group->next_region_vaddr;
     // Set child return value for `fork()`.
     newProcess->set_return_value(0);
 
-    newProcess->State = Process::ProcessState::RUNNING;
+    Scheduler::make_runnable(newProcess);
 
     return newProcess->ProcessID;
 }
@@ -23,12 +23,16 @@
 #include <event.h>
 #include <integers.h>
 #include <interrupts/interrupts.h>
+#include <interrupts/syscall_trace.h>
+#include <io_ring.h>
 #include <linked_list.h>
 #include <memory/physical_memory_manager.h>
 #include <memory/virtual_memory_manager.h>
 #include <memory/paging.h>
 #include <memory/region.h>
+#include <rcu.h>
 #include <storage/file_metadata.h>
+#include <timer_wheel.h>
 #include <memory>
 #include <vector>
 #include <extensions>
@@ -39,61 +43,182 @@ namespace Memory {
     struct PageTable;
 }
 
-/// Interrupt handler function found in `scheduler.asm`
+/// Interrupt handler functions found in `scheduler.asm`
 extern "C" void irq0_handler();
+extern "C" void reschedule_handler();
+
+/// Vector of the software interrupt that runs `reschedule_handler`.
+#define SCHEDULER_RESCHEDULE_VECTOR 0x81
 
 typedef u64 pid_t;
 
+/// How a process has fared with the scheduler. Kept in time stamp
+/// counter cycles, and converted to nanoseconds when copied out to
+/// userspace; see `Scheduler::stats`. The layout must match that of
+/// `struct sched_stats` in libc.
+struct SchedulerStats {
+    static constexpr usz HistogramBuckets = 16;
+
+    /// Time spent running.
+    u64 Runtime { 0 };
+    /// Switches away from the process because it blocked, slept, or
+    /// exited, and because something else deserved the CPU more.
+    u64 VoluntarySwitches { 0 };
+    u64 InvoluntarySwitches { 0 };
+    /// Time spent runnable, but waiting on the run queue.
+    u64 Waits { 0 };
+    u64 WaitTime { 0 };
+    u64 MaxWaitTime { 0 };
+    /// Time from being woken up (i.e. data arriving, a timer expiring)
+    /// until actually running.
+    u64 Wakeups { 0 };
+    u64 WakeupLatency { 0 };
+    u64 MaxWakeupLatency { 0 };
+    /// Bucket zero counts waits on the run queue of less than one
+    /// microsecond, bucket N those of [2^(N-1), 2^N) microseconds, and
+    /// the last bucket everything longer.
+    u64 WaitHistogram[HistogramBuckets] {};
+};
+
 struct ZombieState {
     pid_t PID;
     int ReturnStatus;
 };
 
+/// Everything the threads of a process share: the address space, open
+/// files and event queues. As far as the scheduler is concerned, each
+/// thread is a `Process` of it's own (with it's own PID, CPU state,
+/// stack and TLS) that points to the same group.
+struct ThreadGroup {
+    /// The PID of the process' original thread, which identifies the
+    /// process as a whole (i.e. to it's parent).
+    pid_t Leader { 0 };
+    /// The PIDs of every thread in the group that has yet to exit,
+    /// leader included. Shared resources are released by the last one.
+    std::vector<pid_t> Threads;
+    /// Exit statuses of threads that have exited but not been joined.
+    std::vector<ZombieState> ExitedThreads;
+    /// Processes waiting (`waitpid`) for the process as a whole to
+    /// exit; the last thread wakes them with it's exit status.
+    std::vector<pid_t> Waiters;
+    /// Processes with a `WAITPID` operation held back on their ring
+    /// until the process exits. Unlike `Waiters`, these are not handed
+    /// the exit status; they only get woken up if asleep in `io_enter`,
+    /// and pick up the zombie when they retry the operation.
+    std::vector<pid_t> RingWaiters;
+
+    /// Keep track of memory that should be freed when the process exits.
+    SinglyLinkedList<Memory::Region> Memories;
+    usz next_region_vaddr = 0xf8000000;
+
+    /// Keep track of opened files that may be freed when the process
+    /// exits, if no other process has it open.
+    /// NOTE: Just a vector of SysFDs with indexes of type ProcFD, nothing to
+    /// see here. A map of ProcFD to SysFD, if you will.
+    std::sparse_vector<SysFD, SysFD::Invalid, ProcFD> FileDescriptors;
+
+    // FIXME: Get rid of the id integer member in the event queue and
+    // just return an index as the opaque handle.
+    /// Allocated individually, as registrations point back at them.
+    std::vector<EventQueue*> EventQueues;
+    /// Timers backing TIMER filters of the event queues above.
+    std::vector<EventTimer*> EventTimers;
+
+    /// Submission and completion rings, if the process has set them
+    /// up; see `sys$37_io_setup`.
+    IORing Ring;
+};
+
 struct Process {
     pid_t ProcessID = 0;
+    /// Next process in the same bucket of the scheduler's PID table,
+    /// which is walked without locks; see `Scheduler::process`.
+    Process* PIDNext { nullptr };
 
     enum ProcessState {
         RUNNING,
         SLEEPING,
     } State = RUNNING;
 
-    /// Keep track of memory that should be freed when the process exits.
-    SinglyLinkedList<Memory::Region> Memories;
-    usz next_region_vaddr = 0xf8000000;
+    /// Lower nice values get a larger share of the CPU; see
+    /// `Scheduler::set_priority`. Range is [NiceMin, NiceMax].
+    static constexpr int NiceMin = -20;
+    static constexpr int NiceMax = 19;
+    int Nice { 0 };
+    /// Load weight derived from `Nice`; a nice 0 process weighs 1024.
+    u64 Weight { 1024 };
+    /// Nanoseconds of CPU time used, scaled inversely by weight. The
+    /// runnable process with the smallest virtual runtime is run next.
+    u64 VRuntime { 0 };
+    /// Index of this process within the scheduler's run queue heap.
+    static constexpr usz NotQueued = (usz)-1;
+    usz RunQueueIndex { NotQueued };
+
+    SchedulerStats Stats;
+    /// Time stamps of when the process was last switched to, and last
+    /// made to wait on the run queue (and if that was a wakeup).
+    u64 SwitchedInAt { 0 };
+    u64 QueuedAt { 0 };
+    bool Woken { false };
+    /// Bit per CPU this process may run on; see `Scheduler::set_affinity`.
+    u64 Affinity { ~u64(0) };
+
+    /// Whether the system calls this process makes are recorded; only
+    /// ever set through `SyscallTrace::set_traced`.
+    bool Traced { false };
+    /// The system call being made, while tracing or counting them.
+    SyscallTrace::Call Syscall;
+
+    /// Resources shared with the other threads of this process. NULL
+    /// only for the startup (idle) process.
+    std::shared_ptr<ThreadGroup> Group { std::make_shared<ThreadGroup>() };
 
     pid_t ParentProcess{(pid_t)-1};
 
     /// A list of programs waiting to be set to `RUNNING` when this
-    /// program exits.
+    /// thread exits (see `thread_join`; waiting for the whole process
+    /// goes through `ThreadGroup::Waiters`).
     std::vector<pid_t> WaitingList;
 
     // Information regarding child processes that have exited or
     // inherited from a child that has exited. See waitpid syscall.
     std::vector<ZombieState> Zombies;
 
-    /// Keep track of opened files that may be freed when the process
-    /// exits, if no other process has it open.
-    /// NOTE: Just a vector of SysFDs with indexes of type ProcFD, nothing to
-    /// see here. A map of ProcFD to SysFD, if you will.
-    std::sparse_vector<SysFD, SysFD::Invalid, ProcFD> FileDescriptors;
-
     ProcFD sysfd_to_procfd(SysFD predicate_sysfd) {
-        for (const auto& [procfd, sysfd] : FileDescriptors.pairs())
+        for (const auto& [procfd, sysfd] : Group->FileDescriptors.pairs())
             if (sysfd == predicate_sysfd) return procfd;
         return ProcFD::Invalid;
     }
 
-    // FIXME: Use something that doesn't have iterator invalidation,
-    // that way we can get rid of the id integer member in the event
-    // queue and just return an index as the opaque handle.
-    static constexpr usz EventQueueSize = 32;
-    std::vector<EventQueue<EventQueueSize>> EventQueues;
+    /// The event queue this process is blocked in `kevent` on, if any.
+    EventQueueHandle BlockedOnEventQueue { EventQueueHandle::Invalid };
+    /// Whether this process is asleep in `io_enter`, waiting on the
+    /// operations it's ring has held back.
+    bool BlockedOnIORing { false };
+    /// The interest `poll` has registered on the files it is waiting
+    /// for, which is dropped the next time it is called. Unlike other
+    /// event queues, it belongs to this thread alone (though a file
+    /// becoming ready wakes every thread of the group in `poll`; the
+    /// others just look again).
+    EventQueue* PollQueue { nullptr };
+    /// Physical address of the futex this process is waiting on, if
+    /// any, and the next process waiting in the same hash bucket.
+    usz FutexAddress { 0 };
+    Process* FutexNext { nullptr };
+
+    /// Used to unblock this process when it has been sleeping for too
+    /// long; see `set_timeout`.
+    Timer BlockTimer;
+    usz BlockTimerReturnValue { 0 };
 
     std::string ExecutablePath { "" };
     std::string WorkingDirectory { "" };
 
     /// Used to save/restore CPU state when a context switch occurs.
     CPUState CPU;
+    /// Base address of the FS segment, used by userspace to find it's
+    /// thread local storage. Loaded into the CPU when switched to.
+    u64 FSBase { 0 };
 
     /// TODO: We need to figure out how each architecture can affect the
     /// process structure. Maybe defines for each function definition,
@@ -101,13 +226,29 @@ struct Process {
     /// architecture and have a simpler ProcessBase that is inherited
     /// from.
 
-    /* Data for extra CPU info (fxsave, etc). */
-    /* NOTE: fxsave and friends leave bytes 464:511 available for software use. */
-    alignas(16) u8 CPUExtra[512] = {0};
-    bool CPUExtraSet = false;
+    /* Data for extra CPU info (x87/SSE/AVX registers).
+     * Written by fxsave or xsave(opt), depending on what the CPU
+     * supports, but only once another process wants the FPU; see
+     * `Scheduler::FPUOwner`. Must be 64-byte aligned for xsave.
+     * 1024 bytes covers x87, SSE and AVX state (832 bytes).
+     */
+    static constexpr usz FPUStateMax = 1024;
+    alignas(64) u8 FPUState[FPUStateMax] = {0};
+    /// False until the process has used the FPU at least once; until
+    /// then, FPUState holds nothing worth restoring.
+    bool FPUStateSet = false;
 
     Memory::PageTable* CR3 { nullptr };
 
+    /// Kernel threads run in ring 0 within the kernel's page map, on a
+    /// stack of their own; see `Scheduler::create_kernel_thread`.
+    bool KernelThread { false };
+    void* KernelStack { nullptr };
+
+    /// Frees the process once it has been removed from the scheduler,
+    /// after a grace period, so that lookups never see freed memory.
+    RCU::Callback FreeCallback;
+
     Process() = default;
 
     /// Processes are not copyable.
@@ -116,17 +257,17 @@ struct Process {
 
     // size is in bytes.
     void add_memory_region(void* vaddr, void* paddr, usz size, u64 flags) {
-        Memories.add({vaddr, paddr, size, flags});
+        Group->Memories.add({vaddr, paddr, size, flags});
     }
 
     void add_memory_region(const Memory::Region& memory) {
-        Memories.add({memory.vaddr, memory.paddr, memory.length, memory.flags});
+        Group->Memories.add({memory.vaddr, memory.paddr, memory.length, memory.flags});
     }
 
     /// Find region in memories by vaddr and remove it.
     void remove_memory_region(void* vaddr) {
         usz index = 0;
-        auto* region_it = Memories.head();
+        auto* region_it = Group->Memories.head();
         for (; region_it; region_it = region_it->next()) {
             if (region_it->value().vaddr == vaddr) {
                 break;
@@ -134,14 +275,14 @@ struct Process {
             ++index;
         }
         if (region_it) {
-            Memories.remove(index);
+            Group->Memories.remove(index);
         }
     }
 
     bool valid_address(const void* vaddr) {
         // nullptr is always invalid.
         if (not vaddr) return false;
-        auto* region_it = Memories.head();
+        auto* region_it = Group->Memories.head();
         while (region_it) {
             auto* begin = region_it->value().vaddr;
             auto* end = (void*)((u8*)begin + region_it->value().length);
@@ -176,10 +317,18 @@ struct Process {
     /// the process running.
     /// `unblock(true, x)` will set the return value to x, as well as
     /// set the process running.
-    void unblock(bool setReturn = false, usz returnValue = 0) {
-        if (setReturn) set_return_value(returnValue);
-        State = RUNNING;
-    }
+    ///
+    /// A process that was sleeping is given a bit of sleeper credit
+    /// by the scheduler so that I/O bound processes run promptly.
+    void unblock(bool setReturn = false, usz returnValue = 0);
+
+    /// Unblock this process after the given amount of timer ticks
+    /// unless something else unblocks it first, in which case the
+    /// timeout is cancelled.
+    /// @param returnValue
+    ///   The value that the process will see as the return value if
+    ///   the timeout is what wakes it up.
+    void set_timeout(u64 ticks, usz returnValue);
 
     /// @param status Relays exit status to all waiting processes (i.e. via `waitpid`).
     void destroy(int status);
@@ -188,6 +337,8 @@ struct Process {
 /// External symbols for 'scheduler.asm', defined in `scheduler.cpp`
 extern void(*scheduler_switch_process)(CPUState*)
     __attribute__((no_caller_saved_registers));
+extern void(*scheduler_reschedule_process)(CPUState*)
+    __attribute__((no_caller_saved_registers));
 extern void(*timer_tick)();
 
 namespace Scheduler {
@@ -203,8 +354,15 @@ namespace Scheduler {
     pid_t request_pid();
 
     /// Get the process with PID if it is within list of processes, otherwise return NULL.
+    /// Takes no locks. The process stays valid until the caller next
+    /// enables interrupts, blocks, or yields.
     Process* process(pid_t);
 
+    /// Get the thread group of the process with PID, which must be the
+    /// PID of it's original thread. This is found even after that
+    /// thread has exited, for as long as any other thread lives.
+    ThreadGroup* thread_group(pid_t);
+
     /* Switch to the next available task.
      * | Called by IRQ0 Handler (System Timer Interrupt).
      * |-- Copy registers saved from IRQ0 to current process.
@@ -213,10 +371,105 @@ namespace Scheduler {
      */
     void switch_process(CPUState*);
 
+    /// Called by `reschedule_handler` in `scheduler.asm`.
+    /// Like `switch_process`, but the current process is not charged
+    /// for a tick, and nothing happens if there is nothing to run.
+    void reschedule(CPUState*);
+
+    /// Size of the stack given to each kernel thread.
+    constexpr usz KernelThreadStackPages = 4;
+
+    /// Create a ring 0 thread of execution that runs `function(data)` on
+    /// it's own stack, within the kernel's page map, scheduled just like
+    /// any other process. The thread exits when `function` returns.
+    /// @param name  Only used for debugging (stored as the executable path).
+    /// @return NULL iff the thread could not be created.
+    Process* create_kernel_thread(void(*function)(void*), void* data, const char* name);
+
+    /// Put the current kernel thread to sleep until it is made runnable
+    /// again (i.e. by `make_runnable`).
+    /// NOTE: Call with interrupts disabled, after checking whatever
+    /// condition is being waited for, so that a wakeup can't be missed.
+    /// Interrupts are still disabled upon return.
+    void sleep_kernel_thread();
+
+    /// Free the page maps of exited processes queued in `PageMapsToFree`.
+    void free_page_maps();
+
+    /// The process run when no other process is runnable; on x86_64,
+    /// this is the startup process (`kmain`), which is never on the run
+    /// queue. There is a single CPU, so there is a single idle task.
+    extern Process* IdleProcess;
+
+    /// Wait for an interrupt, unless there is already a process ready to
+    /// run. Uses `monitor`/`mwait` when the CPU supports it, otherwise
+    /// `hlt`. If a process is runnable afterwards, switch to it now.
+    /// NOTE: Only meant to be called by the idle task.
+    void idle_wait();
+
+    /// Timer ticks that fired while the idle task was running, which,
+    /// compared to total ticks, gives CPU utilisation.
+    u64 idle_ticks();
+
     /// Add an existing process to the list of processes.
     /// Creates and assigns a unique PID.
+    /// NOTE: The process will not be run until `make_runnable` is called.
     pid_t add_process(Process*);
 
+    /// Set the process state to running and place it on the run queue.
+    /// @param sleeper
+    ///   When true, the process is waking up from being blocked and its
+    ///   virtual runtime is pulled forward to (just under) the minimum,
+    ///   rather than being left behind by the time it spent asleep.
+    void make_runnable(Process*, bool sleeper = false);
+
+    /// The process whose state is currently loaded in the FPU/SSE/AVX
+    /// registers, if any. CR0.TS is set whenever the running process
+    /// is not the owner, so that it's first FPU instruction raises a
+    /// #NM and `fpu_trap` can swap states; processes that never touch
+    /// the FPU never pay for saving and restoring it.
+    extern Process* FPUOwner;
+
+    /// Called from the #NM (device not available) exception handler.
+    /// Saves the owner's FPU state, loads the current process' state,
+    /// and makes it the new owner.
+    /// @return false iff there is no current process to give the FPU to.
+    bool fpu_trap();
+
+    /// Ensure the FPU state saved in the process is up to date (i.e.
+    /// before copying it on fork).
+    void fpu_sync(Process*);
+
+    /// Discard the FPU state of the process; it will be given a clean
+    /// state the next time it uses the FPU (i.e. on exec or exit).
+    void fpu_release(Process*);
+
+    /// Set the base address of the FS segment of the process, which
+    /// userspace uses to find it's thread local storage. Takes effect
+    /// immediately if the process is the current one.
+    void set_fs_base(Process*, u64 base);
+
+    /// Set the nice value of the process with the given PID, updating
+    /// it's weight accordingly.
+    /// @return false iff no process with PID exists or nice is out of range.
+    bool set_priority(pid_t, int nice);
+
+    /// Copy the scheduler statistics of the process with the given PID,
+    /// including the time it has been running for, if it is right now.
+    /// @return false iff no process with PID exists.
+    bool stats(pid_t, SchedulerStats&);
+
+    /// Bit per CPU that is up and running processes.
+    u64 online_cpus();
+    /// The CPU the caller is running on.
+    usz this_cpu();
+
+    /// Restrict the process with the given PID to the CPUs in MASK.
+    /// CPUs that aren't online are kept in the mask, but ignored.
+    /// @return false iff no process with PID exists, or none of the CPUs
+    /// in the mask are online.
+    bool set_affinity(pid_t, u64 mask);
+
     Process* last_process();
 
     /// Remove the process with PID from the scheduler's list of viable
@@ -232,6 +485,10 @@ namespace Scheduler {
     /// @return true iff process with given PID is found, removed, and destroyed.
     bool remove_process(pid_t, int status);
 
+    /// Remove every thread of the process other than the given one, as
+    /// if each had exited with status (i.e. before exit or exec).
+    void remove_other_threads(Process*, int status);
+
     void print_debug();
 
     /// Stop the current process, and start the next. NOTE: CPU state
@@ -252,6 +509,13 @@ namespace Scheduler {
 __attribute__((no_caller_saved_registers))
 void scheduler_switch(CPUState*);
 
+__attribute__((no_caller_saved_registers))
+void scheduler_reschedule(CPUState*);
+
 pid_t CopyUserspaceProcess(Process* original);
 
+/// Open every file ORIGINAL has open in NEWPROCESS, at the same file
+/// descriptors, as happens to the child of a `fork`.
+void CopyFileDescriptors(Process* original, Process* newProcess);
+
 #endif
@@ -19,68 +19,290 @@
 
 #include <spinlock.h>
 
-bool SpinlockLocker::compare_and_swap_lock() {
-    /* Inline Assembly:
-     * |- Desc:
-     * |  |- `lock`                  -- Ensures that the following instruction runs atomically.
-     * |  |- `cmpxchg <op0>, <op1>`  -- Compare 'A' register with <op0>; if equal, swap <op1> and <op0>.
-     * |  `- `sete <op0>`            -- Assign <op0> to the 'equal' flag of the CPU (ZF==1).
-     * |- Outputs:
-     * |  |- "=q"  -- Write-only low-byte-accessible register; return value
-     * |  `- "=m"  -- Write-only memory address; lock flag
-     * `- Inputs:
-     *    |- "r"  -- Any register; new value to swap to if expected  -- "%0"
-     *    |- "m"  -- Memory address; lock flag  -- "%1"
-     *    `- "a"  -- The 'A' register; lock flag will be set only if it matches this value  -- "%2"
-     */
-    bool ret;
-    asm volatile("lock cmpxchg %2, %1\n"
-                 "sete %0\n"
-                 : "=q" (ret), "=m" (Lock.locked)
-                 : "r" (true), "m" (Lock.locked), "a" (false)
-                 : "memory");
-    return ret;
-}
-
-bool SpinlockLocker::test_and_set_lock() {
-    /* In x86, when an instruction is prefixed with `lock`,
-     *   it is guaranteed to be run atomically (thread-safe).
-     * The `xchg` instruction sets a memory address or register
-     *   to a new value while returning the old value in RAX.
-     * It can be determined that the lock was free (unlocked) and is
-     *   acquired (locked) by currently executing code by testing
-     *   that the old value that is returned is equal to false.
-     */
-
-    /* Inline Assembly:
-     * |- Desc: Old value is set to lock, then lock is set to new value.
-     * |  |- `lock`               -- Ensures that the following instruction runs atomically.
-     * |  |- `xchg <op0>, <op1>`  -- Exchanges the contents of the two operands <op1> into <op0>.
-     * |- Output(s)
-     * |  `- "=a"  -- Write-only; output in RAX
-     * `- Input(s)
-     *    |- "m"  -- Memory Address; lock flag
-     *    `- "r"  -- Any register; new lock flag value
-     */
-    bool old_value;
-    asm volatile ("lock xchg %0, %1" : "=a" (old_value) : "m" (Lock.locked), "r" (true));
-    return old_value;
+#include <format>
+#include <integers.h>
+#include <panic.h>
+#include <tsc.h>
+
+// TODO: Abstract x86_64
+/// Disable interrupts, returning the flags register from before.
+static inline u64 save_interrupts() {
+    u64 flags;
+    asm volatile ("pushfq\n"
+                  "pop %0\n"
+                  "cli\n"
+                  : "=r"(flags)
+                  :: "memory");
+    return flags;
+}
+
+static inline void restore_interrupts(u64 flags) {
+    asm volatile ("push %0\n"
+                  "popfq\n"
+                  :: "r"(flags)
+                  : "memory", "cc");
+}
+
+/// Tell the CPU we are spinning; saves power, and gives the other
+/// hyper-thread (if any) the core in the meantime.
+static inline void cpu_relax() {
+    asm volatile ("pause" ::: "memory");
+}
+
+#ifdef LENSOR_OS_LOCK_DEBUG
+/// Lock order checking, after Linux' lockdep. Every time a lock is
+/// taken while others are held, the order is recorded (per class of
+/// lock, not per lock). If a lock is ever taken in an order that
+/// contradicts one seen before, two CPUs (or a CPU and an interrupt
+/// handler) could each be holding the lock the other is waiting for.
+/// This is reported the first time the order is seen, without needing
+/// the deadlock to actually happen.
+// FIXME: The held lock stack must be per CPU once there is SMP.
+struct LockDep {
+    static constexpr usz MaxClasses = 64;
+    static constexpr usz MaxHeld = 16;
+
+    /// What identifies a class: the lock's name if it has one,
+    /// otherwise the lock itself.
+    static inline const void* Keys[MaxClasses] {};
+    static inline const char* Names[MaxClasses] {};
+    static inline usz ClassCount { 0 };
+    /// Bit B of After[A] is set when class B has been taken while A
+    /// was held.
+    static inline u64 After[MaxClasses] {};
+    /// Pairs that have been reported already, in the same format.
+    static inline u64 Reported[MaxClasses] {};
+
+    static inline Spinlock* Held[MaxHeld] {};
+    static inline usz HeldCount { 0 };
+
+    static usz class_of(Spinlock* lock) {
+        if (lock->Class) return lock->Class - 1;
+        const void* key = lock->Name ? (const void*)lock->Name : (const void*)lock;
+        for (usz i = 0; i < ClassCount; ++i) {
+            if (Keys[i] == key) {
+                lock->Class = u16(i + 1);
+                return i;
+            }
+        }
+        if (ClassCount == MaxClasses) {
+            static bool warned { false };
+            if (!warned) std::print("[LOCK]: Out of lock classes; order checks are incomplete\n");
+            warned = true;
+            return MaxClasses;
+        }
+        Keys[ClassCount] = key;
+        Names[ClassCount] = lock->name();
+        lock->Class = u16(ClassCount + 1);
+        return ClassCount++;
+    }
+
+    /// Whether class TO has been (transitively) taken while FROM was held.
+    static bool reaches(usz from, usz to) {
+        u64 visited = u64(1) << from;
+        u64 frontier = After[from];
+        while (frontier & ~visited) {
+            u64 next = 0;
+            for (usz i = 0; i < MaxClasses; ++i) {
+                if (!(frontier & ~visited & (u64(1) << i))) continue;
+                visited |= u64(1) << i;
+                next |= After[i];
+            }
+            if (visited & (u64(1) << to)) return true;
+            frontier = next;
+        }
+        return visited & (u64(1) << to);
+    }
+
+    /// Called before spinning on LOCK.
+    static void acquiring(Spinlock* lock) {
+        u64 flags = save_interrupts();
+        usz taking = class_of(lock);
+        for (usz i = 0; i < HeldCount; ++i) {
+            if (Held[i] == lock) {
+                std::print("[LOCK]: Recursive locking of \"{}\"\n", lock->name());
+                panic("Spinlock taken by it's own holder; this would never return");
+            }
+            usz holding = class_of(Held[i]);
+            if (taking == MaxClasses || holding == MaxClasses || taking == holding)
+                continue;
+            if (reaches(taking, holding) && !(Reported[holding] & (u64(1) << taking))) {
+                Reported[holding] |= u64(1) << taking;
+                std::print("[LOCK]: Possible deadlock: taking \"{}\" while holding \"{}\", "
+                           "but \"{}\" has been taken while holding \"{}\" before\n"
+                           , Names[taking], Names[holding]
+                           , Names[holding], Names[taking]
+                           );
+            }
+            After[holding] |= u64(1) << taking;
+        }
+        restore_interrupts(flags);
+    }
+
+    /// Called once LOCK is held.
+    static void acquired(Spinlock* lock) {
+        u64 flags = save_interrupts();
+        if (HeldCount < MaxHeld) Held[HeldCount++] = lock;
+        else std::print("[LOCK]: Too many locks held to track \"{}\"\n", lock->name());
+        restore_interrupts(flags);
+    }
+
+    static void releasing(Spinlock* lock) {
+        u64 flags = save_interrupts();
+        // Locks don't have to be released in the reverse order they were
+        // taken, so search the whole stack.
+        usz i = HeldCount;
+        while (i && Held[i - 1] != lock) --i;
+        if (!i) std::print("[LOCK]: Unlocking \"{}\", which is not held\n", lock->name());
+        else {
+            for (; i < HeldCount; ++i) Held[i - 1] = Held[i];
+            --HeldCount;
+        }
+        restore_interrupts(flags);
+    }
+};
+#endif /* LENSOR_OS_LOCK_DEBUG */
+
+#ifdef LENSOR_OS_LOCK_STATS
+static Spinlock* LocksWithStats { nullptr };
+
+Spinlock::~Spinlock() {
+    if (!Registered) return;
+    u64 flags = save_interrupts();
+    Spinlock** link = &LocksWithStats;
+    while (*link && *link != this) link = &(*link)->NextWithStats;
+    if (*link) *link = NextWithStats;
+    restore_interrupts(flags);
+}
+#endif
+
+void Spinlock::acquired(bool contended, u64 spins) {
+#ifdef LENSOR_OS_LOCK_DEBUG
+    LockDep::acquired(this);
+#endif
+#ifdef LENSOR_OS_LOCK_STATS
+    // Only the holder writes these, so there is no need for atomics.
+    if (!Registered) {
+        u64 flags = save_interrupts();
+        NextWithStats = LocksWithStats;
+        LocksWithStats = this;
+        Registered = true;
+        restore_interrupts(flags);
+    }
+    Stats.Acquisitions += 1;
+    if (contended) Stats.Contended += 1;
+    Stats.Spins += spins;
+    AcquiredAt = TSC::read();
+#else
+    (void)contended;
+    (void)spins;
+#endif
+}
+
+void Spinlock::releasing() {
+#ifdef LENSOR_OS_LOCK_STATS
+    u64 held = TSC::read() - AcquiredAt;
+    Stats.TotalHoldCycles += held;
+    if (held > Stats.MaxHoldCycles) Stats.MaxHoldCycles = held;
+#endif
+#ifdef LENSOR_OS_LOCK_DEBUG
+    LockDep::releasing(this);
+#endif
+}
+
+void Spinlock::lock() {
+#ifdef LENSOR_OS_LOCK_DEBUG
+    LockDep::acquiring(this);
+#endif
+    u16 ticket = __atomic_fetch_add(&Next, 1, __ATOMIC_RELAXED);
+    u64 spins = 0;
+    while (__atomic_load_n(&Owner, __ATOMIC_ACQUIRE) != ticket) {
+        cpu_relax();
+        ++spins;
+    }
+    acquired(spins != 0, spins);
+}
+
+bool Spinlock::try_lock() {
+    u32 word = __atomic_load_n(&Word, __ATOMIC_RELAXED);
+    u16 owner = u16(word);
+    u16 next = u16(word >> 16);
+    if (owner != next) return false;
+    u32 taken = (u32(u16(next + 1)) << 16) | owner;
+    if (!__atomic_compare_exchange_n(&Word, &word, taken, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+    acquired(false, 0);
+    return true;
+}
+
+void Spinlock::unlock() {
+    releasing();
+    // Only the holder ever writes the owner half, so no read-modify-write
+    // atomic is needed; just make sure everything done while holding the
+    // lock is visible first.
+    __atomic_store_n(&Owner, u16(Owner + 1), __ATOMIC_RELEASE);
+}
+
+u64 Spinlock::lock_irqsave() {
+    u64 flags = save_interrupts();
+    lock();
+    return flags;
+}
+
+void Spinlock::unlock_irqrestore(u64 flags) {
+    unlock();
+    restore_interrupts(flags);
+}
+
+void Spinlock::print_stats() {
+#ifdef LENSOR_OS_LOCK_STATS
+    std::print("[LOCK]: Contention statistics (hold times in TSC cycles):\n");
+    u64 flags = save_interrupts();
+    for (Spinlock* lock = LocksWithStats; lock; lock = lock->NextWithStats) {
+        const SpinlockStats& stats = lock->Stats;
+        std::print("  {}: acquired {}, contended {}, spins {}, average hold {}, max hold {}\n"
+                   , lock->name()
+                   , stats.Acquisitions
+                   , stats.Contended
+                   , stats.Spins
+                   , stats.Acquisitions ? stats.TotalHoldCycles / stats.Acquisitions : 0
+                   , stats.MaxHoldCycles
+                   );
+    }
+    restore_interrupts(flags);
+#else
+    std::print("[LOCK]: Lock statistics are not being collected (build with LOCK_STATS)\n");
+#endif
 }
 
 SpinlockLocker::SpinlockLocker(Spinlock& l)
     : Lock(l)
 {
-    lock();
+    Lock.lock();
 }
 
 SpinlockLocker::~SpinlockLocker() {
     unlock();
 }
 
-void SpinlockLocker::lock() {
-    while (compare_and_swap_lock() == true);
+void SpinlockLocker::unlock() {
+    if (!Held) return;
+    Held = false;
+    Lock.unlock();
 }
 
-void SpinlockLocker::unlock() {
-    Lock.locked = false;
+SpinlockIRQSaveLocker::SpinlockIRQSaveLocker(Spinlock& l)
+    : Lock(l)
+{
+    Flags = Lock.lock_irqsave();
+}
+
+SpinlockIRQSaveLocker::~SpinlockIRQSaveLocker() {
+    unlock();
+}
+
+void SpinlockIRQSaveLocker::unlock() {
+    if (!Held) return;
+    Held = false;
+    Lock.unlock_irqrestore(Flags);
 }
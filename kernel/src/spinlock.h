@@ -20,18 +20,101 @@
 #ifndef LENSOR_OS_SPIN_LOCK_H
 #define LENSOR_OS_SPIN_LOCK_H
 
-// A simple thread-safe locking mechanism inspired by the following page:
-// https://pages.cs.wisc.edu/~remzi/OSTEP/threads-locks.pdf
+#include <integers.h>
 
-class Spinlock {
-    friend class SpinlockLocker;
+// Build options (see `toolchain/config.cmake`):
+// LENSOR_OS_LOCK_DEBUG -- Check the order locks are taken in, lockdep
+//                         style, and report anything that could deadlock.
+// LENSOR_OS_LOCK_STATS -- Count acquisitions, spins, and hold times of
+//                         every lock, for `Spinlock::print_stats()`.
+
+#ifdef LENSOR_OS_LOCK_STATS
+struct SpinlockStats {
+    u64 Acquisitions { 0 };
+    /// Acquisitions that found the lock already held.
+    u64 Contended { 0 };
+    /// Iterations of the spin loop, over all acquisitions.
+    u64 Spins { 0 };
+    /// Time stamp counter cycles the lock has been held for.
+    u64 TotalHoldCycles { 0 };
+    u64 MaxHoldCycles { 0 };
+};
+#endif
 
+/// A fair spinlock: each locker takes a ticket, and the lock is handed
+/// over in ticket order, so nobody can be starved by luckier CPUs.
+/// Waiters spin on a read (with `pause`), not on the atomic operation.
+///
+/// A lock that is ever taken by an interrupt handler must be taken with
+/// interrupts disabled everywhere else (`lock_irqsave()`), otherwise the
+/// handler may spin on a lock the code it interrupted holds, forever.
+class Spinlock {
 public:
-    Spinlock() : locked(false) {}
-    bool get() { return locked; }
+    /// Constant expressions, so that static locks are initialised at
+    /// compile time (global constructors are never run).
+    constexpr Spinlock() = default;
+    /// Locks with the same name are considered the same kind of lock by
+    /// the lock order checks, and are reported under that name.
+    constexpr explicit Spinlock(const char* name) : Name(name) {}
+
+    Spinlock(const Spinlock&) = delete;
+    Spinlock& operator=(const Spinlock&) = delete;
+
+#ifdef LENSOR_OS_LOCK_STATS
+    ~Spinlock();
+#endif
+
+    void lock();
+    /// @return true iff the lock was free and is now held.
+    bool try_lock();
+    void unlock();
+
+    /// Disable interrupts, then lock.
+    /// @return The previous interrupt state, for `unlock_irqrestore()`.
+    [[nodiscard]] u64 lock_irqsave();
+    /// Unlock, then restore the interrupt state `lock_irqsave()` returned.
+    void unlock_irqrestore(u64 flags);
+
+    /// Whether the lock is currently held (by anybody).
+    bool get() const { return Owner != Next; }
+    const char* name() const { return Name ? Name : "(unnamed)"; }
+
+#ifdef LENSOR_OS_LOCK_STATS
+    const SpinlockStats& stats() const { return Stats; }
+#endif
+    /// Print the contention statistics of every lock that has been
+    /// taken, if they are being collected at all.
+    static void print_stats();
 
 private:
-    volatile bool locked { false };
+    // The ticket currently being served, and the next ticket to hand
+    // out; the lock is free when they are equal. Both halves of one
+    // word, so that `try_lock()` can check and take it atomically.
+    union {
+        u32 Word { 0 };
+        struct {
+            volatile u16 Owner;
+            volatile u16 Next;
+        };
+    };
+    const char* Name { nullptr };
+
+    void acquired(bool contended, u64 spins);
+    void releasing();
+
+#ifdef LENSOR_OS_LOCK_DEBUG
+    friend struct LockDep;
+    /// Index of this lock's class for the order checks, plus one; zero
+    /// until first acquired.
+    u16 Class { 0 };
+#endif
+#ifdef LENSOR_OS_LOCK_STATS
+    SpinlockStats Stats;
+    u64 AcquiredAt { 0 };
+    /// Every lock that has been taken, for `print_stats()`.
+    Spinlock* NextWithStats { nullptr };
+    bool Registered { false };
+#endif
 };
 
 class SpinlockLocker {
@@ -39,34 +122,27 @@ public:
     explicit SpinlockLocker(Spinlock&);
     ~SpinlockLocker();
 
+    /// Unlock before going out of scope.
     void unlock();
 
 private:
     Spinlock& Lock;
+    bool Held { true };
+};
+
+/// Like `SpinlockLocker`, but with interrupts disabled while locked.
+class SpinlockIRQSaveLocker {
+public:
+    explicit SpinlockIRQSaveLocker(Spinlock&);
+    ~SpinlockIRQSaveLocker();
+
+    /// Unlock (and restore interrupts) before going out of scope.
+    void unlock();
 
-    inline void lock();
-
-    /* Compare and Swap
-     *   If value at pointer is equal to expected value,
-     *     update value at pointer to new value.
-     *
-     *   This can be done atomically using the x86
-     *     `cmpxchg` instruction with a `lock` prefix.
-     *
-     *   Returns `true` when lock has been acquired.
-     */
-    inline bool compare_and_swap_lock();
-
-    /* Test and Set
-     *   Cache original value of lock, then set the value to the new value.
-     *   If the old value is equal to `false`, the lock has been acquired.
-     *
-     *   This can be done atomically using the x86
-     *     `xchg` instruction with a `lock` prefix.
-     *
-     *   Returns `false` when lock has been acquired.
-     */
-    inline bool test_and_set_lock();
+private:
+    Spinlock& Lock;
+    u64 Flags;
+    bool Held { true };
 };
 
 #endif /* if not defined LENSOR_OS_SPIN_LOCK_H */
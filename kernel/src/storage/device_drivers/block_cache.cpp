@@ -0,0 +1,231 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <storage/device_drivers/block_cache.h>
+
+#include <memory/physical_memory_manager.h>
+
+#include <algorithm>
+#include <format>
+
+BlockCacheDriver::BlockCacheDriver(std::shared_ptr<StorageDeviceDriver> driver, bool writeBack, usz blocks)
+    : Driver(std::move(driver))
+    , WriteBack(writeBack)
+{
+    usz count = blocks;
+    if (not count) {
+        count = Memory::free_ram() / FreeMemoryDivisor / BlockSize;
+        count = std::max(MinimumBlocks, std::min(MaximumBlocks, count));
+    }
+    Blocks.resize(count);
+    usz buckets = 1;
+    while (buckets < count) buckets <<= 1;
+    Buckets.resize(buckets, nullptr);
+    Unused = count;
+    Staging = (u8*)Memory::request_pages(MaximumRunBlocks);
+}
+
+BlockCacheDriver::~BlockCacheDriver() {
+    if (WriteBack) sync();
+    for (auto& block : Blocks)
+        if (block.Data) Memory::free_page(block.Data);
+    if (Staging) Memory::free_pages(Staging, MaximumRunBlocks);
+}
+
+auto BlockCacheDriver::try_create(std::shared_ptr<StorageDeviceDriver> driver, bool writeBack, usz blocks) -> std::shared_ptr<BlockCacheDriver> {
+    if (not driver) return nullptr;
+    auto cache = std::make_shared<BlockCacheDriver>(std::move(driver), writeBack, blocks);
+    if (not cache->Staging) {
+        std::print("[BCACHE]:ERROR: Could not allocate {} staging pages\n", MaximumRunBlocks);
+        return nullptr;
+    }
+    return cache;
+}
+
+BlockCacheDriver::Block* BlockCacheDriver::find(u64 number) {
+    for (Block* block = bucket(number); block; block = block->HashNext)
+        if (block->Number == number) return block;
+    return nullptr;
+}
+
+void BlockCacheDriver::unhash(Block* block) {
+    for (Block** it = &bucket(block->Number); *it; it = &(*it)->HashNext) {
+        if (*it == block) {
+            *it = block->HashNext;
+            block->HashNext = nullptr;
+            return;
+        }
+    }
+}
+
+BlockCacheDriver::Block* BlockCacheDriver::take(u64 number) {
+    Block* block = nullptr;
+    if (Unused) {
+        block = &Blocks[Blocks.size() - Unused];
+        block->Data = (u8*)Memory::request_page();
+        // Leave it unused for next time; the caller does without.
+        if (not block->Data) return nullptr;
+        --Unused;
+    } else {
+        // Give every block that has been used since the hand last came
+        // around a second chance.
+        for (;;) {
+            Block& candidate = Blocks[Hand];
+            Hand = (Hand + 1) % Blocks.size();
+            if (not candidate.Referenced) {
+                block = &candidate;
+                break;
+            }
+            candidate.Referenced = false;
+        }
+        if (block->Dirty and not write_back(block)) return nullptr;
+        unhash(block);
+        ++Stats.Evictions;
+    }
+    block->Number = number;
+    block->Referenced = true;
+    block->Dirty = false;
+    block->HashNext = bucket(number);
+    bucket(number) = block;
+    return block;
+}
+
+bool BlockCacheDriver::write_back(Block* block) {
+    if (Driver->write(nullptr, block->Number * BlockSize, BlockSize, block->Data) != ssz(BlockSize)) {
+        std::print("[BCACHE]:ERROR: Could not write back block {}\n", block->Number);
+        return false;
+    }
+    block->Dirty = false;
+    ++Stats.Writebacks;
+    return true;
+}
+
+bool BlockCacheDriver::read_blocks(u64 number, usz count) {
+    return Driver->read_raw(number * BlockSize, count * BlockSize, Staging) == ssz(count * BlockSize);
+}
+
+bool BlockCacheDriver::sync() {
+    bool ok = true;
+    for (auto& block : Blocks)
+        if (block.Dirty and not write_back(&block)) ok = false;
+    return ok;
+}
+
+ssz BlockCacheDriver::read_raw(usz offs, usz bytes, void* buffer) {
+    if (not buffer) return -1;
+
+    u8* out = (u8*)buffer;
+    u64 number = offs / BlockSize;
+    usz within = offs % BlockSize;
+    usz left = bytes;
+    // Copy the part of the block in DATA this read wants, and move on.
+    auto consume = [&](const u8* data) {
+        usz n = std::min(left, BlockSize - within);
+        memcpy(out, data + within, n);
+        out += n;
+        left -= n;
+        within = 0;
+        ++number;
+    };
+
+    while (left) {
+        if (Block* block = find(number)) {
+            ++Stats.Hits;
+            block->Referenced = true;
+            consume(block->Data);
+            continue;
+        }
+
+        // Read every block this read still needs, up to the next one
+        // that is cached, in a single request.
+        usz needed = (within + left + BlockSize - 1) / BlockSize;
+        usz run = 1;
+        while (run < MaximumRunBlocks and run < needed and not find(number + run))
+            ++run;
+        if (not read_blocks(number, run)) return -1;
+        Stats.Misses += run;
+        for (usz i = 0; i < run; ++i) {
+            const u8* data = Staging + i * BlockSize;
+            if (Block* block = take(number))
+                memcpy(block->Data, data, BlockSize);
+            consume(data);
+        }
+    }
+    return ssz(bytes);
+}
+
+void BlockCacheDriver::prefetch(usz offs, usz bytes) {
+    bytes = std::min(bytes, capacity() / 2);
+    if (not bytes) return;
+
+    u64 number = offs / BlockSize;
+    const u64 last = (offs + bytes - 1) / BlockSize;
+    while (number <= last) {
+        if (find(number)) {
+            ++number;
+            continue;
+        }
+        usz run = 1;
+        while (run < MaximumRunBlocks and number + run <= last and not find(number + run))
+            ++run;
+        if (not read_blocks(number, run)) return;
+        Stats.Prefetched += run;
+        for (usz i = 0; i < run; ++i)
+            if (Block* block = take(number + i))
+                memcpy(block->Data, Staging + i * BlockSize, BlockSize);
+        number += run;
+    }
+}
+
+ssz BlockCacheDriver::write(FileMetadata* file, usz offs, usz bytes, void* buffer) {
+    if (not buffer) return -1;
+    if (not WriteBack) {
+        ssz rc = Driver->write(file, offs, bytes, buffer);
+        if (rc < 0) return rc;
+    }
+
+    const u8* in = (const u8*)buffer;
+    u64 number = offs / BlockSize;
+    usz within = offs % BlockSize;
+    usz left = bytes;
+    while (left) {
+        usz n = std::min(left, BlockSize - within);
+        Block* block = find(number);
+        if (not block and WriteBack) {
+            // The rest of a partially written block has to come from
+            // the device first.
+            bool whole = n == BlockSize;
+            if (not whole and not read_blocks(number, 1)) return -1;
+            block = take(number);
+            if (not block) return -1;
+            if (not whole) memcpy(block->Data, Staging, BlockSize);
+            ++Stats.Misses;
+        }
+        if (block) {
+            memcpy(block->Data + within, in, n);
+            block->Referenced = true;
+            block->Dirty = WriteBack;
+        }
+        in += n;
+        left -= n;
+        within = 0;
+        ++number;
+    }
+    return ssz(bytes);
+}
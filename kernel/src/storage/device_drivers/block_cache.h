@@ -0,0 +1,128 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_BLOCK_CACHE_DRIVER_H
+#define LENSOR_OS_BLOCK_CACHE_DRIVER_H
+
+#include <integers.h>
+#include <memory/common.h>
+#include <storage/storage_device_driver.h>
+
+#include <memory>
+#include <vector>
+
+/// Keeps the most recently used blocks of the storage device it wraps
+/// in memory, so that a filesystem reading the same sectors over and
+/// over (its tables, directories, the same executable run again and
+/// again) only goes to the device once. Blocks are found through a
+/// hash table and evicted in CLOCK order. Consecutive blocks that miss
+/// are read in a single request to the device.
+///
+/// Writes go straight through to the device, updating any cached copy,
+/// unless write-back is enabled; then they only land in the cache, and
+/// reach the device once the block is evicted or `sync` is called.
+struct BlockCacheDriver final : StorageDeviceDriver {
+    static constexpr usz BlockSize = PAGE_SIZE;
+    /// The cache takes up this fraction of free memory when created,
+    /// within the bounds below.
+    static constexpr usz FreeMemoryDivisor = 32;
+    static constexpr usz MinimumBlocks = 64;
+    static constexpr usz MaximumBlocks = 16384;
+    /// The most consecutive missing blocks read in one request.
+    static constexpr usz MaximumRunBlocks = 32;
+
+    struct Statistics {
+        u64 Hits { 0 };
+        u64 Misses { 0 };
+        u64 Evictions { 0 };
+        /// Dirty blocks written to the device.
+        u64 Writebacks { 0 };
+        /// Blocks read from the device before anyone asked for them.
+        u64 Prefetched { 0 };
+    };
+
+    /// A cache of BLOCKS blocks, or one sized by free memory if zero.
+    explicit BlockCacheDriver(std::shared_ptr<StorageDeviceDriver> driver, bool writeBack = false, usz blocks = 0);
+    ~BlockCacheDriver();
+
+    /// @return A cache in front of DRIVER, or NULL if there isn't the
+    ///   memory for one.
+    static auto try_create(std::shared_ptr<StorageDeviceDriver> driver, bool writeBack = false, usz blocks = 0) -> std::shared_ptr<BlockCacheDriver>;
+
+    void close(FileMetadata* file) final { Driver->close(file); }
+    auto open(std::string_view path) -> std::shared_ptr<FileMetadata> final { return Driver->open(path); }
+
+    /// The device is cached as a whole; reading a file from it is no
+    /// different from reading the device.
+    ssz read(FileMetadata*, usz offs, usz bytes, void* buffer) final {
+        return read_raw(offs, bytes, buffer);
+    }
+    ssz read_raw(usz offs, usz bytes, void* buffer) final;
+    ssz write(FileMetadata* file, usz offs, usz bytes, void* buffer) final;
+    /// Read the blocks in the given range that aren't cached yet, in as
+    /// few requests as possible. At most half the cache is used, so
+    /// that reading far ahead doesn't push out what is being read now.
+    void prefetch(usz offs, usz bytes) final;
+
+    /// Write every dirty block back to the device.
+    /// @return false iff any of them couldn't be.
+    bool sync();
+
+    const Statistics& stats() const { return Stats; }
+    /// @return How many bytes of the device may be cached at once.
+    usz capacity() const { return Blocks.size() * BlockSize; }
+
+private:
+    struct Block {
+        /// Index of the block on the device.
+        u64 Number { 0 };
+        /// One page, allocated the first time the block is used.
+        u8* Data { nullptr };
+        Block* HashNext { nullptr };
+        /// Set on every use; cleared as the clock hand passes over.
+        bool Referenced { false };
+        bool Dirty { false };
+    };
+
+    std::shared_ptr<StorageDeviceDriver> Driver;
+    bool WriteBack { false };
+    std::vector<Block> Blocks;
+    /// Heads of the hash chains; the count is a power of two.
+    std::vector<Block*> Buckets;
+    /// Blocks that have yet to be used at all, from the end of `Blocks`.
+    usz Unused { 0 };
+    usz Hand { 0 };
+    /// Consecutive missing blocks are read in here in one go.
+    u8* Staging { nullptr };
+    Statistics Stats;
+
+    Block*& bucket(u64 number) { return Buckets[number & (Buckets.size() - 1)]; }
+    Block* find(u64 number);
+    /// Get a block to hold block NUMBER of the device: an unused one if
+    /// there are any left, otherwise one evicted by the clock.
+    /// @return NULL iff a dirty block couldn't be written back, or there
+    ///   is no memory left for a block that has yet to be used.
+    Block* take(u64 number);
+    void unhash(Block*);
+    bool write_back(Block*);
+    /// Read COUNT blocks starting at block NUMBER into `Staging`.
+    bool read_blocks(u64 number, usz count);
+};
+
+#endif /* LENSOR_OS_BLOCK_CACHE_DRIVER_H */
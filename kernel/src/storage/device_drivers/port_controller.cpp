@@ -288,6 +288,7 @@ ssz PortController::write_raw(usz byteOffset, usz byteCount, void* buffer) {
         DBGMSG("write_low_level(): \033[32mSUCCEEDED!\033[m\n");
 
     } else {
+        memcpy(Buffer, buffer, byteCount);
         if (!write_low_level(sector, sectors)) {
             std::print("write_low_level(): \033[31mFAILED!\033[m\n");
             return -1;
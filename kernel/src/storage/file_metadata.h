@@ -63,6 +63,22 @@ struct FileMetadata {
     }
 
     usz offset { 0 };
+    /// Milliseconds that a blocking read (or accept) on this file will
+    /// wait before giving up; zero means wait forever.
+    usz timeout { 0 };
+
+    /// How the file has been read so far, so that the VFS can tell when
+    /// it's being read sequentially and have what comes next fetched
+    /// ahead of time.
+    struct ReadAhead {
+        /// Where the next read starts if the file is read sequentially.
+        usz Next { 0 };
+        /// How far past the end of a read to fetch; grows with each
+        /// sequential read.
+        usz Window { 0 };
+        /// Everything up to here has been fetched already.
+        usz FetchedTo { 0 };
+    } read_ahead;
 
     auto name() -> std::string_view { return Name; }
     auto invalid() -> bool { return Invalid; }
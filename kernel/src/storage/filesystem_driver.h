@@ -25,12 +25,44 @@
 
 // Forward declaration; full definition in `./file_metadata.h`
 struct DirectoryEntry;
+// Forward declarations; full definitions in `/kernel/src/event.h`
+enum struct EventType : u32;
+struct EventSource;
 
 struct FilesystemDriver : StorageDeviceDriver {
     virtual ssz read(FileMetadata* file, usz offs, usz size, void* buffer) = 0;
     virtual ssz write(FileMetadata* file, usz offset, usz size, void* buffer) = 0;
     virtual ssz flush(FileMetadata* file) = 0;
 
+    /// Drivers that keep a file's data in an in-memory buffer (pipes,
+    /// sockets) may let it be filled in place, rather than copied into
+    /// by `write`; this is what lets `splice` skip the bounce buffer.
+    /// On success, SPACE points to the free space at the end of the
+    /// buffer, and the amount of it is returned; -2 means the caller
+    /// should block until there is room, just like `write`. Once
+    /// filled, the caller must hand the amount written to
+    /// `commit_write`. By default, files can't be written in place.
+    virtual ssz reserve_write(FileMetadata*, u8*& space) {
+        space = nullptr;
+        return -1;
+    }
+    virtual void commit_write(FileMetadata*, usz) {}
+
+    /// Drivers of files that become ready to read or write over time
+    /// (pipes, sockets) return the source that is notified when the
+    /// file becomes ready for TYPE, so that event queues may register
+    /// on it. By default, files never notify anyone.
+    virtual EventSource* event_source(FileMetadata*, EventType) { return nullptr; }
+    /// @return How many bytes may be read from (READY_TO_READ) or
+    ///   written to (READY_TO_WRITE) the file without blocking, or -1
+    ///   if doing so would block right now.
+    virtual ssz ready(FileMetadata*, EventType) { return -1; }
+
+    /// Like `StorageDeviceDriver::prefetch`, but for bytes of a file.
+    /// Drivers of files on a device pass the hint along to it; by
+    /// default, nothing happens.
+    virtual void prefetch(FileMetadata*, usz /* offs */, usz /* size */) {}
+
     virtual ssz directory_data(std::string_view path, usz max_entry_count, DirectoryEntry* out) = 0;
 
     virtual auto device() -> std::shared_ptr<StorageDeviceDriver> = 0;
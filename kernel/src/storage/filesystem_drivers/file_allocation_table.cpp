@@ -17,6 +17,7 @@
  * along with LensorOS. If not, see <https://www.gnu.org/licenses
  */
 
+#include <algorithm>
 #include <fat_definitions.h>
 #include <format>
 #include <integers.h>
@@ -35,23 +36,6 @@
 #   define DBGMSG(...)
 #endif
 
-std::string FileAllocationTableDriver::pop_filename_from_front_of_path(std::string& raw_path) {
-    /// Strip leading slash.
-    std::string path = raw_path;
-    if (path.starts_with("/")) path = path.substr(1);
-    if (path.size() < 1) return raw_path;
-
-    raw_path = path;
-    size_t first_sep = path.find_first_of("/");
-    if (first_sep == std::string::npos) return path;
-
-    std::string out = path.substr(0, first_sep);
-    raw_path = path.substr(first_sep);
-    // Special handling of trailing directory separator.
-    if (raw_path == "/") raw_path = out;
-    return out;
-}
-
 void FileAllocationTableDriver::print_fat(BootRecord& br) {
     std::print("File Allocation Table Boot Record:\n"
                "  Total Clusters:      {}\n"
@@ -275,85 +259,211 @@ auto FileAllocationTableDriver::translate_filename(std::string_view raw_filename
     // UNREACHABLE();
 }
 
-FileAllocationTableDriver::DirIteratorHelper::Iterator::Iterator(FileAllocationTableDriver& driver, u32 directoryCluster)
-: Driver(driver), ClusterIndex(directoryCluster) {
-    /// Read first entry. This MUST initialise MoreClusters to false
-    /// if there are are no entries at all. In other words, when this
-    /// function returns, either MoreClusters is false or Entry contains
-    /// a valid entry.
-    ReadNextCluster();
-    ++*this;
+auto FileAllocationTableDriver::fat_byte(usz offset) -> u8* {
+    const usz fatBytes = BR.fat_sectors() * BR.BPB.NumBytesPerSector;
+    if (offset >= fatBytes) return nullptr;
+
+    if (FATChunks.empty())
+        FATChunks.resize((fatBytes + FATChunkBytes - 1) / FATChunkBytes);
+
+    const usz index = offset / FATChunkBytes;
+    auto& chunk = FATChunks[index];
+    if (chunk.empty()) {
+        const usz bytes = std::min(FATChunkBytes, fatBytes - index * FATChunkBytes);
+        const usz start = BR.BPB.first_fat_sector() * BR.BPB.NumBytesPerSector + index * FATChunkBytes;
+        chunk.resize(bytes);
+        if (Device->read_raw(start, bytes, chunk.data()) != ssz(bytes)) {
+            std::print("[FAT]: Could not read FAT bytes {} through {}\n", start, start + bytes);
+            chunk.clear();
+            return nullptr;
+        }
+    }
+    return &chunk[offset % FATChunkBytes];
 }
 
-void FileAllocationTableDriver::DirIteratorHelper::Iterator::ReadNextCluster() {
-    const u64 clusterSector = Driver.BR.cluster_to_sector(ClusterIndex);
-    Driver.Device->read_raw(clusterSector * Driver.BR.BPB.NumBytesPerSector, ClusterSize, ClusterContents.data());
-    Entry.CE = reinterpret_cast<ClusterEntry*>(ClusterContents.data());
-    Entry.LongFileName.clear();
-    ClearLFN = false;
-}
+u32 FileAllocationTableDriver::next_cluster(u32 cluster) {
+    if (cluster < 2 || cluster >= BR.total_clusters() + 2) return EndOfChain;
 
-void FileAllocationTableDriver::DirIteratorHelper::Iterator::TryReadNextCluster() {
-    // Check if this is the last cluster in the chain.
-    const u64 clusterNumber = Entry.CE->get_cluster_number();
-    u64 FAToffset = 0;
-    switch (Driver.Type) {
-        case FATType::FAT12: FAToffset = clusterNumber + (clusterNumber / 2); break;
-        case FATType::FAT16: FAToffset = clusterNumber * 2; break;
+    usz offset = 0;
+    usz width = 4;
+    switch (Type) {
+        case FATType::FAT12: offset = cluster + (cluster / 2); width = 2; break;
+        case FATType::FAT16: offset = cluster * 2; width = 2; break;
         case FATType::ExFAT:
         case FATType::FAT32:
         default:
-            FAToffset = clusterNumber * 4;
+            offset = cluster * 4;
             break;
     }
 
-    const u64 FATsector = Driver.BR.BPB.first_fat_sector() + (FAToffset / Driver.BR.BPB.NumBytesPerSector);
-    const u64 entryOffset = FAToffset % Driver.BR.BPB.NumBytesPerSector;
-    if (entryOffset <= 1 || FATsector == LastFATSector) {
-        MoreClusters = false;
-        return;
+    // A FAT12 entry may straddle two chunks, so go byte by byte.
+    u32 value = 0;
+    for (usz i = 0; i < width; ++i) {
+        u8* byte = fat_byte(offset + i);
+        if (!byte) return EndOfChain;
+        value |= u32(*byte) << (i * 8);
     }
 
-    std::vector<u8> FAT(Driver.BR.BPB.NumBytesPerSector);
-    LastFATSector = FATsector;
-    Driver.Device->read_raw(FATsector * Driver.BR.BPB.NumBytesPerSector, Driver.BR.fat_sectors() * Driver.BR.BPB.NumBytesPerSector, FAT.data());
-    u64 tableValue = 0;
-    switch (Driver.Type) {
+    // Values from the "bad cluster" marker upward end the chain.
+    switch (Type) {
         case FATType::FAT12:
-            tableValue = *(reinterpret_cast<u16*>(&FAT[entryOffset]));
-            if (clusterNumber & 0b1) tableValue >>= 4;
-            else tableValue &= 0x0fff;
-            if (tableValue >= 0x0ff8) MoreClusters = false;
-            // TODO: Hande tableValue == 0x0ff7 (bad cluster)
+            if (cluster & 0b1) value >>= 4;
+            else value &= 0x0fff;
+            if (value >= 0x0ff7) return EndOfChain;
             break;
         case FATType::FAT16:
-            tableValue = *(reinterpret_cast<u16*>(&FAT[entryOffset]));
-            tableValue &= 0xffff;
-            if (tableValue >= 0xfff8) MoreClusters = false;
-            // TODO: Hande tableValue == 0xfff7 (bad cluster)
+            if (value >= 0xfff7) return EndOfChain;
             break;
         case FATType::FAT32:
-            tableValue = *(reinterpret_cast<u32*>(&FAT[entryOffset]));
-            tableValue &= 0xfffffff;
-            if (tableValue >= 0x0ffffff8) MoreClusters = false;
-            // TODO: Hande tableValue == 0x0ffffff7 (bad cluster)
+            value &= 0x0fffffff;
+            if (value >= 0x0ffffff7) return EndOfChain;
             break;
         case FATType::ExFAT:
-            tableValue = *(reinterpret_cast<u32*>(&FAT[entryOffset]));
-            break;
         default:
+            if (value >= 0xfffffff7) return EndOfChain;
             break;
     }
 
-    ClusterIndex = tableValue;
-    if (MoreClusters) ReadNextCluster();
+    // A free cluster can't be part of a chain.
+    if (value < 2) return EndOfChain;
+    return value;
+}
+
+auto FileAllocationTableDriver::extents(u32 cluster, usz size) -> std::vector<Extent> {
+    const usz clusterBytes = BR.BPB.cluster_size();
+    const u64 totalClusters = BR.total_clusters();
+    std::vector<Extent> out;
+
+    // Counting hops keeps a corrupted, circular chain from hanging us.
+    usz offset = 0;
+    for (u64 hops = 0; cluster != EndOfChain && offset < size && hops < totalClusters; ++hops) {
+        if (cluster < 2) break;
+        const usz deviceOffset = BR.cluster_to_sector(cluster) * BR.BPB.NumBytesPerSector;
+        if (out.size() && out.back().DeviceOffset + out.back().Length == deviceOffset)
+            out.back().Length += clusterBytes;
+        else out.push_back({offset, deviceOffset, clusterBytes});
+        offset += clusterBytes;
+        cluster = next_cluster(cluster);
+    }
+
+    if (offset < size)
+        std::print("[FAT]: Cluster chain holds only {} of {} bytes\n", offset, size);
+
+    return out;
+}
+
+template <typename Transfer>
+ssz FileAllocationTableDriver::for_each_run(FileData* data, usz offs, usz size, u8* buffer, Transfer transfer) {
+    const auto& extents = data->Extents;
+
+    // Find the extent OFFS is in.
+    usz lo = 0;
+    usz hi = extents.size();
+    while (lo < hi) {
+        usz mid = lo + (hi - lo) / 2;
+        if (extents[mid].FileOffset + extents[mid].Length <= offs) lo = mid + 1;
+        else hi = mid;
+    }
+
+    usz done = 0;
+    for (usz i = lo; i < extents.size() && done < size; ++i) {
+        const Extent& extent = extents[i];
+        const usz within = offs + done - extent.FileOffset;
+        const usz bytes = std::min(size - done, extent.Length - within);
+        ssz rc = transfer(extent.DeviceOffset + within, bytes, buffer ? buffer + done : nullptr);
+        if (rc < 0) return done ? ssz(done) : rc;
+        done += usz(rc);
+        if (usz(rc) != bytes) break;
+    }
+    return ssz(done);
+}
+
+ssz FileAllocationTableDriver::read(FileMetadata* file, usz offs, usz size, void* buffer) {
+    auto* data = static_cast<FileData*>(file->driver_data());
+    if (!data || !buffer) return -1;
+    if (offs >= file->file_size()) return 0;
+    size = std::min(size, usz(file->file_size() - offs));
+
+    return for_each_run(data, offs, size, (u8*)buffer, [this](usz deviceOffset, usz bytes, u8* out) {
+        return Device->read_raw(deviceOffset, bytes, out);
+    });
+}
+
+void FileAllocationTableDriver::prefetch(FileMetadata* file, usz offs, usz size) {
+    auto* data = static_cast<FileData*>(file->driver_data());
+    if (!data || offs >= file->file_size()) return;
+    size = std::min(size, usz(file->file_size() - offs));
+
+    for_each_run(data, offs, size, nullptr, [this](usz deviceOffset, usz bytes, u8*) {
+        Device->prefetch(deviceOffset, bytes);
+        return ssz(bytes);
+    });
+}
+
+ssz FileAllocationTableDriver::write(FileMetadata* file, usz offs, usz size, void* buffer) {
+    auto* data = static_cast<FileData*>(file->driver_data());
+    if (!data || !buffer) return -1;
+
+    // Cached lookups may have come from the entries being overwritten.
+    if (file->is_directory()) invalidate_dentries();
+
+    if (offs >= file->file_size()) return -1;
+    size = std::min(size, usz(file->file_size() - offs));
+
+    return for_each_run(data, offs, size, (u8*)buffer, [this, file](usz deviceOffset, usz bytes, u8* in) {
+        return Device->write(file, deviceOffset, bytes, in);
+    });
+}
+
+void FileAllocationTableDriver::close(FileMetadata* file) {
+    delete static_cast<FileData*>(file->driver_data());
+    Device->close(file);
+}
+
+FileAllocationTableDriver::DirIteratorHelper::Iterator::Iterator(FileAllocationTableDriver& driver, u32 directoryCluster)
+: Driver(driver), ClusterIndex(directoryCluster) {
+    /// Read first entry. This MUST initialise MoreClusters to false
+    /// if there are are no entries at all. In other words, when this
+    /// function returns, either MoreClusters is false or Entry contains
+    /// a valid entry.
+    ReadNextCluster();
+    FindEntry();
+}
+
+void FileAllocationTableDriver::DirIteratorHelper::Iterator::ReadNextCluster() {
+    const u64 clusterSector = Driver.BR.cluster_to_sector(ClusterIndex);
+    Driver.Device->read_raw(clusterSector * Driver.BR.BPB.NumBytesPerSector, ClusterSize, ClusterContents.data());
+    Entry.CE = reinterpret_cast<ClusterEntry*>(ClusterContents.data());
+}
+
+void FileAllocationTableDriver::DirIteratorHelper::Iterator::TryReadNextCluster() {
+    const u32 next = Driver.next_cluster(ClusterIndex);
+    if (next == EndOfChain) {
+        MoreClusters = false;
+        return;
+    }
+    ClusterIndex = next;
+    ReadNextCluster();
 }
 
 auto FileAllocationTableDriver::DirIteratorHelper::Iterator::operator++() -> Iterator& {
-    // TODO: ExFAT will need it's own code flow, essentially.
     Entry.CE++;
+    FindEntry();
+    return *this;
+}
+
+void FileAllocationTableDriver::DirIteratorHelper::Iterator::FindEntry() {
+    // TODO: ExFAT will need it's own code flow, essentially.
     while (MoreClusters) {
-        while (Entry.CE->FileName[0] != 0) {
+        auto* end = reinterpret_cast<ClusterEntry*>(ClusterContents.data() + ClusterSize);
+        for (; Entry.CE < end; Entry.CE++) {
+            // A zero byte marks the end of the directory.
+            if (Entry.CE->FileName[0] == 0) {
+                MoreClusters = false;
+                return;
+            }
+
+            // Deleted entry.
             if (Entry.CE->FileName[0] == 0xe5)
                 continue;
 
@@ -367,7 +477,6 @@ auto FileAllocationTableDriver::DirIteratorHelper::Iterator::operator++() -> Ite
                 Entry.LongFileName += std::string((const char*) &lfn->Characters1[0], sizeof(u16) * 5);
                 Entry.LongFileName += std::string((const char*) &lfn->Characters2[0], sizeof(u16) * 6);
                 Entry.LongFileName += std::string((const char*) &lfn->Characters3[0], sizeof(u16) * 2);
-                Entry.CE++;
                 continue;
             }
 
@@ -395,14 +504,83 @@ auto FileAllocationTableDriver::DirIteratorHelper::Iterator::operator++() -> Ite
             std::print("    Found {}named \"{}\" (\"{}\")\n", fileType, Entry.FileName, Entry.LongFileName);
 #endif
 
-            Entry.ByteOffset = Driver.BR.cluster_to_sector(Entry.CE->get_cluster_number()) * Driver.BR.BPB.NumBytesPerSector;
-            return *this;
+            return;
         }
 
         TryReadNextCluster();
     }
+}
 
-    return *this;
+bool FileAllocationTableDriver::lookup(u32 directoryCluster, std::string_view name, Target& out) {
+    // ".." entries refer to the root directory as cluster zero.
+    if (directoryCluster == 0)
+        directoryCluster = BR.sector_to_cluster(BR.first_root_directory_sector());
+
+    Dentry* dentry = nullptr;
+    if (name.size() <= Dentry::NameMax) {
+        // FNV-1a over the name, seeded with the directory.
+        u64 hash = 0xcbf29ce484222325 ^ directoryCluster;
+        for (char c : name) hash = (hash ^ u8(c)) * 0x100000001b3;
+        dentry = &Dentries[hash & (DentryCount - 1)];
+
+        if (dentry->Valid
+            && dentry->Parent == directoryCluster
+            && std::string_view(dentry->Name, dentry->NameLength) == name) {
+            out = dentry->Found;
+            return dentry->Exists;
+        }
+    }
+
+    // Translate filename (FAT has very limited file names).
+    std::string filename = translate_filename(name);
+    DBGMSG("[FAT]: Looking up \"{}\" (\"{}\") in directory at cluster {}\n", name, filename, directoryCluster);
+
+    bool exists = false;
+    for (const auto& Entry : for_each_dir_entry_in(directoryCluster)) {
+        if (Entry.FileName != filename && Entry.LongFileName != filename) continue;
+        out.Cluster = Entry.CE->get_cluster_number();
+        out.Size = Entry.CE->FileSizeInBytes;
+        out.Directory = Entry.CE->directory();
+        exists = true;
+        break;
+    }
+
+    if (dentry) {
+        dentry->Parent = directoryCluster;
+        dentry->Found = exists ? out : Target{};
+        dentry->Valid = true;
+        dentry->Exists = exists;
+        dentry->NameLength = u8(name.size());
+        memcpy(dentry->Name, name.data(), name.size());
+    }
+    return exists;
+}
+
+bool FileAllocationTableDriver::walk(std::string_view path, u32 directoryCluster, Target& out) {
+    for (;;) {
+        while (path.starts_with("/")) path.remove_prefix(1);
+
+        // Given "foo/bar/baz.txt", look up "foo" and carry on with "bar/baz.txt".
+        usz separator = path.find_first_of("/");
+        std::string_view name = path.substr(0, separator);
+        path = separator == std::string_view::npos ? std::string_view{} : path.substr(separator);
+        if (not lookup(directoryCluster, name, out)) return false;
+
+        // A trailing separator doesn't name anything further.
+        while (path.starts_with("/")) path.remove_prefix(1);
+        if (path.size() == 0) return true;
+
+        // Otherwise, we need to descend into the directory.
+        if (not out.Directory) {
+            DBGMSG("[FAT]: Cannot follow path \"{}\" because \"{}\" is not a directory\n", path, name);
+            return false;
+        }
+        directoryCluster = out.Cluster;
+    }
+}
+
+void FileAllocationTableDriver::invalidate_dentries() {
+    for (auto& dentry : Dentries) dentry.Valid = false;
 }
 
 std::shared_ptr<FileMetadata> FileAllocationTableDriver::traverse_path(std::string_view raw_path, u32 directoryCluster) {
@@ -418,55 +596,30 @@ std::shared_ptr<FileMetadata> FileAllocationTableDriver::traverse_path(std::stri
         return {};
     }
 
-    // Get first filename from path.
-    // Given path "foo/bar/bas.exe", return "foo" as a legal FAT
-    // filename, and alter given path to be "past" that + directory
-    // separator.
-    std::string path = raw_path;
-    auto raw_filename = pop_filename_from_front_of_path(path);
-    DBGMSG("[FAT]:open(): Got filename \"{}\" and path \"{}\" from \"{}\"\n", raw_filename, path, raw_path);
-
-    // Translate path (FAT has very limited file names).
-    std::string filename = translate_filename(raw_filename);
-    DBGMSG("[FAT]:open(): Translated filename \"{}\" from \"{}\"\n", filename, raw_filename);
-
-    for (const auto& Entry : for_each_dir_entry_in(directoryCluster)) {
-        if (Entry.FileName != filename && Entry.LongFileName != filename) continue;
-        // If path and raw_filename are equal, we can not resolve any more
-        // filenames from full path; we have found the file.
-        if (path == raw_filename) {
-            DBGMSG("  Found file at {}!\n"
-                   "    Name: \"{}\"\n"
-                   "    Long: \"{}\"\n"
-                   , path
-                   , Entry.FileName
-                   , Entry.LongFileName
-                   );
-            FileMetadata::FileType ftype = Entry.CE->directory() ? FileMetadata::FileType::Directory : FileMetadata::FileType::Regular;
-            return FileMetadata::Make
-                       (ftype,
-                        std::move(filename),
-                        fsd(This.lock()),
-                        u32(Entry.CE->FileSizeInBytes),
-                        (void*) Entry.ByteOffset
-                        );
-        }
-
-        // Otherwise, we need to recurse into the directory.
-        if (!Entry.CE->directory()) {
-            std::print(R"([FAT]: Cannot follow path "{}" because "{}" is not a directory)", path, filename);
-            return {};
-        }
-
-        // Recurse into directory...
-        u32 dirCluster = Entry.CE->get_cluster_number();
-        //std::print("Recursing! Following {} at cluster {}\n", path, dirCluster);
-        return traverse_path(path, dirCluster);
+    Target target;
+    if (not walk(raw_path, directoryCluster, target)) {
+        /// No such file.
+        std::print("[FAT]: Could not find file at \"{}\", sorry\n", raw_path);
+        return {};
     }
 
-    /// No such file.
-    std::print("[FAT]: Could not find file at \"{}\", sorry\n", filename);
-    return {};
+    // The file is named by the last component of the path.
+    std::string_view name = raw_path;
+    while (name.size() > 1 && name.ends_with("/")) name.remove_suffix(1);
+    usz separator = name.find_last_of("/");
+    if (separator != std::string_view::npos) name = name.substr(separator + 1);
+
+    DBGMSG("  Found file at {}! (cluster {}, {} bytes)\n", raw_path, target.Cluster, target.Size);
+    FileMetadata::FileType ftype = target.Directory ? FileMetadata::FileType::Directory : FileMetadata::FileType::Regular;
+    auto* data = new FileData;
+    data->Extents = extents(target.Cluster, target.Size);
+    return FileMetadata::Make
+               (ftype,
+                translate_filename(name),
+                fsd(This.lock()),
+                target.Size,
+                data
+                );
 }
 
 auto FileAllocationTableDriver::open(std::string_view raw_path) -> std::shared_ptr<FileMetadata> {
@@ -34,7 +34,7 @@ class FileAllocationTableDriver final : public FilesystemDriver {
     explicit FileAllocationTableDriver(std::shared_ptr<StorageDeviceDriver>&& device, BootRecord&& br)
         : Device(std::move(device))
         , BR(std::move(br))
-        , Type(fat_type(BR)) {}
+        , Type(fat_type(BR)) { Dentries.resize(DentryCount); }
 
     /// Weak reference to ourselves. Every FileAllocationTableDriver is created
     /// as a shared_ptr. Upon creation, this is set to a weak_ptr to that
@@ -61,11 +61,93 @@ class FileAllocationTableDriver final : public FilesystemDriver {
     /// FAT type.
     FATType Type{};
 
+    /// The first copy of the FAT, read from the device in chunks of this
+    /// many bytes the first time any entry in them is needed.
+    static constexpr usz FATChunkBytes = 64 * 1024;
+    std::vector<std::vector<u8>> FATChunks{};
+
+    /// A run of clusters that are consecutive on the device.
+    struct Extent {
+        /// Offset into the file of the first byte of the run.
+        usz FileOffset;
+        /// Offset on the device of the first byte of the run.
+        usz DeviceOffset;
+        usz Length;
+    };
+
+    /// What `driver_data()` of a file we opened points to. The extents
+    /// are sorted by `FileOffset` and cover the whole file.
+    struct FileData {
+        std::vector<Extent> Extents;
+    };
+
+    /// Returned by next_cluster() at the end of a cluster chain.
+    static constexpr u32 EndOfChain = u32(-1);
+
+    /// What a name in a directory refers to.
+    struct Target {
+        u32 Cluster;
+        u32 Size;
+        bool Directory;
+    };
+
+    /// The outcome of looking up a name in a directory, including that
+    /// there is nothing by that name. Names longer than `NameMax` are
+    /// never cached.
+    struct Dentry {
+        static constexpr usz NameMax = 48;
+        u32 Parent{};
+        Target Found{};
+        bool Valid{false};
+        bool Exists{false};
+        u8 NameLength{};
+        char Name[NameMax]{};
+    };
+
+    /// Path lookups are cached here, so that opening the same paths over
+    /// and over (exec, the shell) doesn't read every directory along the
+    /// way each time. It is indexed by a hash of the parent directory and
+    /// the name; a new entry replaces whatever was in its slot.
+    static constexpr usz DentryCount = 512;
+    std::vector<Dentry> Dentries{};
+
     friend std::shared_ptr<FileAllocationTableDriver>
         std::make_shared(std::shared_ptr<StorageDeviceDriver>&& device, BootRecord&& br);
 
     static auto fat_type(BootRecord& br) -> FATType;
 
+    /// @return The byte at OFFSET into the FAT, or NULL if it couldn't
+    ///   be read.
+    auto fat_byte(usz offset) -> u8*;
+
+    /// @return The cluster after CLUSTER in its chain, or EndOfChain if
+    ///   it is the last one (or the chain is broken at it).
+    u32 next_cluster(u32 cluster);
+
+    /// Follow the cluster chain starting at CLUSTER far enough to hold
+    /// SIZE bytes, merging consecutive clusters into extents.
+    auto extents(u32 cluster, usz size) -> std::vector<Extent>;
+
+    /// Call TRANSFER(deviceOffset, bytes, buffer) for each piece of the
+    /// device that bytes [OFFS, OFFS + SIZE) of the file are stored in.
+    /// BUFFER is only ever offset and handed to TRANSFER; it may be NULL.
+    /// @return The number of bytes transferred, or -1 if the first
+    ///   transfer failed.
+    template <typename Transfer>
+    static ssz for_each_run(FileData* data, usz offs, usz size, u8* buffer, Transfer transfer);
+
+    /// Find NAME in the directory starting at DIRECTORYCLUSTER.
+    /// @return false iff there is no such file.
+    bool lookup(u32 directoryCluster, std::string_view name, Target& out);
+
+    /// Look up each component of PATH in turn, starting in the directory
+    /// at DIRECTORYCLUSTER.
+    /// @return false iff the path doesn't lead anywhere.
+    bool walk(std::string_view path, u32 directoryCluster, Target& out);
+
+    /// Forget every cached lookup.
+    void invalidate_dentries();
+
     /// This is so we have something that we can call begin() and end() on because
     /// calling begin()/end() on the driver itself would be a bit weird semantically.
     struct DirIteratorHelper {
@@ -82,14 +164,12 @@ class FileAllocationTableDriver final : public FilesystemDriver {
 
             /// Iteration data.
             std::vector<u8> ClusterContents{ClusterSize};
-            u64 LastFATSector = 0;
             bool MoreClusters = true;
             bool ClearLFN = false;
 
             /// The current entry.
             struct EntryType {
                 ClusterEntry* CE{};
-                u64 ByteOffset{};
                 std::string FileName;
                 std::string LongFileName;
             } Entry{};
@@ -101,6 +181,11 @@ class FileAllocationTableDriver final : public FilesystemDriver {
             bool operator!=(std::default_sentinel_t) const { return MoreClusters; }
 
         private:
+            /// Move forward from the current entry to the next file or
+            /// directory, reading more clusters as needed. If there isn’t
+            /// one, set MoreClusters to false.
+            void FindEntry();
+
             /// Read the next cluster unconditionally.
             void ReadNextCluster();
 
@@ -122,48 +207,13 @@ class FileAllocationTableDriver final : public FilesystemDriver {
     auto for_each_dir_entry() -> DirIteratorHelper { return DirIteratorHelper{*this}; }
     auto for_each_dir_entry_in(u32 directoryCluster) -> DirIteratorHelper { return DirIteratorHelper{*this, directoryCluster}; }
 
-    /// Given "/foo/bar/baz.txt" return "foo" and overwrite parameter to "bar/baz.txt"
-    /// Given "/bar/" return "bar" and overwrite parameter to "bar"
-    /// Given "/" return "/"
-    auto pop_filename_from_front_of_path(std::string &raw_path) -> std::string;
-
     // Takes a path that points to a directory and returns the directory
     // cluster for that directory, otherwise it returns -1.
     // NOTE: Returns -1 for not-a-directory problems.
     u32 traverse_path_for_cluster(std::string_view raw_path, u32 directory_cluster) {
-        std::string path(raw_path);
-        auto raw_filename = pop_filename_from_front_of_path(path);
-        auto filename = translate_filename(raw_filename);
-        for (const auto& Entry : for_each_dir_entry_in(directory_cluster)) {
-            // Skip unrelated entries.
-            if (Entry.FileName != filename and Entry.LongFileName != filename) continue;
-
-            // From this point on, we know we are dealing with an entry that refers to
-            // the front component of the path that was just popped off.
-
-            // If path and raw_filename are equal, we can not resolve any more
-            // filenames from full path; we have found the file the path points to.
-            //std::print("path:\"{}\" | raw_filename:\"{}\" | filename:\"{}\" \n", path, raw_filename, filename);
-            if (path == raw_filename) {
-                // If path was valid but doesn't point to directory, we can't get
-                // directory data from a non-directory.
-                if (not Entry.CE->directory()) return -1;
-                // Return the directory cluster.
-                return Entry.CE->get_cluster_number();
-            }
-
-            // Otherwise, there is more in the path to traverse, and we've just
-            // matched a part from the beginning. We need to further recurse into this
-            // directory; if it isn't a directory, then the path doesn't make sense
-            // and we error out.
-            if (!Entry.CE->directory()) return -1;
-
-            // Recurse into directory...
-            return traverse_path_for_cluster(path, Entry.CE->get_cluster_number());
-        }
-        // Didn't find front component of path in directory pointed to by given
-        // directory cluster.
-        return -1;
+        Target target;
+        if (not walk(raw_path, directory_cluster, target) or not target.Directory) return -1;
+        return target.Cluster;
     }
 
     /// NOTE: If directoryCluster == -1 (default), it will be replaced
@@ -174,23 +224,18 @@ public:
     static void print_fat(BootRecord&);
 
     auto open(std::string_view path) -> std::shared_ptr<FileMetadata> final;
-    void close(FileMetadata* file) final { Device->close(file); }
+    void close(FileMetadata* file) final;
 
-    ssz read(FileMetadata* file, usz offs, usz size, void* buffer) final {
-        return Device->read_raw(usz(file->driver_data()) + offs, size, buffer);
-    }
+    ssz read(FileMetadata* file, usz offs, usz size, void* buffer) final;
+    void prefetch(FileMetadata* file, usz offs, usz size) final;
 
     ssz read_raw(usz offs, usz bytes, void* buffer) final {
         return Device->read_raw(offs, bytes, buffer);
     }
 
-    ssz write(FileMetadata* file, usz offset, usz size, void* buffer) final {
-        // TODO: Fail? if this would increase file size. I feel like we
-        // don't want to write past the end of the file, just in case
-        // there is stuff there, right? So we will have to figure out
-        // how to make a file bigger in FAT.
-        return Device->write(file, usz(file->driver_data()) + offset, size, buffer);
-    }
+    /// Writes are cut short at the end of the file.
+    // TODO: Figure out how to make a file bigger in FAT.
+    ssz write(FileMetadata* file, usz offset, usz size, void* buffer) final;
 
     ssz flush(FileMetadata* file) final { return -1; };
 
@@ -206,9 +251,6 @@ public:
 
         // If path isn't empty and isn't root, traverse path and ensure we end up
         // in a directory.
-        // FIXME: This is basically three-quarters of `traverse_path`, but it
-        // doesn't return a FileMetadata, just a directory cluster number. Could
-        // abstract easily.
         if (path.size() and path != std::string_view("/")) {
             u32 new_directory_cluster = traverse_path_for_cluster(path, directory_cluster);
             if (new_directory_cluster == u32(-1)) return -1;
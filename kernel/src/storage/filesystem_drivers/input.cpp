@@ -19,6 +19,7 @@
 
 #include <storage/filesystem_drivers/input.h>
 
+#include <pit.h>
 #include <storage/file_metadata.h>
 #include <system.h>
 #include <scheduler.h>
@@ -36,6 +37,9 @@
 # define DBGMSG(...)
 #endif
 
+// Uncomment the following directive to periodically print input latency.
+//#define PRINT_INPUT_LATENCY
+
 void InputDriver::close(FileMetadata* file) {
     if (!file) return;
     auto* input = static_cast<InputBuffer*>(file->driver_data());
@@ -83,6 +87,8 @@ ssz InputDriver::read(FileMetadata* file, usz, usz bytes, void* buffer) {
 
     memcpy(buffer, input->Data, bytes);
 
+    record_latency(gPIT.milliseconds_since_boot() - input->OldestWriteTime);
+
     // "Pop" bytes read off beginning of buffer.
     // Only on the heap to prevent stack overflow.
     auto temp = new u8[INPUT_BUFSZ];
@@ -92,6 +98,8 @@ ssz InputDriver::read(FileMetadata* file, usz, usz bytes, void* buffer) {
 
     // Set write offset back, as we have just removed from the beginning.
     input->Offset -= bytes;
+    // Whatever is left over has been waiting since at least now.
+    if (input->Offset) input->OldestWriteTime = gPIT.milliseconds_since_boot();
 
     return ssz(bytes);
 }
@@ -104,6 +112,8 @@ ssz InputDriver::write(FileMetadata* file, usz, usz bytes, void* buffer) {
         // TODO: Support "wait if full". For now, just truncate write.
         bytes = INPUT_BUFSZ - input->Offset;
     }
+    if (input->Offset == 0)
+        input->OldestWriteTime = gPIT.milliseconds_since_boot();
     memcpy(input->Data + input->Offset, buffer, bytes);
     input->Offset += bytes;
 
@@ -121,3 +131,36 @@ ssz InputDriver::write(FileMetadata* file, usz, usz bytes, void* buffer) {
 
     return ssz(bytes);
 }
+
+void InputDriver::record_latency(usz milliseconds) {
+    usz bucket = 0;
+    while (bucket < LatencyBucketCount - 1 && milliseconds >= (usz(1) << bucket))
+        ++bucket;
+    LatencyBuckets[bucket] += 1;
+    LatencySamples += 1;
+    if (milliseconds > LatencyMax) LatencyMax = milliseconds;
+#ifdef PRINT_INPUT_LATENCY
+    if (LatencySamples % 64 == 0) print_latency();
+#endif
+}
+
+void InputDriver::print_latency() {
+    if (!LatencySamples) return;
+    // Upper bound (in milliseconds) of the bucket that contains the
+    // given percentile of samples.
+    auto percentile = [this](usz percent) -> usz {
+        usz wanted = (LatencySamples * percent + 99) / 100;
+        usz seen = 0;
+        for (usz bucket = 0; bucket < LatencyBucketCount - 1; ++bucket) {
+            seen += LatencyBuckets[bucket];
+            if (seen >= wanted) return usz(1) << bucket;
+        }
+        return LatencyMax;
+    };
+    std::print("[INPUT]: Input-to-read latency over {} reads: p50 < {}ms, p99 < {}ms, max {}ms\n"
+               , LatencySamples
+               , percentile(50)
+               , percentile(99)
+               , LatencyMax
+               );
+}
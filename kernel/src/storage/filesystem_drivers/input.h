@@ -31,11 +31,13 @@
 #include <scheduler.h>
 
 // NOTE: This is an attempt to keep `sizeof(InputBuffer)` == PAGE_SIZE
-#define INPUT_BUFSZ PAGE_SIZE - sizeof(usz) - sizeof(std::vector<pid_t>)
+#define INPUT_BUFSZ PAGE_SIZE - sizeof(usz) - sizeof(usz) - sizeof(std::vector<pid_t>)
 
 struct InputBuffer {
     u8 Data[INPUT_BUFSZ];
     usz Offset{};
+    /// Milliseconds since boot at which the oldest unread byte was written.
+    usz OldestWriteTime{};
     std::vector<pid_t> PIDsWaiting{};
 
     constexpr InputBuffer() = default;
@@ -76,9 +78,22 @@ struct InputDriver final : FilesystemDriver {
         return "Input";
     };
 
+    /// Print a summary of how long input sat in a buffer before being
+    /// read (i.e. keystroke to shell wakeup latency).
+    void print_latency();
+
 private:
     std::vector<NamedInputBuffer> InputBuffers;
     std::vector<InputBuffer*> FreeInputBuffers;
+
+    /// Bucket N counts reads that happened less than 2^N milliseconds
+    /// after the data was written; the last bucket catches the rest.
+    static constexpr usz LatencyBucketCount = 12;
+    usz LatencyBuckets[LatencyBucketCount] {};
+    usz LatencySamples { 0 };
+    usz LatencyMax { 0 };
+
+    void record_latency(usz milliseconds);
 };
 
 #endif /* LENSOR_OS_INPUT_DRIVER_H */
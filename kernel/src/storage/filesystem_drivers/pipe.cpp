@@ -57,6 +57,8 @@ void PipeDriver::close(FileMetadata* meta) {
             process->unblock(true, -1);
         }
         pipeBuffer->PIDsWaitingOnReadToWrite.clear();
+        // Writes fail right away from now on.
+        pipeBuffer->Events.notify(EventType::READY_TO_WRITE, 0);
 
     } else {
         if (pipeBuffer->WriteClosed) {
@@ -76,6 +78,8 @@ void PipeDriver::close(FileMetadata* meta) {
             process->unblock(true, -1);
         }
         pipeBuffer->PIDsWaitingOnWriteToRead.clear();
+        // Reads return EOF right away once the pipe is drained.
+        pipeBuffer->Events.notify(EventType::READY_TO_READ, pipeBuffer->Offset);
     }
     //std::print("[PIPE]: close()  Freeing {} pipe end at {}  pipeBuffer={}\n", pipe->End == PipeEnd::READ ? "read" : "write", (void*)pipe, (void*)pipeBuffer);
     delete pipe;
@@ -187,6 +191,7 @@ ssz PipeDriver::read(FileMetadata* meta, usz, usz byteCount, void* buffer) {
         process->unblock(true, -2);
     }
     pipe->Buffer->PIDsWaitingOnReadToWrite.clear();
+    pipe->Buffer->Events.notify(EventType::READY_TO_WRITE, PIPE_BUFSZ - pipe->Buffer->Offset);
 
     return ssz(byteCount);
 };
@@ -217,6 +222,28 @@ ssz PipeDriver::write(FileMetadata* meta, usz, usz byteCount, void* buffer) {
     }
 
     memcpy(pipe->Buffer->Data + pipe->Buffer->Offset, buffer, byteCount);
+    commit_write(meta, byteCount);
+
+    return ssz(byteCount);
+}
+
+ssz PipeDriver::reserve_write(FileMetadata* meta, u8*& space) {
+    if (!meta) return -1;
+    auto* pipe = get_driver_data(meta);
+    if (!pipe) return -1;
+
+    if (pipe->Buffer->Offset == PIPE_BUFSZ) {
+        auto* process = Scheduler::CurrentProcess->value();
+        pipe->Buffer->PIDsWaitingOnReadToWrite.push_back(process->ProcessID);
+        return -2;
+    }
+
+    space = pipe->Buffer->Data + pipe->Buffer->Offset;
+    return ssz(PIPE_BUFSZ - pipe->Buffer->Offset);
+}
+
+void PipeDriver::commit_write(FileMetadata* meta, usz byteCount) {
+    auto* pipe = get_driver_data(meta);
     pipe->Buffer->Offset += byteCount;
 
     //std::print("[PIPE]: write()  Wrote {} bytes; new offset = {}\n", byteCount, pipe->Buffer->Offset);
@@ -231,8 +258,35 @@ ssz PipeDriver::write(FileMetadata* meta, usz, usz byteCount, void* buffer) {
         process->unblock(true, -2);
     }
     pipe->Buffer->PIDsWaitingOnWriteToRead.clear();
+    pipe->Buffer->Events.notify(EventType::READY_TO_READ, pipe->Buffer->Offset);
+}
 
-    return ssz(byteCount);
+EventSource* PipeDriver::event_source(FileMetadata* meta, EventType type) {
+    if (!meta) return nullptr;
+    auto* pipe = get_driver_data(meta);
+    if (!pipe) return nullptr;
+    if ((type == EventType::READY_TO_READ && pipe->End == PipeEnd::READ)
+        || (type == EventType::READY_TO_WRITE && pipe->End == PipeEnd::WRITE))
+        return &pipe->Buffer->Events;
+    return nullptr;
+}
+
+ssz PipeDriver::ready(FileMetadata* meta, EventType type) {
+    if (!meta) return -1;
+    auto* pipe = get_driver_data(meta);
+    if (!pipe) return -1;
+    if (type == EventType::READY_TO_READ && pipe->End == PipeEnd::READ) {
+        if (pipe->Buffer->Offset || pipe->Buffer->WriteClosed)
+            return ssz(pipe->Buffer->Offset);
+        return -1;
+    }
+    if (type == EventType::READY_TO_WRITE && pipe->End == PipeEnd::WRITE) {
+        if (pipe->Buffer->ReadClosed) return 0;
+        if (pipe->Buffer->Offset < PIPE_BUFSZ)
+            return ssz(PIPE_BUFSZ - pipe->Buffer->Offset);
+        return -1;
+    }
+    return -1;
 }
 
 auto PipeDriver::lay_pipe() -> PipeMetas {
@@ -52,8 +52,10 @@ struct PipeBuffer {
     bool WriteClosed{false};
     std::vector<pid_t> PIDsWaitingOnReadToWrite;
     std::vector<pid_t> PIDsWaitingOnWriteToRead;
+    /// Event queues listening to either end of the pipe.
+    EventSource Events;
 
-    constexpr PipeBuffer() = default;
+    PipeBuffer() = default;
     ~PipeBuffer() = default;
 
     /// Copying a pipe buffer is nonsense.
@@ -66,6 +68,7 @@ struct PipeBuffer {
     void clear() {
         PIDsWaitingOnReadToWrite.clear();
         PIDsWaitingOnWriteToRead.clear();
+        Events.detach();
         memset(&Data[0], 0, sizeof(Data));
         Offset = 0;
         ReadClosed = false;
@@ -108,6 +111,12 @@ struct PipeDriver final : FilesystemDriver {
     ssz write(FileMetadata* meta, usz, usz byteCount, void* buffer) final;
     ssz flush(FileMetadata* file) final { return -1; };
 
+    ssz reserve_write(FileMetadata* meta, u8*& space) final;
+    void commit_write(FileMetadata* meta, usz byteCount) final;
+
+    EventSource* event_source(FileMetadata* meta, EventType type) final;
+    ssz ready(FileMetadata* meta, EventType type) final;
+
     ssz directory_data(std::string_view path, usz max_entry_count, DirectoryEntry* out) final {
         return -1;
     }
@@ -112,6 +112,97 @@ ssz SocketDriver::write(FileMetadata* meta, usz, usz byteCount, void* buffer) {
     return -1;
 }
 
+ssz SocketDriver::reserve_write(FileMetadata* meta, u8*& space) {
+    if (!meta) return -1;
+    SocketData* data = (SocketData*)meta->driver_data();
+    if (!data) return -1;
+    switch (data->Type) {
+    case SocketType::LENSOR: {
+        SocketBuffers* buffers = (SocketBuffers*)data->Data;
+        if (!buffers) return -1;
+        switch (data->ClientServer) {
+        case SocketData::CLIENT:
+            return buffers->RXBuffer.reserve(Scheduler::CurrentProcess->value()->ProcessID, space);
+        case SocketData::SERVER:
+            return buffers->TXBuffer.reserve(Scheduler::CurrentProcess->value()->ProcessID, space);
+        }
+        UNREACHABLE();
+    }
+    }
+    return -1;
+}
+
+void SocketDriver::commit_write(FileMetadata* meta, usz byteCount) {
+    if (!meta) return;
+    SocketData* data = (SocketData*)meta->driver_data();
+    if (!data) return;
+    switch (data->Type) {
+    case SocketType::LENSOR: {
+        SocketBuffers* buffers = (SocketBuffers*)data->Data;
+        if (!buffers) return;
+        switch (data->ClientServer) {
+        case SocketData::CLIENT:
+            buffers->RXBuffer.commit(byteCount);
+            return;
+        case SocketData::SERVER:
+            buffers->TXBuffer.commit(byteCount);
+            return;
+        }
+        UNREACHABLE();
+    }
+    }
+}
+
+EventSource* SocketDriver::event_source(FileMetadata* meta, EventType type) {
+    if (!meta) return nullptr;
+    SocketData* data = (SocketData*)meta->driver_data();
+    if (!data) return nullptr;
+    // Connections waiting to be accepted.
+    if (data->Listening)
+        return type == EventType::READY_TO_READ ? &data->Events : nullptr;
+    switch (data->Type) {
+    case SocketType::LENSOR: {
+        SocketBuffers* buffers = (SocketBuffers*)data->Data;
+        if (!buffers) return nullptr;
+        bool client = data->ClientServer == SocketData::CLIENT;
+        switch (type) {
+        case EventType::READY_TO_READ:
+            return client ? &buffers->TXBuffer.Events : &buffers->RXBuffer.Events;
+        case EventType::READY_TO_WRITE:
+            return client ? &buffers->RXBuffer.Events : &buffers->TXBuffer.Events;
+        default: return nullptr;
+        }
+    }
+    }
+    return nullptr;
+}
+
+ssz SocketDriver::ready(FileMetadata* meta, EventType type) {
+    if (!meta) return -1;
+    SocketData* data = (SocketData*)meta->driver_data();
+    if (!data) return -1;
+    if (data->Listening) {
+        if (type != EventType::READY_TO_READ or not data->ConnectionQueue.size())
+            return -1;
+        return ssz(data->ConnectionQueue.size());
+    }
+    switch (data->Type) {
+    case SocketType::LENSOR: {
+        SocketBuffers* buffers = (SocketBuffers*)data->Data;
+        if (!buffers) return -1;
+        bool client = data->ClientServer == SocketData::CLIENT;
+        switch (type) {
+        case EventType::READY_TO_READ:
+            return client ? buffers->TXBuffer.readable() : buffers->RXBuffer.readable();
+        case EventType::READY_TO_WRITE:
+            return client ? buffers->RXBuffer.writable() : buffers->TXBuffer.writable();
+        default: return -1;
+        }
+    }
+    }
+    return -1;
+}
+
 auto SocketDriver::socket(SocketType domain, int type, int protocol) -> std::shared_ptr<FileMetadata> {
     switch (domain) {
     case SocketType::LENSOR: {
@@ -68,6 +68,9 @@ struct FIFOBuffer {
     /// List of PIDs of processes who are waiting to read from the
     /// txbuffer as it is empty.
     std::vector<pid_t> PIDsWaitingUntilWrite;
+    /// Event queues listening to the ends of the socket that read
+    /// from and write to this buffer.
+    EventSource Events;
 
     void clear() {
         memset(&Data[0], 0, sizeof(Data));
@@ -112,6 +115,7 @@ struct FIFOBuffer {
             process->unblock(true, -2);
         }
         PIDsWaitingUntilRead.clear();
+        Events.notify(EventType::READY_TO_WRITE, N - Offset);
 
         return ssz(byteCount);
     }
@@ -135,6 +139,27 @@ struct FIFOBuffer {
         // Transfer the data from the given buffer to the FIFO buffer.
         memcpy(Data + Offset, buffer, byteCount);
 
+        commit(byteCount);
+        return ssz(byteCount);
+    }
+
+    /// Point `space` at the free space at the end of this FIFOBuffer,
+    /// so that it may be written into directly.
+    /// \retval >0   Success, amount of free space.
+    /// \retval -2   Should block (will unblock when read from)
+    ssz reserve(pid_t pid, u8*& space) {
+        if (Offset == N) {
+            std::print("[SOCK]: Process {} waiting until read\n", pid);
+            PIDsWaitingUntilRead.push_back(pid);
+            return -2;
+        }
+        space = Data + Offset;
+        return ssz(N - Offset);
+    }
+
+    /// Account for `byteCount` bytes having been written to the end of
+    /// this FIFOBuffer, waking up anyone waiting to read them.
+    void commit(usz byteCount) {
         // Move write offset for next time.
         Offset += byteCount;
 
@@ -148,9 +173,13 @@ struct FIFOBuffer {
             process->unblock(true, -2);
         }
         PIDsWaitingUntilWrite.clear();
-
-        return ssz(byteCount);
+        Events.notify(EventType::READY_TO_READ, Offset);
     }
+
+    /// \return Bytes available to read, or -1 if empty.
+    ssz readable() const { return Offset ? ssz(Offset) : -1; }
+    /// \return Bytes of room to write into, or -1 if full.
+    ssz writable() const { return Offset < N ? ssz(N - Offset) : -1; }
 };
 
 // NOTE: We are trying to keep "SocketBuffers" as a single page of memory.
@@ -232,6 +261,11 @@ struct SocketData {
 
     /// `true` iff PID is waiting to accept an incoming connection.
     bool WaitingOnConnection { false };
+    /// `true` iff `listen` has been called on this socket; it then
+    /// becomes ready to read when a connection is waiting to be accepted.
+    bool Listening { false };
+    /// Event queues waiting for connections to this listening socket.
+    EventSource Events;
 
     // TODO: Use ring buffer instead?
     std::double_ended_queue<SocketConnection> ConnectionQueue;
@@ -295,6 +329,12 @@ struct SocketDriver final : FilesystemDriver {
     ssz write(FileMetadata* meta, usz, usz byteCount, void* buffer) final;
     ssz flush(FileMetadata* file) final { return -1; };
 
+    ssz reserve_write(FileMetadata* meta, u8*& space) final;
+    void commit_write(FileMetadata* meta, usz byteCount) final;
+
+    EventSource* event_source(FileMetadata* meta, EventType type) final;
+    ssz ready(FileMetadata* meta, EventType type) final;
+
     ssz directory_data(std::string_view path, usz max_entry_count, DirectoryEntry* out) final {
         return -1;
     }
@@ -36,6 +36,11 @@ struct StorageDeviceDriver {
     virtual ssz read(FileMetadata* file, usz offs, usz bytes, void* buffer) = 0;
     virtual ssz read_raw(usz offs, usz bytes, void* buffer) = 0;
     virtual ssz write(FileMetadata* file, usz offs, usz bytes, void* buffer) = 0;
+
+    /// Hint that a number of bytes at an offset are about to be read.
+    /// Drivers that can fetch them ahead of time (i.e. a cache) may do
+    /// so; by default, nothing happens.
+    virtual void prefetch(usz /* offs */, usz /* bytes */) {}
 };
 
 /// Helper function to convert a Driver to a StorageDeviceDriver.
@@ -17,9 +17,16 @@
  * along with LensorOS. If not, see <https://www.gnu.org/licenses
  */
 
+#include <event.h>
 #include <memory/common.h>
 #include <memory/physical_memory_manager.h>
+#include <scheduler.h>
+#include <storage/device_drivers/block_cache.h>
+#include <storage/filesystem_drivers/file_allocation_table.h>
+#include <timer_wheel.h>
 #include <format>
+#include <memory>
+#include <vector>
 
 bool test_pmm_single_page() {
   u8* mem = (u8*)Memory::request_page();
@@ -73,11 +80,351 @@ bool test_pmm_frees() {
   return true;
 }
 
+/// A storage device in memory, for testing what sits on top of one.
+/// Counts the requests that reach it.
+struct RAMStorageDevice final : StorageDeviceDriver {
+  std::vector<u8> Data;
+  usz Reads { 0 };
+  usz Writes { 0 };
+
+  explicit RAMStorageDevice(usz bytes) { Data.resize(bytes, 0); }
+
+  void close(FileMetadata*) final {}
+  auto open(std::string_view) -> std::shared_ptr<FileMetadata> final { return {}; }
+  ssz read(FileMetadata*, usz offs, usz bytes, void* buffer) final {
+    return read_raw(offs, bytes, buffer);
+  }
+  ssz read_raw(usz offs, usz bytes, void* buffer) final {
+    if (offs + bytes > Data.size()) return -1;
+    memcpy(buffer, Data.data() + offs, bytes);
+    ++Reads;
+    return ssz(bytes);
+  }
+  ssz write(FileMetadata*, usz offs, usz bytes, void* buffer) final {
+    if (offs + bytes > Data.size()) return -1;
+    memcpy(Data.data() + offs, buffer, bytes);
+    ++Writes;
+    return ssz(bytes);
+  }
+};
+
+/// @return Whether the BYTES bytes at OFFS of the cache read back as
+///   block numbers (see `test_block_cache_clock`).
+static bool read_blocks_back(BlockCacheDriver& cache, usz offs, usz bytes) {
+  std::vector<u8> buffer;
+  buffer.resize(bytes);
+  if (cache.read_raw(offs, bytes, buffer.data()) != ssz(bytes)) return false;
+  for (usz i = 0; i < bytes; ++i)
+    if (buffer[i] != u8((offs + i) / BlockCacheDriver::BlockSize)) return false;
+  return true;
+}
+
+bool test_block_cache_clock() {
+  constexpr usz BlockSize = BlockCacheDriver::BlockSize;
+  // Every byte of the device holds the number of the block it is in.
+  auto device = std::make_shared<RAMStorageDevice>(8 * BlockSize);
+  for (usz i = 0; i < device->Data.size(); ++i)
+    device->Data[i] = u8(i / BlockSize);
+  auto cache = BlockCacheDriver::try_create(sdd(device), false, 4);
+  if (!cache) {
+    std::print("test_block_cache_clock() failed: Could not create cache.\n");
+    return false;
+  }
+
+  if (!read_blocks_back(*cache, 0, BlockSize) || !read_blocks_back(*cache, 100, 50)) {
+    std::print("test_block_cache_clock() failed: Did not read back the right data.\n");
+    return false;
+  }
+  if (cache->stats().Misses != 1 || cache->stats().Hits != 1 || device->Reads != 1) {
+    std::print("test_block_cache_clock() failed: A cached block was read from the device again.\n");
+    return false;
+  }
+
+  // Blocks missing one after the other go to the device in one read.
+  if (!read_blocks_back(*cache, BlockSize, 3 * BlockSize) || device->Reads != 2 || cache->stats().Misses != 4) {
+    std::print("test_block_cache_clock() failed: Consecutive misses were not read together.\n");
+    return false;
+  }
+
+  // The cache is full, and every block has been used since. Block 4
+  // pushes out the oldest, block 0; then, with block 2 used again, it
+  // gets a second chance, and blocks 5 and 6 push out blocks 1 and 3.
+  if (!read_blocks_back(*cache, 4 * BlockSize, BlockSize)
+      || !read_blocks_back(*cache, 2 * BlockSize, BlockSize)
+      || !read_blocks_back(*cache, 5 * BlockSize, 2 * BlockSize))
+  {
+    std::print("test_block_cache_clock() failed: Did not read back the right data after eviction.\n");
+    return false;
+  }
+  if (cache->stats().Evictions != 3) {
+    std::print("test_block_cache_clock() failed: Expected 3 evictions, got {}.\n", cache->stats().Evictions);
+    return false;
+  }
+  usz reads = device->Reads;
+  if (!read_blocks_back(*cache, 2 * BlockSize, BlockSize) || device->Reads != reads) {
+    std::print("test_block_cache_clock() failed: A block that was used again was evicted.\n");
+    return false;
+  }
+  if (!read_blocks_back(*cache, 3 * BlockSize, BlockSize) || device->Reads != reads + 1) {
+    std::print("test_block_cache_clock() failed: The block after it was not evicted.\n");
+    return false;
+  }
+  return true;
+}
+
+bool test_block_cache_write_back() {
+  constexpr usz BlockSize = BlockCacheDriver::BlockSize;
+  auto device = std::make_shared<RAMStorageDevice>(4 * BlockSize);
+  auto cache = BlockCacheDriver::try_create(sdd(device), true, 2);
+  if (!cache) {
+    std::print("test_block_cache_write_back() failed: Could not create cache.\n");
+    return false;
+  }
+
+  // A whole block needn't be read first; part of one does.
+  std::vector<u8> whole;
+  whole.resize(BlockSize, 0xaa);
+  u8 part[10];
+  memset(part, 0xbb, sizeof(part));
+  if (cache->write(nullptr, 0, BlockSize, whole.data()) != ssz(BlockSize)
+      || cache->write(nullptr, BlockSize + 100, sizeof(part), part) != ssz(sizeof(part)))
+  {
+    std::print("test_block_cache_write_back() failed: Could not write.\n");
+    return false;
+  }
+  if (device->Writes != 0 || device->Reads != 1) {
+    std::print("test_block_cache_write_back() failed: Expected no writes and 1 read, got {} and {}.\n", device->Writes, device->Reads);
+    return false;
+  }
+  u8 byte = 0;
+  if (cache->read_raw(BlockSize + 105, 1, &byte) != 1 || byte != 0xbb) {
+    std::print("test_block_cache_write_back() failed: Did not read back what was written.\n");
+    return false;
+  }
+
+  // Reading two other blocks evicts both dirty ones.
+  std::vector<u8> buffer;
+  buffer.resize(2 * BlockSize);
+  if (cache->read_raw(2 * BlockSize, 2 * BlockSize, buffer.data()) != ssz(2 * BlockSize)) {
+    std::print("test_block_cache_write_back() failed: Could not read.\n");
+    return false;
+  }
+  if (cache->stats().Writebacks != 2 || device->Writes != 2) {
+    std::print("test_block_cache_write_back() failed: Expected 2 dirty blocks written back, got {}.\n", cache->stats().Writebacks);
+    return false;
+  }
+  if (device->Data[0] != 0xaa || device->Data[BlockSize - 1] != 0xaa
+      || device->Data[BlockSize + 99] != 0 || device->Data[BlockSize + 100] != 0xbb
+      || device->Data[BlockSize + 109] != 0xbb || device->Data[BlockSize + 110] != 0)
+  {
+    std::print("test_block_cache_write_back() failed: The device does not hold what was written.\n");
+    return false;
+  }
+
+  // `sync` writes back what is dirty, and only that.
+  if (cache->write(nullptr, 2 * BlockSize, sizeof(part), part) != ssz(sizeof(part)) || !cache->sync()
+      || device->Writes != 3 || device->Data[2 * BlockSize] != 0xbb)
+  {
+    std::print("test_block_cache_write_back() failed: sync() did not write back the dirty block.\n");
+    return false;
+  }
+  return true;
+}
+
+bool test_fat_extents() {
+  constexpr usz SectorSize = 512;
+  // A FAT16 volume with one sector per cluster: the boot record, one
+  // FAT of 16 sectors, then one sector of root directory. Only the
+  // clusters that are used are backed by the device.
+  constexpr usz FirstDataSector = 18;
+  auto device = std::make_shared<RAMStorageDevice>(32 * SectorSize);
+  auto& data = device->Data;
+  for (usz i = FirstDataSector * SectorSize; i < data.size(); ++i)
+    data[i] = u8(i ^ (i >> 8));
+
+  BootRecord br{};
+  br.BPB.NumBytesPerSector = SectorSize;
+  br.BPB.NumSectorsPerCluster = 1;
+  br.BPB.NumReservedSectors = 1;
+  br.BPB.NumFATsPresent = 1;
+  br.BPB.NumEntriesInRoot = 16;
+  br.BPB.NumSectorsPerFAT = 16;
+  br.BPB.TotalSectors16 = FirstDataSector + 4090;
+  br.Magic = 0xaa55;
+  memcpy(data.data(), &br, sizeof(br));
+
+  // The file is in clusters 2, 3, 4, 7 and 8, and so two extents.
+  auto link = [&](u16 cluster, u16 next) {
+    memcpy(data.data() + SectorSize + cluster * 2, &next, sizeof(next));
+  };
+  link(2, 3);
+  link(3, 4);
+  link(4, 7);
+  link(7, 8);
+  link(8, 0xffff);
+  constexpr usz FileSize = 2300;
+  ClusterEntry entry{};
+  memcpy(entry.FileName, "DATA    BIN", 11);
+  entry.Attributes = 0x20;
+  entry.ClusterNumberL = 2;
+  entry.FileSizeInBytes = FileSize;
+  memcpy(data.data() + (FirstDataSector - 1) * SectorSize, &entry, sizeof(entry));
+
+  auto fs = FileAllocationTableDriver::try_create(sdd(device));
+  if (!fs) {
+    std::print("test_fat_extents() failed: Could not create driver.\n");
+    return false;
+  }
+  auto file = fs->open("/data.bin");
+  if (!file) {
+    std::print("test_fat_extents() failed: Could not open file.\n");
+    return false;
+  }
+
+  auto expected = [&](usz offset) -> u8 {
+    usz cluster = offset < 3 * SectorSize ? 2 + offset / SectorSize : 7 + (offset / SectorSize - 3);
+    usz i = (FirstDataSector + cluster - 2) * SectorSize + offset % SectorSize;
+    return u8(i ^ (i >> 8));
+  };
+  std::vector<u8> buffer;
+  buffer.resize(FileSize);
+  usz reads = device->Reads;
+  if (fs->read(file.get(), 0, FileSize, buffer.data()) != ssz(FileSize)) {
+    std::print("test_fat_extents() failed: Could not read the whole file.\n");
+    return false;
+  }
+  if (device->Reads - reads != 2) {
+    std::print("test_fat_extents() failed: Expected 2 reads of the device, one per extent, got {}.\n", device->Reads - reads);
+    return false;
+  }
+  for (usz i = 0; i < FileSize; ++i) {
+    if (buffer[i] != expected(i)) {
+      std::print("test_fat_extents() failed: Wrong byte at offset {} of the file.\n", i);
+      return false;
+    }
+  }
+
+  // Across the gap between the extents, and past the end of the file.
+  if (fs->read(file.get(), 1500, 100, buffer.data()) != 100
+      || buffer[0] != expected(1500) || buffer[99] != expected(1599))
+  {
+    std::print("test_fat_extents() failed: Did not read across extents.\n");
+    return false;
+  }
+  if (fs->read(file.get(), FileSize - 10, 100, buffer.data()) != 10) {
+    std::print("test_fat_extents() failed: Read past the end of the file.\n");
+    return false;
+  }
+  return true;
+}
+
+bool test_timer_wheel() {
+  struct Fired {
+    TimerWheel* Wheel;
+    u64 At { 0 };
+  };
+  // Large enough that it had better not be on the stack; it's constant
+  // initialized, like `gTimerWheel`.
+  static TimerWheel wheel;
+  auto record = [](Timer* timer) {
+    auto* fired = static_cast<Fired*>(timer->Data);
+    fired->At = fired->Wheel->now();
+  };
+
+  // One for each level, one beyond the range of the wheel, and one that
+  // gets cancelled.
+  constexpr u64 Beyond = (u64(1) << (TimerWheel::LevelBits * TimerWheel::Levels)) + 10;
+  constexpr u64 expires[] = { 10, 100, 5000, 300000, Beyond, 200 };
+  constexpr usz Count = sizeof(expires) / sizeof(expires[0]);
+  const u64 start = wheel.now();
+  Fired fired[Count];
+  Timer timers[Count];
+  for (usz i = 0; i < Count; ++i) {
+    fired[i].Wheel = &wheel;
+    timers[i].Function = record;
+    timers[i].Data = &fired[i];
+    wheel.add(&timers[i], start + expires[i]);
+  }
+  wheel.cancel(&timers[Count - 1]);
+
+  wheel.run(start + 150);
+  if (fired[0].At != start + 10 || fired[1].At != start + 100 || fired[2].At || timers[2].pending() == false) {
+    std::print("test_timer_wheel() failed: Timers did not fire on time.\n");
+    return false;
+  }
+  wheel.run(start + Beyond);
+  for (usz i = 0; i < Count - 1; ++i) {
+    if (fired[i].At != start + expires[i] || timers[i].pending()) {
+      std::print("test_timer_wheel() failed: Timer due at {} fired at {}.\n", expires[i], fired[i].At - start);
+      return false;
+    }
+  }
+  if (fired[Count - 1].At) {
+    std::print("test_timer_wheel() failed: A cancelled timer fired.\n");
+    return false;
+  }
+  return true;
+}
+
+bool test_event_timer_delete() {
+  auto* process = new Process{};
+  auto* queue = new EventQueue;
+  queue->Group = process->Group.get();
+  process->Group->EventQueues.push_back(queue);
+  auto& timers = process->Group->EventTimers;
+
+  // Long enough that none fire while the test runs; the wheel is run
+  // from the timer interrupt, so keep it out like a syscall would.
+  EventFilter filter;
+  filter.Timer = {1, 60000};
+  u64 flags = 0;
+  asm volatile ("pushfq\n"
+                "pop %0\n"
+                "cli\n"
+                : "=r"(flags)
+                :: "memory");
+  bool ok = true;
+  for (usz i = 0; ok and i < 64; ++i) {
+    // The same thing kevent does to add and delete a TIMER filter.
+    if (!queue->listens(EventType::TIMER, filter)) gEvents.add_timer(process, filter);
+    queue->register_listening(EventType::TIMER, filter, 0, nullptr);
+    if (timers.size() != 1 || !timers[0]->Entry.pending()) {
+      std::print("test_event_timer_delete() failed: Expected 1 pending timer after adding, got {}.\n", timers.size());
+      ok = false;
+    }
+    queue->unregister_listening(EventType::TIMER, filter);
+    gEvents.remove_timer(process, filter);
+    if (timers.size()) {
+      std::print("test_event_timer_delete() failed: Timer left behind after deleting.\n");
+      ok = false;
+    }
+  }
+  for (EventTimer* timer : timers) {
+    gTimerWheel.cancel(&timer->Entry);
+    delete timer;
+  }
+  timers.clear();
+  asm volatile ("push %0\n"
+                "popfq\n"
+                :: "r"(flags)
+                : "memory", "cc");
+
+  process->Group->EventQueues.clear();
+  delete queue;
+  delete process;
+  return ok;
+}
+
 void run_tests() {
   constexpr const char* success = "    \033[32mSuccess\033[31m\n";
   std::print("Tests:\n\033[31m");
   if (test_pmm_single_page()) std::print(success);
   if (test_pmm_multiple_pages()) std::print(success);
   if (test_pmm_frees()) std::print(success);
+  if (test_block_cache_clock()) std::print(success);
+  if (test_block_cache_write_back()) std::print(success);
+  if (test_fat_extents()) std::print(success);
+  if (test_timer_wheel()) std::print(success);
+  if (test_event_timer_delete()) std::print(success);
   std::print("\033[0m");
 }
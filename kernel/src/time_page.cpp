@@ -0,0 +1,100 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <time_page.h>
+
+#include <format>
+#include <memory.h>
+#include <memory/common.h>
+#include <memory/paging.h>
+#include <memory/physical_memory_manager.h>
+#include <memory/virtual_memory_manager.h>
+#include <pit.h>
+#include <rtc.h>
+#include <tsc.h>
+
+static_assert(sizeof(TimePage::Data) == 48, "TimePage::Data layout must match libc's time_page");
+
+namespace TimePage {
+    constinit Data* Page { nullptr };
+
+    /// Days from 1970-01-01 until the given (proleptic Gregorian) date.
+    static u64 days_since_epoch(u64 year, u64 month, u64 day) {
+        // Count years from March, so that leap days fall at the end.
+        if (month <= 2) year -= 1;
+        u64 era = year / 400;
+        u64 yearOfEra = year - era * 400;
+        u64 dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        u64 dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + dayOfEra - 719468;
+    }
+
+    /// Writers bracket their changes with these; there is only ever
+    /// one, as the page is only written with interrupts disabled.
+    static void write_begin() {
+        __atomic_store_n(&Page->Sequence, Page->Sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    static void write_end() {
+        __atomic_store_n(&Page->Sequence, Page->Sequence + 1, __ATOMIC_RELEASE);
+    }
+
+    void initialize() {
+        // The kernel has all of physical memory identity mapped.
+        Page = (Data*)Memory::request_page();
+        if (not Page) {
+            std::print("[TIME]: Could not allocate the time page\n");
+            return;
+        }
+        memset(Page, 0, PAGE_SIZE);
+
+        // Read the clock afresh, so that it lines up with the counter.
+        gRTC.update_data();
+        const RTCData& now = gRTC.Time;
+        u64 year = now.year < 100 ? 2000 + now.year : now.year;
+        u64 days = days_since_epoch(year, now.month, now.date);
+
+        write_begin();
+        Page->WallClockSeconds = days * 86400 + now.hour * 3600 + now.minute * 60 + now.second;
+        Page->WallClockTSC = TSC::read();
+        Page->TSCFrequency = TSC::frequency();
+        Page->Ticks = gPIT.get();
+        Page->TickFrequency = PIT_FREQUENCY;
+        write_end();
+
+        std::print("[TIME]: Time page set up; it is {} seconds since the epoch\n", Page->WallClockSeconds);
+    }
+
+    void tick() {
+        if (not Page) return;
+        write_begin();
+        Page->Ticks = gPIT.get();
+        write_end();
+    }
+
+    void map(Memory::PageTable* pageTable) {
+        if (not Page) return;
+        u64 flags = 0;
+        flags |= (u64)Memory::PageTableFlag::Present;
+        flags |= (u64)Memory::PageTableFlag::UserSuper;
+        flags |= (u64)Memory::PageTableFlag::NX;
+        Memory::map_pages(pageTable, (void*)UserAddress, Page, flags, 1, Memory::ShowDebug::No);
+    }
+}
@@ -0,0 +1,63 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_TIME_PAGE_H
+#define LENSOR_OS_TIME_PAGE_H
+
+#include <integers.h>
+
+namespace Memory {
+    struct PageTable;
+}
+
+/// A page the kernel keeps the time in, mapped read-only into every
+/// userspace process, so that the time may be told without a syscall.
+/// It is guarded by a sequence count: readers retry if it was odd, or
+/// changed, while they were reading.
+namespace TimePage {
+    /// The layout must match that of `struct time_page` in libc.
+    struct Data {
+        u32 Sequence;
+        u32 Reserved;
+        /// Unix time, in seconds, as of when the time stamp counter
+        /// read `WallClockTSC`.
+        u64 WallClockSeconds;
+        u64 WallClockTSC;
+        /// Time stamp counter cycles per second.
+        u64 TSCFrequency;
+        /// Timer ticks since boot, and how many there are per second.
+        u64 Ticks;
+        u64 TickFrequency;
+    };
+
+    /// Where the page is found within every userspace process.
+    constexpr u64 UserAddress = 0x7ffffffff000;
+
+    /// Must be called after the time stamp counter is calibrated, and
+    /// before any userspace process is loaded.
+    void initialize();
+
+    /// Called on every tick of the system timer.
+    void tick();
+
+    /// Map the page into the given address space, read-only.
+    void map(Memory::PageTable*);
+}
+
+#endif /* LENSOR_OS_TIME_PAGE_H */
@@ -0,0 +1,100 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <timer_wheel.h>
+
+#include <integers.h>
+
+TimerWheel gTimerWheel;
+
+void TimerWheel::link(Timer* timer) {
+    u64 delta = timer->Expires - Current;
+    Timer** slot { nullptr };
+    if (timer->Expires < Current) {
+        // Already expired; fire on the very next tick processed.
+        slot = &Slots[0][Current & SlotMask];
+    } else if (delta < SlotsPerLevel) {
+        slot = &Slots[0][timer->Expires & SlotMask];
+    } else {
+        usz level = 1;
+        for (; level < Levels - 1; ++level)
+            if (delta < (u64(1) << (LevelBits * (level + 1)))) break;
+        // Timers beyond the range of the wheel wait in the furthest
+        // slot of the top level, and get re-sorted when they cascade.
+        u64 expires = timer->Expires;
+        u64 limit = u64(1) << (LevelBits * Levels);
+        if (delta >= limit) expires = Current + limit - 1;
+        slot = &Slots[level][(expires >> (LevelBits * level)) & SlotMask];
+    }
+
+    timer->Next = *slot;
+    if (timer->Next) timer->Next->PreviousNext = &timer->Next;
+    timer->PreviousNext = slot;
+    *slot = timer;
+}
+
+void TimerWheel::add(Timer* timer, u64 expires) {
+    if (!timer) return;
+    cancel(timer);
+    timer->Expires = expires;
+    link(timer);
+}
+
+void TimerWheel::cancel(Timer* timer) {
+    if (!timer || !timer->pending()) return;
+    *timer->PreviousNext = timer->Next;
+    if (timer->Next) timer->Next->PreviousNext = timer->PreviousNext;
+    timer->Next = nullptr;
+    timer->PreviousNext = nullptr;
+}
+
+/// Move every timer in the current slot of the given level down into
+/// the levels below it.
+void TimerWheel::cascade(usz level) {
+    Timer*& slot = Slots[level][(Current >> (LevelBits * level)) & SlotMask];
+    Timer* timer = slot;
+    slot = nullptr;
+    while (timer) {
+        Timer* next = timer->Next;
+        link(timer);
+        timer = next;
+    }
+}
+
+void TimerWheel::run(u64 now) {
+    while (Current <= now) {
+        usz index = Current & SlotMask;
+        // Every time a level wraps around, pull the next slot of the
+        // level above it down.
+        if (index == 0) {
+            for (usz level = 1; level < Levels; ++level) {
+                cascade(level);
+                if (((Current >> (LevelBits * level)) & SlotMask) != 0) break;
+            }
+        }
+
+        Timer*& slot = Slots[0][index];
+        while (slot) {
+            Timer* timer = slot;
+            cancel(timer);
+            if (timer->Function) timer->Function(timer);
+        }
+        ++Current;
+    }
+}
@@ -0,0 +1,105 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_TIMER_WHEEL_H
+#define LENSOR_OS_TIMER_WHEEL_H
+
+#include <integers.h>
+#include <pit.h>
+
+/// Convert a duration to a number of timer ticks, rounding up so that
+/// a timer never fires early.
+constexpr u64 milliseconds_to_ticks(u64 milliseconds) {
+    return (milliseconds * PIT_FREQUENCY + 999) / 1000;
+}
+constexpr u64 nanoseconds_to_ticks(u64 nanoseconds) {
+    return (nanoseconds / 1000 * PIT_FREQUENCY + 999'999) / 1'000'000;
+}
+
+/// A single pending callback. Timers are intrusive, so the owner must
+/// keep the timer alive (and at the same address) until it has either
+/// fired or been cancelled.
+struct Timer {
+    using Callback = void(*)(Timer*);
+
+    Callback Function { nullptr };
+    /// Free for use by the owner of the timer (i.e. to find itself
+    /// again from within the callback).
+    void* Data { nullptr };
+    /// Absolute tick at which the timer fires.
+    u64 Expires { 0 };
+
+    Timer() = default;
+    Timer(Callback function, void* data)
+        : Function(function), Data(data) {}
+
+    /// Timers are linked into the wheel by address.
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    bool pending() const { return PreviousNext != nullptr; }
+
+private:
+    friend class TimerWheel;
+    Timer* Next { nullptr };
+    /// The pointer that points to this timer (either a slot in the
+    /// wheel or the `Next` of the previous timer), which lets a timer
+    /// unlink itself in constant time.
+    Timer** PreviousNext { nullptr };
+};
+
+/// A hierarchical timing wheel: each level has 64 slots, and each slot
+/// of a level spans all 64 slots of the level below it. Timers are
+/// placed into the level that covers how far away they are, then
+/// cascaded down into finer levels as time gets closer. Adding and
+/// cancelling a timer is constant time.
+class TimerWheel {
+public:
+    static constexpr usz LevelBits = 6;
+    static constexpr usz SlotsPerLevel = 1 << LevelBits;
+    static constexpr usz SlotMask = SlotsPerLevel - 1;
+    static constexpr usz Levels = 4;
+
+    /// Fire the given timer at the absolute tick `expires`. If the
+    /// timer is already pending, it is rescheduled.
+    void add(Timer*, u64 expires);
+    /// Fire the given timer `ticks` ticks from now.
+    void add_relative(Timer* timer, u64 ticks) { add(timer, Current + ticks); }
+    /// Remove a pending timer without firing it. Does nothing if the
+    /// timer is not pending.
+    void cancel(Timer*);
+
+    /// Run every timer that has expired up to and including tick `now`.
+    /// NOTE: Called from the timer interrupt; callbacks must not block.
+    void run(u64 now);
+
+    u64 now() const { return Current; }
+
+private:
+    Timer* Slots[Levels][SlotsPerLevel] {};
+    /// The next tick to be processed.
+    u64 Current { 0 };
+
+    void link(Timer*);
+    void cascade(usz level);
+};
+
+extern TimerWheel gTimerWheel;
+
+#endif /* LENSOR_OS_TIMER_WHEEL_H */
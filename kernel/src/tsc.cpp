@@ -0,0 +1,81 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <tsc.h>
+
+#include <format>
+#include <io.h>
+#include <pit.h>
+
+namespace TSC {
+    static constinit u64 Frequency { 1000000000 };
+
+    void calibrate() {
+        // Count cycles while PIT channel two counts down 10ms, with
+        // interrupts disabled so nothing gets in the way. Bit five of
+        // the speaker port goes high once the count reaches zero.
+        constexpr u64 Milliseconds = 10;
+        constexpr u16 Latch = PIT_MAX_FREQ * Milliseconds / 1000;
+
+        u64 flags;
+        asm volatile ("pushfq\n"
+                      "pop %0\n"
+                      "cli\n"
+                      : "=r"(flags)
+                      :: "memory");
+
+        // Enable channel two's gate, but keep it off of the speaker.
+        u8 speaker = in8(PIT_PCSPK);
+        out8(PIT_PCSPK, (speaker & ~0b10) | 0b01);
+        // Channel two, low/high, interrupt on terminal count.
+        out8(PIT_CMD, 0b10110000);
+        out8(PIT_CH2_DAT, Latch & 0xff);
+        out8(PIT_CH2_DAT, Latch >> 8);
+
+        u64 start = read();
+        while (!(in8(PIT_PCSPK) & 0b100000));
+        u64 end = read();
+
+        // Put channel two back how the PIT left it, for the speaker.
+        constexpr u16 Tone = PIT_MAX_FREQ / 440;
+        out8(PIT_CMD, 0b10110110);
+        out8(PIT_CH2_DAT, Tone & 0xff);
+        out8(PIT_CH2_DAT, Tone >> 8);
+        out8(PIT_PCSPK, speaker);
+
+        asm volatile ("push %0\n"
+                      "popfq\n"
+                      :: "r"(flags)
+                      : "memory", "cc");
+
+        if (end > start) Frequency = (end - start) * (1000 / Milliseconds);
+        std::print("[TSC]: Running at {}MHz\n", Frequency / 1000000);
+    }
+
+    u64 frequency() { return Frequency; }
+
+    u64 to_nanoseconds(u64 cycles) {
+        // Split to avoid overflowing the multiplication.
+        return cycles / Frequency * 1000000000 + cycles % Frequency * 1000000000 / Frequency;
+    }
+
+    u64 to_microseconds(u64 cycles) {
+        return cycles / (Frequency / 1000000);
+    }
+}
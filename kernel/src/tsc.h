@@ -0,0 +1,46 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_TSC_H
+#define LENSOR_OS_TSC_H
+
+#include <integers.h>
+
+/// The time stamp counter: a per-CPU count of cycles since reset, which
+/// is by far the cheapest clock there is to read.
+namespace TSC {
+    inline u64 read() {
+        u32 low;
+        u32 high;
+        asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+        return (u64(high) << 32) | low;
+    }
+
+    /// Measure how fast the counter runs, against the PIT. Until this
+    /// is called, it is taken to run at 1GHz.
+    void calibrate();
+
+    /// Counter cycles per second.
+    u64 frequency();
+
+    u64 to_nanoseconds(u64 cycles);
+    u64 to_microseconds(u64 cycles);
+}
+
+#endif /* LENSOR_OS_TSC_H */
@@ -57,3 +57,7 @@ void TSS::initialize() {
         ::: "rax"
         );
 }
+
+u64 TSS::kernel_stack() {
+    return u64(tssEntry.l_RSP0) | u64(tssEntry.h_RSP0) << 32;
+}
@@ -120,6 +120,8 @@ struct TSSEntry {
 
 namespace TSS {
     void initialize();
+    /// The stack the CPU switches to on entering ring 0 from userspace.
+    u64 kernel_stack();
 }
 
 extern "C" void jump_to_userland_function(void* functionAddress);
@@ -19,6 +19,7 @@
 
 #include <virtual_filesystem.h>
 
+#include <algorithm>
 #include <cstr.h>
 #include <format>
 #include <storage/file_metadata.h>
@@ -38,7 +39,7 @@ SysFD VFS::procfd_to_fd(ProcFD procfd) const {
 }
 
 SysFD VFS::procfd_to_fd(Process* process, ProcFD procfd) const {
-    auto sysfd = process->FileDescriptors[procfd];
+    auto sysfd = process->Group->FileDescriptors[procfd];
     if (!sysfd) {
         DBGMSG("[VFS]: ERROR {} (pid {}) is unmapped.\n", procfd, process->ProcessID);
         return SysFD::Invalid;
@@ -56,13 +57,13 @@ auto VFS::file(ProcFD procfd) -> std::shared_ptr<FileMetadata> {
 #ifdef DEBUG_VFS
     std::print("[VFS]: ProcFds for process {}:\n", proc->ProcessID);
     u64 n = 0;
-    for (const auto& entry : proc->FileDescriptors) {
+    for (const auto& entry : proc->Group->FileDescriptors) {
         std::print("  {} -> {}\n", n, entry);
         n++;
     }
 #endif
 
-    auto sysfd = proc->FileDescriptors[procfd];
+    auto sysfd = proc->Group->FileDescriptors[procfd];
     if (!sysfd) {
         std::print("[VFS]: ERROR: {} (pid {}) is unmapped.\n", procfd, proc->ProcessID);
         return {};
@@ -105,7 +106,7 @@ void VFS::free_fd(Process* process, SysFD fd, ProcFD procfd) {
     DBGMSG("Freeing ProcFD={} SysFD={} in process {}\n", procfd, fd, process->ProcessID);
     // Remove file descriptor from process's list of open file
     // descriptors using Process File Descriptor.
-    process->FileDescriptors.erase(procfd);
+    process->Group->FileDescriptors.erase(procfd);
     // Remove kernel file description from VFS list of open files using
     // System File Descriptor.
     Files.erase(fd);
@@ -115,6 +116,22 @@ void VFS::free_fd(SysFD fd, ProcFD procfd) {
     free_fd(Scheduler::CurrentProcess->value(), fd, procfd);
 }
 
+void VFS::mount(std::string path, std::shared_ptr<FilesystemDriver>&& fs) {
+    SpinlockLocker locker(MountsLock);
+    MountTable* old = Mounts;
+    auto* table = new MountTable;
+    table->Mounts = old->Mounts;
+    table->Mounts.push_back(MountPoint{std::move(path), std::move(fs)});
+    RCU::assign(Mounts, table);
+
+    // Anybody looking up a mount may still be reading the old table.
+    old->FreeCallback.Function = [](RCU::Callback* callback) {
+        delete static_cast<MountTable*>(callback->Data);
+    };
+    old->FreeCallback.Data = old;
+    RCU::call(&old->FreeCallback);
+}
+
 FileDescriptors VFS::open(std::string_view path) {
     u64 fullPathLength = path.size();
 
@@ -129,16 +146,16 @@ FileDescriptors VFS::open(std::string_view path) {
     }
 
     DBGMSG("[VFS]: Attempting to open file at path {}\n", path);
-    for (const auto& mount : Mounts) {
-        /// It makes no sense to search file systems whose mount point does not
-        /// match the beginning of the path. And even if they’re mounted twice,
-        /// we’ll still find the second mount.
-        if (!path.starts_with(mount.Path)) continue;
-        auto fs_path = path.substr(mount.Path.size());
+    /// It makes no sense to search file systems whose mount point does not
+    /// match the beginning of the path. And even if they’re mounted twice,
+    /// we’ll still find the second mount.
+    usz prefix = 0;
+    for (usz n = 0; auto fs = mount_under(path, n, prefix); ++n) {
+        auto fs_path = path.substr(prefix);
 
         /// Try to open the file.
-        DBGMSG("[VFS]: Attempting to open file at path {} on mount {}\n", fs_path, mount.Path);
-        if (auto meta = mount.FS->open(fs_path)) {
+        DBGMSG("[VFS]: Attempting to open file at path {} on mount {}\n", fs_path, path.substr(0, prefix));
+        if (auto meta = fs->open(fs_path)) {
             DBGMSG("  Metadata:\n"
                    "    Name: {}\n"
                    "    File Size: {}\n"
@@ -216,6 +233,7 @@ ssz VFS::read(ProcFD fd, u8* buffer, usz byteCount, usz byteOffset) {
     DBGMSG("  file offset:     {}\n", meta->offset);
     DBGMSG("  file size:       {}\n", meta->file_size());
 
+    read_ahead(meta, byteOffset + meta->offset, byteCount);
     return meta->filesystem_driver()->read(meta, byteOffset + meta->offset, byteCount, buffer);
 }
 
@@ -261,11 +279,63 @@ ssz VFS::write(ProcFD fd, u8* buffer, usz byteCount, usz byteOffset) {
     return meta->filesystem_driver()->write(meta, byteOffset + meta->offset, byteCount, buffer);
 }
 
+ssz VFS::pread(ProcFD fd, u8* buffer, usz byteCount, usz position) {
+    // SEE COMMENTS ON CONCURRENCY AND (B)LOCKING IN VFS::read()
+    FileMetadata* meta = nullptr;
+    {
+        auto f = file(fd);
+        meta = f.get();
+    }
+    if (!meta) return -1;
+    read_ahead(meta, position, byteCount);
+    return meta->filesystem_driver()->read(meta, position, byteCount, buffer);
+}
+
+void VFS::read_ahead(FileMetadata* meta, usz offset, usz count) {
+    auto& ra = meta->read_ahead;
+    const usz end = offset + count;
+
+    // Anything but a read picking up where the last one left off starts
+    // the window over.
+    if (offset != ra.Next) {
+        ra.Next = end;
+        ra.Window = 0;
+        ra.FetchedTo = 0;
+        return;
+    }
+    ra.Next = end;
+    ra.Window = ra.Window ? std::min(ra.Window * 2, MaximumReadAhead) : MinimumReadAhead;
+
+    // Wait until the reader is halfway through what was fetched last
+    // time, so fetches are few and large.
+    if (end + ra.Window / 2 <= ra.FetchedTo) return;
+
+    const usz from = std::max(offset, ra.FetchedTo);
+    const usz to = std::min(usz(meta->file_size()), end + ra.Window);
+    if (from >= to) return;
+
+    DBGMSG("[VFS]: Reading ahead {} bytes at {} of \"{}\"\n", to - from, from, meta->name());
+    meta->filesystem_driver()->prefetch(meta, from, to - from);
+    ra.FetchedTo = to;
+}
+
+ssz VFS::pwrite(ProcFD fd, u8* buffer, usz byteCount, usz position) {
+    // SEE COMMENTS ON CONCURRENCY AND (B)LOCKING IN VFS::read()
+    FileMetadata* meta = nullptr;
+    {
+        auto f = file(fd);
+        meta = f.get();
+    }
+    if (!meta) return -1;
+    return meta->filesystem_driver()->write(meta, position, byteCount, buffer);
+}
+
 void VFS::print_debug() {
     std::print("[VFS]: Debug Info\n"
            "  Mounts:\n");
     u64 i = 0;
-    for (const auto& mp : Mounts) {
+    RCU::ReadLocker reader;
+    for (const auto& mp : mounts()) {
         std::print("    Mount {}:\n"
                    "      Path: {}\n"
                    "      Filesystem: {}\n"
@@ -300,7 +370,7 @@ FileDescriptors VFS::add_file(std::shared_ptr<FileMetadata> file, Process* proc)
     DBGMSG("[VFS]: Allocated new {}\n", fd);
 
     /// Add the file descriptor to the local process table.
-    auto [procfd, __] = proc->FileDescriptors.push_back(fd);
+    auto [procfd, __] = proc->Group->FileDescriptors.push_back(fd);
     DBGMSG("[VFS]: Allocated new {} (pid {})\n", procfd, proc->ProcessID);
 
     /// Return the fds.
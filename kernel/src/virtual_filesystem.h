@@ -23,6 +23,7 @@
 
 #include <file.h>
 #include <linked_list.h>
+#include <memory/common.h>
 #include <storage/file_metadata.h>
 #include <storage/filesystem_driver.h>
 #include <storage/storage_device_driver.h>
@@ -30,7 +31,9 @@
 #include <storage/filesystem_drivers/input.h>
 #include <storage/filesystem_drivers/pipe.h>
 #include <storage/filesystem_drivers/socket.h>
+#include <rcu.h>
 #include <scheduler.h>
+#include <spinlock.h>
 #include <vfs_forward.h>
 
 #include <memory>
@@ -72,6 +75,14 @@ struct MountPoint {
     std::shared_ptr<FilesystemDriver> FS;
 };
 
+/// Mount points are never changed in place: `VFS::mount()` publishes a
+/// new table, and the old one is freed after an RCU grace period, so
+/// that looking up a mount takes no locks.
+struct MountTable {
+    std::vector<MountPoint> Mounts;
+    RCU::Callback FreeCallback;
+};
+
 struct FileDescriptors {
     ProcFD Process { ProcFD::Invalid };
     SysFD Global { SysFD::Invalid };
@@ -86,6 +97,10 @@ struct FileDescriptors {
 };
 
 struct VFS {
+    /// Bounds of how far ahead of a sequential reader a file is fetched.
+    static constexpr usz MinimumReadAhead = KiB(16);
+    static constexpr usz MaximumReadAhead = MiB(1);
+
     // TODO: Make all of these FilesystemDrivers rather than StorageDeviceDrivers
     std::shared_ptr<InputDriver> StdinDriver;
     std::shared_ptr<DbgOutDriver> StdoutDriver;
@@ -97,14 +112,30 @@ struct VFS {
         StdoutDriver   = std::make_shared<DbgOutDriver>();
         PipesDriver    = std::make_shared<PipeDriver>();
         SocketsDriver  = std::make_shared<SocketDriver>();
+        Mounts = new MountTable;
     }
 
-    void mount(std::string path, std::shared_ptr<FilesystemDriver>&& fs) {
-        Mounts.push_back(MountPoint{std::move(path), std::move(fs)});
+    void mount(std::string path, std::shared_ptr<FilesystemDriver>&& fs);
+
+    /// The mount table at the time of the call. It stays valid until
+    /// the caller next enables interrupts, blocks, or yields.
+    const std::vector<MountPoint>& mounts() const { return RCU::dereference(Mounts)->Mounts; }
+
+    /// The driver of the Nth (from zero) mount whose path is a prefix
+    /// of PATH, in the order they were mounted, or NULL if there are no
+    /// more. The length of the mount's path is stored in PREFIX. Only
+    /// the driver is copied out of the mount table, so that it may be
+    /// used after blocking (i.e. to open a file on a disk).
+    std::shared_ptr<FilesystemDriver> mount_under(std::string_view path, usz n, usz& prefix) const {
+        RCU::ReadLocker reader;
+        for (const auto& mount : RCU::dereference(Mounts)->Mounts) {
+            if (not path.starts_with(mount.Path) or n--) continue;
+            prefix = mount.Path.size();
+            return mount.FS;
+        }
+        return nullptr;
     }
 
-    const std::vector<MountPoint>& mounts() const { return Mounts; }
-
     /// The returned file descriptors will be associated with the file
     /// description of the given file descriptor.
     FileDescriptors dup(Process* proc, ProcFD fd) {
@@ -167,7 +198,7 @@ struct VFS {
         // Files table, this means that the process' FileDescriptor
         // still maps to the same SysFD. It's just the data stored *at*
         // that SysFD that changes. This may change in the future, and
-        // the proc->FileDescriptors mappings may need altered.
+        // the proc->Group->FileDescriptors mappings may need altered.
         return true;
     }
 
@@ -176,9 +207,16 @@ struct VFS {
     bool close(ProcFD procfd);
     bool close(Process*, ProcFD procfd);
 
+    /// BYTEOFFSET is relative to the file's current offset, which is
+    /// left alone; moving it along is up to the caller.
     ssz read(ProcFD procfd, u8* buffer, usz byteCount, usz byteOffset = 0);
     ssz write(ProcFD procfd, u8* buffer, usz byteCount, usz byteOffset);
 
+    /// Like `read` and `write`, but at POSITION from the start of the
+    /// file, no matter it's current offset.
+    ssz pread(ProcFD procfd, u8* buffer, usz byteCount, usz position);
+    ssz pwrite(ProcFD procfd, u8* buffer, usz byteCount, usz position);
+
     void print_debug();
 
     FileDescriptors add_file(std::shared_ptr<FileMetadata>, Process* proc = nullptr);
@@ -194,7 +232,8 @@ struct VFS {
         if (not path.size() or path == std::string_view("/")) {
             // Fill dirents with MountPoint prefixes (iterate Mounts)
             usz count = 0;
-            for (auto mount : Mounts) {
+            RCU::ReadLocker reader;
+            for (const auto& mount : RCU::dereference(Mounts)->Mounts) {
                 // Copy mount prefix into directory entry name field.
                 memcpy(&dirents[count].name[0], mount.Path.data(), mount.Path.size());
                 // Root of mount is always a directory
@@ -209,14 +248,9 @@ struct VFS {
 
         // Get FilesystemDriver from MountPoint by matching prefix, then hand it
         // over to the FSD.
-        for (auto mount : Mounts) {
-            /// It makes no sense to search file systems whose mount point does not
-            /// match the beginning of the path. And even if they’re mounted twice,
-            /// we’ll still find the second mount.
-            if (!path.starts_with(mount.Path)) continue;
-            auto fs_path = path.substr(mount.Path.size());
-            return mount.FS->directory_data(fs_path, entry_count, dirents);
-        }
+        usz prefix = 0;
+        if (auto fs = mount_under(path, 0, prefix))
+            return fs->directory_data(path.substr(prefix), entry_count, dirents);
         return -1;
     }
 
@@ -225,10 +259,16 @@ private:
     // elements past this vector's index and iterator invalidation.
     /// NOTE: Just a vector, nothing to see here.
     std::sparse_vector<std::shared_ptr<FileMetadata>, nullptr, SysFD> Files;
-    std::vector<MountPoint> Mounts;
+    /// Read without locks; see `MountTable`.
+    MountTable* Mounts { nullptr };
+    /// Serialises `mount()`.
+    Spinlock MountsLock { "VFS::Mounts" };
 
     void free_fd(SysFD fd, ProcFD procfd);
     void free_fd(Process*, SysFD fd, ProcFD procfd);
+    /// Note a read of COUNT bytes at OFFSET into META, and if it follows
+    /// on from the last one, have the filesystem fetch what comes next.
+    void read_ahead(FileMetadata* meta, usz offset, usz count);
     bool valid(Process *proc, ProcFD procfd) const;
     bool valid(ProcFD procfd) const;
     bool valid(SysFD fd) const;
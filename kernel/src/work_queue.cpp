@@ -0,0 +1,88 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#include <work_queue.h>
+
+#include <format>
+#include <scheduler.h>
+
+WorkQueue gWorkQueue;
+
+bool WorkQueue::start(const char* name) {
+    if (Worker) return true;
+    Worker = Scheduler::create_kernel_thread(worker, this, name);
+    if (!Worker) {
+        std::print("[WORK]: Could not create worker thread \"{}\"\n", name);
+        return false;
+    }
+    return true;
+}
+
+bool WorkQueue::queue(Work* work) {
+    u64 flags = Lock.lock_irqsave();
+    if (work->Pending) {
+        Lock.unlock_irqrestore(flags);
+        return false;
+    }
+    work->Pending = true;
+    work->Next = nullptr;
+    if (Tail) Tail->Next = work;
+    else Head = work;
+    Tail = work;
+    if (Worker && Worker->State == Process::SLEEPING)
+        Scheduler::make_runnable(Worker, true);
+    Lock.unlock_irqrestore(flags);
+    return true;
+}
+
+Work* WorkQueue::pop() {
+    Work* work = Head;
+    if (!work) return nullptr;
+    Head = work->Next;
+    if (!Head) Tail = nullptr;
+    work->Next = nullptr;
+    // Cleared before running, so that work may queue itself again.
+    work->Pending = false;
+    return work;
+}
+
+void WorkQueue::worker(void* data) {
+    auto* queue = static_cast<WorkQueue*>(data);
+    for (;;) {
+        // Interrupts are disabled between finding the queue empty and
+        // going to sleep, so that work queued in between isn't missed.
+        u64 flags = queue->Lock.lock_irqsave();
+        Work* work = queue->pop();
+        if (!work) {
+            queue->Lock.unlock();
+            Scheduler::sleep_kernel_thread();
+            asm volatile ("sti");
+            continue;
+        }
+        queue->Lock.unlock();
+        // Interrupts stay disabled while running work, as they do for
+        // RCU callbacks: work frees memory, and the heap and the page
+        // allocator are only safe to use with interrupts disabled.
+        work->Function(work);
+        asm volatile ("push %0\n"
+                      "popfq\n"
+                      :: "r"(flags)
+                      : "memory", "cc");
+    }
+}
@@ -0,0 +1,88 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_WORK_QUEUE_H
+#define LENSOR_OS_WORK_QUEUE_H
+
+#include <integers.h>
+#include <spinlock.h>
+
+struct Process;
+
+/// A unit of deferred work. Like a `Timer`, work is intrusive: the
+/// owner must keep it alive (and at the same address) until it has
+/// been run.
+struct Work {
+    using Callback = void(*)(Work*);
+
+    Callback Function { nullptr };
+    /// Free for use by the owner of the work (i.e. to find itself
+    /// again from within the callback).
+    void* Data { nullptr };
+
+    /// Constant expressions, so that static work items are initialised
+    /// at compile time (global constructors are never run).
+    constexpr Work() = default;
+    constexpr Work(Callback function, void* data = nullptr)
+        : Function(function), Data(data) {}
+
+    /// Work is linked into a queue by address.
+    Work(const Work&) = delete;
+    Work& operator=(const Work&) = delete;
+
+    bool pending() const { return Pending; }
+
+private:
+    friend class WorkQueue;
+    Work* Next { nullptr };
+    bool Pending { false };
+};
+
+/// Work queued here is run in order by a kernel thread of it's own, so
+/// that interrupt handlers and syscalls can put off anything that
+/// doesn't need to happen right away. The thread may be interrupted
+/// between one piece of work and the next.
+class WorkQueue {
+public:
+    /// Create the kernel thread that runs queued work. Work queued
+    /// before this is run as soon as the thread first runs.
+    bool start(const char* name);
+
+    /// Queue work to be run. Safe to call from interrupt handlers.
+    /// Work is run with interrupts disabled, like a syscall.
+    /// @return false iff the work was already pending; it will still
+    /// only be run once.
+    bool queue(Work*);
+
+private:
+    /// Taken with interrupts disabled, as work is queued from interrupt
+    /// handlers.
+    Spinlock Lock { "WorkQueue" };
+    Work* Head { nullptr };
+    Work* Tail { nullptr };
+    Process* Worker { nullptr };
+
+    Work* pop();
+    static void worker(void* queue);
+};
+
+/// The kernel's general purpose work queue.
+extern WorkQueue gWorkQueue;
+
+#endif /* LENSOR_OS_WORK_QUEUE_H */
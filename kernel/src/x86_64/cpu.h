@@ -45,4 +45,16 @@ struct CPUState {
     InterruptFrame Frame;
 } __attribute__((packed));
 
+/// Data private to each CPU. While in the kernel, it is at the base of
+/// the GS segment; `swapgs` swaps it in on entry from userspace.
+/// NOTE: Offsets are used from assembly; see `syscalls.asm`.
+struct PerCPU {
+    /// The stack `syscall` switches to; the same as the TSS' RSP0.
+    u64 KernelStack { 0 };
+    /// Where the user stack pointer is kept until it has been saved.
+    u64 UserStack { 0 };
+};
+static_assert(__builtin_offsetof(PerCPU, KernelStack) == 0x00);
+static_assert(__builtin_offsetof(PerCPU, UserStack) == 0x08);
+
 #endif // LENSOR_OS_X86_64_CPU_H
@@ -0,0 +1,56 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses
+ */
+
+#ifndef LENSOR_OS_X86_64_MSR_H
+#define LENSOR_OS_X86_64_MSR_H
+
+#include <integers.h>
+
+/// Model specific registers.
+namespace MSR {
+    /// Extended features; bit zero enables `syscall`/`sysret`.
+    constexpr u32 EFER = 0xc0000080;
+    /// Segment selectors loaded by `syscall` and `sysret`.
+    constexpr u32 STAR = 0xc0000081;
+    /// Entry point of `syscall` in 64-bit mode.
+    constexpr u32 LSTAR = 0xc0000082;
+    /// RFLAGS bits cleared by `syscall`.
+    constexpr u32 SFMASK = 0xc0000084;
+    constexpr u32 FS_BASE = 0xc0000100;
+    constexpr u32 GS_BASE = 0xc0000101;
+    /// Swapped with GS_BASE by `swapgs`.
+    constexpr u32 KERNEL_GS_BASE = 0xc0000102;
+
+    inline u64 read(u32 msr) {
+        u32 low;
+        u32 high;
+        asm volatile ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+        return (u64(high) << 32) | low;
+    }
+
+    inline void write(u32 msr, u64 value) {
+        asm volatile ("wrmsr"
+                      :: "c"(msr)
+                      , "a"(u32(value))
+                      , "d"(u32(value >> 32))
+                      );
+    }
+}
+
+#endif /* LENSOR_OS_X86_64_MSR_H */
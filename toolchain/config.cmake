@@ -52,6 +52,22 @@ Particularly useful if the terminal you are using does not support it.
 On by default for compatibility reasons."
   ON
 )
+if (CMAKE_BUILD_TYPE STREQUAL "Debug")
+  set(LOCK_DEBUG_DEFAULT ON)
+else()
+  set(LOCK_DEBUG_DEFAULT OFF)
+endif()
+option(
+  LOCK_DEBUG
+  "Check the order kernel spinlocks are taken in, and report any that could deadlock.
+On by default in debug builds."
+  ${LOCK_DEBUG_DEFAULT}
+)
+option(
+  LOCK_STATS
+  "Count acquisitions, contention, and hold times of every kernel spinlock."
+  OFF
+)
 option(
   QEMU_DEBUG
   "Start QEMU with `-S -s` flags, halting startup until a debugger has been attached."
@@ -18,8 +18,44 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <sys/syscalls.h>
+#include <unistd.h>
 
-int main(void) {
+static int parse_int(const char *s) {
+  int sign = 1;
+  int value = 0;
+  if (*s == '-') {
+    sign = -1;
+    ++s;
+  }
+  while (*s >= '0' && *s <= '9')
+    value = value * 10 + (*s++ - '0');
+  return sign * value;
+}
+
+/// `blazeit hog [nice]` leaves a process spinning on the CPU in the
+/// background, which is useful for seeing how responsive the shell is
+/// while the system is under load.
+int main(int argc, const char **argv) {
+  if (argc > 1 && strcmp(argv[1], "hog") == 0) {
+    int nice = 0;
+    if (argc > 2) {
+      nice = parse_int(argv[2]);
+      if (syscall(SYS_setpriority, 0, nice) != 0) {
+        printf("blazeit: could not set nice value to %d\n", nice);
+        return 1;
+      }
+    }
+    printf("  >== blazing in the background (nice %d) ==>\n", nice);
+    if (fork() == 0) {
+      // Close our end of the shell's pipe so it doesn't wait on us.
+      close(STDOUT_FILENO);
+      for (;;)
+        ;
+    }
+    return 0;
+  }
   puts("  >== blaze it, mafk ==>");
   return 420;
 }
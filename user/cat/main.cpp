@@ -1,5 +1,54 @@
 #include <stdio.h>
 #include <stddef.h>
+#include <unistd.h>
+#include <sys/io_ring.h>
+
+// A batch of reads is handed to the kernel at once, and then the
+// writes of whatever was read, so that each batch costs two trips
+// into the kernel rather than two per buffer.
+constexpr uint32_t batch = 8;
+constexpr size_t buffer_size = 512;
+static char buffers[batch][buffer_size];
+
+static int cat_with_ring(io_ring* ring, int fd) {
+    for (;;) {
+        for (uint32_t i = 0; i < batch; ++i) {
+            io_sqe sqe{};
+            sqe.op = IO_RING_OP_READ;
+            sqe.fd = fd;
+            sqe.addr = (uintptr_t)buffers[i];
+            sqe.len = buffer_size;
+            sqe.user_data = i;
+            io_ring_push(ring, &sqe);
+        }
+        io_ring_submit(ring, batch);
+
+        size_t lengths[batch] = {};
+        bool done = false;
+        io_cqe cqe;
+        while (io_ring_pop(ring, &cqe)) {
+            if (cqe.res <= 0) done = true;
+            else lengths[cqe.user_data] = (size_t)cqe.res;
+        }
+
+        uint32_t writes = 0;
+        for (uint32_t i = 0; i < batch; ++i) {
+            if (not lengths[i]) continue;
+            io_sqe sqe{};
+            sqe.op = IO_RING_OP_WRITE;
+            sqe.fd = STDOUT_FILENO;
+            sqe.addr = (uintptr_t)buffers[i];
+            sqe.len = lengths[i];
+            io_ring_push(ring, &sqe);
+            ++writes;
+        }
+        io_ring_submit(ring, writes);
+        while (io_ring_pop(ring, &cqe))
+            if (cqe.res < 0) return 1;
+
+        if (done) return 0;
+    }
+}
 
 int main(int argc, char** argv) {
     if (argc != 2) {
@@ -7,19 +56,18 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    FILE* f = fopen(argv[1], "rb");
-    if (not f) {
+    int fd = open(argv[1], 0, 0);
+    if (fd < 0) {
         printf("Could not open file at %s\n", argv[1]);
         return 1;
     }
 
-    constexpr int bytes_to_read = 1;
-    char c[bytes_to_read];
-    size_t bytes_read;
-    while ((bytes_read = fread(&c[0], 1, bytes_to_read, f)) > 0) {
-        if (feof(f) or ferror(f) || bytes_read != bytes_to_read) break;
-        fwrite(&c[0], 1, bytes_read, stdout);
-    }
+    io_ring* ring = syscall<io_ring*>(SYS_io_setup, batch);
+    if (ring) return cat_with_ring(ring, fd);
+
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, buffers[0], buffer_size)) > 0)
+        write(STDOUT_FILENO, buffers[0], bytes_read);
 
     return 0;
 }
@@ -0,0 +1,41 @@
+#include <format>
+
+#include <stdint.h>
+#include <sys/syscalls.h>
+#include <unistd.h>
+
+// Measures keystroke latency: how long this process waits for the CPU
+// after being woken up by a key it was reading. Type some keys, then
+// press `q`. Run it alone, and again with `blazeit hog` spinning in
+// the background, to see how an interactive program fares under load;
+// and on kernels before and after a scheduler change, to compare them.
+
+int main() {
+    sched_stats before{};
+    if (std::sys_sched_stats(0, &before) != 0) {
+        std::print("keylat: could not get scheduler statistics\n");
+        return 1;
+    }
+
+    // Nothing is printed until the end, as writing may block (and so
+    // be woken up) as well.
+    uint64_t keys = 0;
+    char c = 0;
+    while (c != 'q' && read(STDIN_FILENO, &c, 1) == 1)
+        ++keys;
+
+    sched_stats after{};
+    if (std::sys_sched_stats(0, &after) != 0) {
+        std::print("keylat: could not get scheduler statistics\n");
+        return 1;
+    }
+    uint64_t wakeups = after.wakeups - before.wakeups;
+    uint64_t latency = after.wakeup_latency - before.wakeup_latency;
+    std::print("{} keys, {} wakeups\n"
+               "  average wakeup latency: {} us\n"
+               "  worst wakeup latency:   {} us\n"
+               , keys, wakeups
+               , wakeups ? latency / wakeups / 1000 : 0
+               , after.max_wakeup_latency / 1000);
+    return 0;
+}
@@ -128,6 +128,8 @@ __BEGIN_DECLS__
 [[gnu::used]] void* __dso_handle;
 #endif
 
+/// The main thread's control block goes in first, so that locks work.
+void __libc_init_threads();
 /// Malloc *must* be initialised before anything else.
 void __libc_init_malloc();
 void __libc_fini_malloc();
@@ -185,6 +187,7 @@ void __cxa_finalize(__dso_handle_t dso) {
 
 /// Call global constructors.
 void __libc_init() noexcept {
+    __libc_init_threads();
     __libc_init_malloc();
 
     DBGMSG("[LibC] Calling global constructors\n");
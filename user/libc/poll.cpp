@@ -0,0 +1,107 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "poll.h"
+
+#include "errno.h"
+#include "stdlib.h"
+#include "sys/select.h"
+#include "sys/syscalls.h"
+#include "time.h"
+
+/// The most files the kernel will `poll` at once.
+static constexpr nfds_t poll_max = 1024;
+
+static int64_t now_milliseconds() {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1'000'000;
+}
+
+extern "C" {
+    int poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+        if (nfds > poll_max) {
+            errno = EINVAL;
+            return -1;
+        }
+        int64_t deadline = timeout > 0 ? now_milliseconds() + timeout : 0;
+        int64_t remaining = timeout;
+        int rc = 0;
+        // One of the files may have become ready; look again, waiting
+        // only for what is left of the timeout.
+        while ((rc = syscall<int>(SYS_poll, fds, nfds, remaining)) == -2) {
+            if (timeout <= 0) continue;
+            remaining = deadline - now_milliseconds();
+            if (remaining <= 0) remaining = 0;
+        }
+        if (rc < 0) errno = EINVAL;
+        return rc;
+    }
+
+    int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout) {
+        if (nfds < 0 || nfds > FD_SETSIZE
+            || (timeout && (timeout->tv_usec < 0 || timeout->tv_usec >= 1'000'000))) {
+            errno = EINVAL;
+            return -1;
+        }
+        int milliseconds = -1;
+        if (timeout) milliseconds = int(timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000);
+
+        struct pollfd* fds = (struct pollfd*)malloc(sizeof(struct pollfd) * (nfds ? nfds : 1));
+        if (!fds) {
+            errno = ENOMEM;
+            return -1;
+        }
+        nfds_t count = 0;
+        for (int fd = 0; fd < nfds; ++fd) {
+            short events = 0;
+            if (readfds && FD_ISSET(fd, readfds)) events |= POLLIN;
+            if (writefds && FD_ISSET(fd, writefds)) events |= POLLOUT;
+            if (events) fds[count++] = {fd, events, 0};
+        }
+
+        int rc = poll(fds, count, milliseconds);
+        if (rc < 0) {
+            free(fds);
+            return -1;
+        }
+
+        if (readfds) FD_ZERO(readfds);
+        if (writefds) FD_ZERO(writefds);
+        if (exceptfds) FD_ZERO(exceptfds);
+        int ready = 0;
+        for (nfds_t i = 0; i < count; ++i) {
+            if (fds[i].revents & POLLNVAL) {
+                free(fds);
+                errno = EBADF;
+                return -1;
+            }
+            if (fds[i].revents & POLLIN) {
+                FD_SET(fds[i].fd, readfds);
+                ++ready;
+            }
+            if (fds[i].revents & POLLOUT) {
+                FD_SET(fds[i].fd, writefds);
+                ++ready;
+            }
+        }
+        free(fds);
+        return ready;
+    }
+}
@@ -0,0 +1,64 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _POLL_H
+#define _POLL_H
+
+#include <bits/decls.h>
+#include <stdint.h>
+
+__BEGIN_DECLS__
+
+/// May be read from without blocking.
+#define POLLIN   0x01
+/// Urgent data may be read; never returned.
+#define POLLPRI  0x02
+/// May be written to without blocking.
+#define POLLOUT  0x04
+/// Never returned; errors show up when the file is read or written.
+#define POLLERR  0x08
+#define POLLHUP  0x10
+/// The file descriptor isn't open; only ever returned.
+#define POLLNVAL 0x20
+
+#define POLLRDNORM POLLIN
+#define POLLWRNORM POLLOUT
+
+typedef unsigned long nfds_t;
+
+/// The layout must match that of `PollFD` in the kernel.
+struct pollfd {
+    int fd;
+    short events;
+    short revents;
+};
+
+/// Wait until any of the NFDS files in FDS is ready for one of the
+/// EVENTS asked of it, or TIMEOUT milliseconds have passed; a negative
+/// TIMEOUT waits for as long as it takes. Negative file descriptors
+/// are ignored. The events each file is ready for are stored in it's
+/// REVENTS. Files that are always ready (i.e. regular files) are
+/// reported as such.
+/// Returns the number of FDS with events returned, zero on timeout, or
+/// -1 with errno set to EINVAL if NFDS is too large.
+int poll(struct pollfd* fds, nfds_t nfds, int timeout);
+
+__END_DECLS__
+
+#endif /* _POLL_H */
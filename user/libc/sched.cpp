@@ -0,0 +1,54 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sched.h"
+
+#include "errno.h"
+#include "sys/syscalls.h"
+
+extern "C" {
+    int sched_setaffinity(pid_t pid, size_t size, const cpu_set_t* set) {
+        if (!set || !size) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (syscall<int>(SYS_sched_setaffinity, pid, size, set->__bits) == -1) {
+            // The kernel doesn't say why; if the process exists, it
+            // must have been the set.
+            uint64_t mask = 0;
+            bool exists = syscall<ssize_t>(SYS_sched_getaffinity, pid, sizeof(mask), &mask) != -1;
+            errno = exists ? EINVAL : ESRCH;
+            return -1;
+        }
+        return 0;
+    }
+
+    int sched_getaffinity(pid_t pid, size_t size, cpu_set_t* set) {
+        if (!set || size < sizeof(cpu_set_t)) {
+            errno = EINVAL;
+            return -1;
+        }
+        CPU_ZERO(set);
+        if (syscall<ssize_t>(SYS_sched_getaffinity, pid, size, set->__bits) == -1) {
+            errno = ESRCH;
+            return -1;
+        }
+        return 0;
+    }
+}
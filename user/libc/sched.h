@@ -0,0 +1,58 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include <bits/decls.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS__
+
+/// The number of CPUs a `cpu_set_t` can hold.
+#define CPU_SETSIZE 64
+
+/// A set of CPUs, i.e. those a process may run on.
+typedef struct {
+    uint64_t __bits[CPU_SETSIZE / 64];
+} cpu_set_t;
+
+#define CPU_ZERO(set) ((set)->__bits[0] = 0)
+#define CPU_SET(cpu, set) ((set)->__bits[0] |= (uint64_t)1 << (cpu))
+#define CPU_CLR(cpu, set) ((set)->__bits[0] &= ~((uint64_t)1 << (cpu)))
+#define CPU_ISSET(cpu, set) (((set)->__bits[0] >> (cpu)) & 1)
+#define CPU_COUNT(set) __builtin_popcountll((set)->__bits[0])
+
+/// Restrict the process with PID, or the calling process if PID is
+/// zero, to the CPUs in SET, which is SIZE bytes. New processes and
+/// threads inherit the set of their parent.
+/// Returns 0, or -1 with errno set to EINVAL if none of the CPUs in SET
+/// are online, or ESRCH if there is no such process.
+int sched_setaffinity(pid_t pid, size_t size, const cpu_set_t* set);
+
+/// Store the CPUs the process with PID (or the calling process, if
+/// zero) may run on in SET, which is SIZE bytes.
+/// Returns 0, or -1 with errno set.
+int sched_getaffinity(pid_t pid, size_t size, cpu_set_t* set);
+
+__END_DECLS__
+
+#endif /* _SCHED_H */
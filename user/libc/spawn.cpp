@@ -0,0 +1,106 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "spawn.h"
+
+#include "errno.h"
+#include "sys/syscalls.h"
+
+extern "C" {
+    int posix_spawn_file_actions_init(posix_spawn_file_actions_t* actions) {
+        actions->count = 0;
+        return 0;
+    }
+
+    int posix_spawn_file_actions_destroy(posix_spawn_file_actions_t* actions) {
+        actions->count = 0;
+        return 0;
+    }
+
+    static int add_action(posix_spawn_file_actions_t* actions, uint64_t type, int fd, int newfd) {
+        if (fd < 0 || newfd < 0) return EBADF;
+        if (actions->count == SPAWN_ACTIONS_MAX) return ENOMEM;
+        actions->actions[actions->count++] = {type, uint64_t(fd), uint64_t(newfd)};
+        return 0;
+    }
+
+    int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* actions, int fd, int newfd) {
+        return add_action(actions, SPAWN_ACTION_DUP2, fd, newfd);
+    }
+
+    int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* actions, int fd) {
+        return add_action(actions, SPAWN_ACTION_CLOSE, fd, 0);
+    }
+
+    int posix_spawnattr_init(posix_spawnattr_t* attributes) {
+        attributes->flags = 0;
+        CPU_ZERO(&attributes->affinity);
+        return 0;
+    }
+
+    int posix_spawnattr_destroy(posix_spawnattr_t* attributes) {
+        (void)attributes;
+        return 0;
+    }
+
+    int posix_spawnattr_getflags(const posix_spawnattr_t* attributes, short* flags) {
+        *flags = attributes->flags;
+        return 0;
+    }
+
+    int posix_spawnattr_setflags(posix_spawnattr_t* attributes, short flags) {
+        if (flags & ~POSIX_SPAWN_SETAFFINITY_NP) return EINVAL;
+        attributes->flags = flags;
+        return 0;
+    }
+
+    int posix_spawnattr_getaffinity_np(const posix_spawnattr_t* attributes, size_t size, cpu_set_t* set) {
+        if (size < sizeof(cpu_set_t)) return EINVAL;
+        *set = attributes->affinity;
+        return 0;
+    }
+
+    int posix_spawnattr_setaffinity_np(posix_spawnattr_t* attributes, size_t size, const cpu_set_t* set) {
+        if (size < sizeof(cpu_set_t)) return EINVAL;
+        attributes->affinity = *set;
+        return 0;
+    }
+
+    int posix_spawn(pid_t* pid, const char* path,
+                    const posix_spawn_file_actions_t* actions,
+                    const posix_spawnattr_t* attributes,
+                    char* const argv[], char* const envp[]) {
+        (void)envp;
+        if (!path) return EINVAL;
+        // The kernel passes PATH along as argv[0] itself.
+        char* const* args = argv && argv[0] ? argv + 1 : nullptr;
+        const uint64_t* affinity = nullptr;
+        if (attributes && (attributes->flags & POSIX_SPAWN_SETAFFINITY_NP))
+            affinity = attributes->affinity.__bits;
+        pid_t child = syscall<pid_t>(SYS_spawn, path, args,
+                                     actions ? actions->actions : nullptr,
+                                     actions ? actions->count : 0,
+                                     affinity);
+        // The kernel doesn't say why; most likely, there is no such
+        // executable.
+        if (child == pid_t(-1)) return ENOENT;
+        if (pid) *pid = child;
+        return 0;
+    }
+}
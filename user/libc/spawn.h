@@ -0,0 +1,88 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPAWN_H
+#define _SPAWN_H
+
+#include <bits/decls.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS__
+
+#define SPAWN_ACTION_DUP2  0
+#define SPAWN_ACTION_CLOSE 1
+
+/// The layout must match that of `SpawnAction` in the kernel.
+struct spawn_action {
+    uint64_t type;
+    uint64_t fd;
+    uint64_t newfd;
+};
+
+/// The most file actions one spawn may be given.
+#define SPAWN_ACTIONS_MAX 64
+
+/// What is done to the files of a spawned process before it runs, in
+/// the order the actions were added.
+typedef struct {
+    size_t count;
+    struct spawn_action actions[SPAWN_ACTIONS_MAX];
+} posix_spawn_file_actions_t;
+
+#define POSIX_SPAWN_SETAFFINITY_NP 1
+
+/// How a process is spawned, beyond what is done to it's files.
+typedef struct {
+    short flags;
+    cpu_set_t affinity;
+} posix_spawnattr_t;
+
+/// These return zero, or an error number (ENOMEM when full).
+int posix_spawn_file_actions_init(posix_spawn_file_actions_t* actions);
+int posix_spawn_file_actions_destroy(posix_spawn_file_actions_t* actions);
+int posix_spawn_file_actions_adddup2(posix_spawn_file_actions_t* actions, int fd, int newfd);
+int posix_spawn_file_actions_addclose(posix_spawn_file_actions_t* actions, int fd);
+
+int posix_spawnattr_init(posix_spawnattr_t* attributes);
+int posix_spawnattr_destroy(posix_spawnattr_t* attributes);
+int posix_spawnattr_getflags(const posix_spawnattr_t* attributes, short* flags);
+int posix_spawnattr_setflags(posix_spawnattr_t* attributes, short flags);
+/// Have the child run only on the CPUs in SET from the start, as if by
+/// `sched_setaffinity`, when POSIX_SPAWN_SETAFFINITY_NP is set.
+int posix_spawnattr_getaffinity_np(const posix_spawnattr_t* attributes, size_t size, cpu_set_t* set);
+int posix_spawnattr_setaffinity_np(posix_spawnattr_t* attributes, size_t size, const cpu_set_t* set);
+
+/// Start the executable at PATH as a new child process, without
+/// copying the calling process first as `fork` does. The child starts
+/// with the caller's files open, with ACTIONS (if not NULL) applied.
+/// The child is always given PATH as argv[0]; ARGV[0] is skipped.
+/// ATTRIBUTES (if not NULL) is applied before the child first runs.
+/// ENVP is ignored, as there are no environment variables.
+/// On success, store the child's PID in PID (if not NULL) and return
+/// zero, otherwise return an error number.
+int posix_spawn(pid_t* pid, const char* path,
+                const posix_spawn_file_actions_t* actions,
+                const posix_spawnattr_t* attributes,
+                char* const argv[], char* const envp[]);
+
+__END_DECLS__
+
+#endif /* _SPAWN_H */
@@ -30,6 +30,7 @@
 #include "string.h"
 #include "unistd.h"
 #include "sys/syscalls.h"
+#include "sys/uio.h"
 
 #include <algorithm>
 #include <atomic>
@@ -521,21 +522,27 @@ bool _IO_File::write(char c) {
 }
 
 ssize_t _IO_File::write_internal(const char* __restrict__ buffer, size_t count) {
-    /// Flush the buffer if this operation would overflow it.
-    if (__wbuf.__offs + count > __wbuf.__cap and not flush())
-        return EOF;
-
-    /// Write data directly to the stream if it doesn't fit in the buffer.
+    /// Write data directly to the stream if it doesn't fit in the buffer,
+    /// right after whatever is buffered, in a single call.
     if (count > __wbuf.__cap) {
-        auto written = ::write(__fd, buffer, count);
-        if (written < 0 || size_t(written) != count) {
+        iovec vectors[2] = {
+            {__wbuf.__buf, __wbuf.__offs},
+            {const_cast<char*>(buffer), count},
+        };
+        auto written = ::writev(__fd, vectors, 2);
+        if (written < 0 || size_t(written) != __wbuf.__offs + count) {
             __f_error = true;
             return EOF;
         }
 
+        __wbuf.__offs = 0;
         return ssize_t(count);
     }
 
+    /// Flush the buffer if this operation would overflow it.
+    if (__wbuf.__offs + count > __wbuf.__cap and not flush())
+        return EOF;
+
     /// Write data to the buffer.
     memcpy(__wbuf.__buf + __wbuf.__offs, buffer, count);
     __wbuf.__offs += count;
@@ -0,0 +1,80 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LENSOR_OS_LIBC_IO_RING_H
+#define _LENSOR_OS_LIBC_IO_RING_H
+
+#include <bits/decls.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/syscalls.h>
+
+/// Helpers for the submission and completion rings set up by
+/// `sys_io_setup`. A ring belongs to a single thread at a time.
+
+__BEGIN_DECLS__
+
+static inline struct io_sqe* io_ring_sqes(struct io_ring* ring) {
+    return (struct io_sqe*)((char*)ring + ring->sq_offset);
+}
+
+static inline struct io_cqe* io_ring_cqes(struct io_ring* ring) {
+    return (struct io_cqe*)((char*)ring + ring->cq_offset);
+}
+
+/// Copy SQE onto the submission ring. Returns false if it is full.
+static inline bool io_ring_push(struct io_ring* ring, const struct io_sqe* sqe) {
+    uint32_t head = __atomic_load_n(&ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_tail - head == ring->sq_entries) return false;
+    io_ring_sqes(ring)[ring->sq_tail & (ring->sq_entries - 1)] = *sqe;
+    __atomic_store_n(&ring->sq_tail, ring->sq_tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/// The number of completions waiting to be popped.
+static inline uint32_t io_ring_ready(struct io_ring* ring) {
+    return __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE) - ring->cq_head;
+}
+
+/// Pop the oldest completion into CQE. Returns false if there is none.
+static inline bool io_ring_pop(struct io_ring* ring, struct io_cqe* cqe) {
+    if (!io_ring_ready(ring)) return false;
+    *cqe = io_ring_cqes(ring)[ring->cq_head & (ring->cq_entries - 1)];
+    __atomic_store_n(&ring->cq_head, ring->cq_head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/// Hand everything pushed so far to the kernel, in a single entry if
+/// possible, and wait until at least MIN_COMPLETE completions are
+/// waiting (or nothing more is pending).
+/// Returns the number of completions waiting.
+static inline uint32_t io_ring_submit(struct io_ring* ring, uint32_t min_complete) {
+    // Having slept, the kernel has only noticed that something pending
+    // may be able to make progress; entering again finds out.
+    do {
+        uint32_t to_submit = ring->sq_tail - __atomic_load_n(&ring->sq_head, __ATOMIC_ACQUIRE);
+        syscall(SYS_io_enter, (uintptr_t)to_submit, (uintptr_t)min_complete);
+    } while (io_ring_ready(ring) < min_complete
+             && __atomic_load_n(&ring->pending, __ATOMIC_ACQUIRE));
+    return io_ring_ready(ring);
+}
+
+__END_DECLS__
+
+#endif /* _LENSOR_OS_LIBC_IO_RING_H */
@@ -0,0 +1,60 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SYS_SELECT_H
+#define _SYS_SELECT_H
+
+#include <bits/decls.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS__
+
+/// The number of file descriptors an `fd_set` can hold.
+#define FD_SETSIZE 1024
+
+/// A set of file descriptors.
+typedef struct {
+    uint64_t __bits[FD_SETSIZE / 64];
+} fd_set;
+
+#define FD_ZERO(set) __builtin_memset((set), 0, sizeof(fd_set))
+#define FD_SET(fd, set) ((set)->__bits[(fd) / 64] |= (uint64_t)1 << ((fd) % 64))
+#define FD_CLR(fd, set) ((set)->__bits[(fd) / 64] &= ~((uint64_t)1 << ((fd) % 64)))
+#define FD_ISSET(fd, set) (((set)->__bits[(fd) / 64] >> ((fd) % 64)) & 1)
+
+struct timeval {
+    time_t tv_sec;
+    long tv_usec;
+};
+
+/// Wait until any of the file descriptors below NFDS in READFDS may be
+/// read, or any of those in WRITEFDS may be written, without blocking,
+/// or until TIMEOUT has passed; a NULL TIMEOUT waits for as long as it
+/// takes. Each set (which may be NULL) is left holding only the file
+/// descriptors that are ready. Nothing is ever exceptional, so
+/// EXCEPTFDS is always cleared. Built on `poll`.
+/// Returns the number of file descriptors in all of the sets, zero on
+/// timeout, or -1 with errno set to EBADF if one of them isn't open,
+/// or EINVAL if NFDS or TIMEOUT is invalid.
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, struct timeval* timeout);
+
+__END_DECLS__
+
+#endif /* _SYS_SELECT_H */
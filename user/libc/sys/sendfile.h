@@ -0,0 +1,41 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H
+
+#include <bits/decls.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS__
+
+/// Copy up to COUNT bytes from IN_FD to OUT_FD within the kernel. If
+/// OFFSET is not NULL, read from there (and update it to just past
+/// what was read), leaving the offset of IN_FD alone.
+/// Return the number of bytes copied, or -1 on error.
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+
+/// Like `sendfile`, except that OUT_FD may be given an offset too.
+/// Pipes and sockets ignore offsets.
+ssize_t splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count);
+
+__END_DECLS__
+
+#endif /* _SYS_SENDFILE_H */
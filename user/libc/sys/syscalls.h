@@ -53,7 +53,29 @@
 #define SYS_kqueue  23
 #define SYS_kevent  24
 #define SYS_directory_data 25
-#define SYS_MAXSYSCALL 25
+#define SYS_setpriority 26
+#define SYS_nanosleep 27
+#define SYS_timeout 28
+#define SYS_thread_create 29
+#define SYS_thread_exit 30
+#define SYS_thread_join 31
+#define SYS_futex   32
+#define SYS_set_tls 33
+#define SYS_sched_setaffinity 34
+#define SYS_sched_getaffinity 35
+#define SYS_sched_stats 36
+#define SYS_io_setup 37
+#define SYS_io_enter 38
+#define SYS_readv   39
+#define SYS_writev  40
+#define SYS_pread   41
+#define SYS_pwrite  42
+#define SYS_sendfile 43
+#define SYS_splice  44
+#define SYS_systrace 45
+#define SYS_spawn   46
+#define SYS_poll    47
+#define SYS_MAXSYSCALL 47
 #else
 #define SYS_read  0
 #define SYS_write 1
@@ -71,14 +93,17 @@ __BEGIN_DECLS__
 #define __a uintptr_t
 
 /// Syscall argument registers.
+/// NOTE: `syscall` puts the return address in rcx, so the fourth
+/// argument goes in r10. LensorOS also still accepts `int $0x80`, with
+/// the fourth argument in rcx.
 #if defined(__lensor__)
 #define _R1 "D"
 #define _R2 "S"
 #define _R3 "d"
-#define _R4 "rcx"
+#define _R4 "r10"
 #define _R5 "r8"
 #define _R6 "r9"
-#define _SYSCALL "int $0x80"
+#define _SYSCALL "syscall"
 #elif defined(__linux__)
 #define _R1 "D"
 #define _R2 "S"
@@ -98,7 +123,7 @@ __BEGIN_DECLS__
             (_SYSCALL "\n"                                                              \
              : "=a"(__result)                                                           \
              : "a"(__n) __VA_OPT__(, ) __VA_ARGS__                                      \
-             : "memory"                                                                 \
+             : "rcx", "r11", "memory"                                                   \
         );                                                                              \
         return __result;                                                                \
     }
@@ -110,15 +135,17 @@ _DEFINE_SYSCALL(1, _DEFINE_SYSCALL_ARGS(__a __1), _R1(__1))
 _DEFINE_SYSCALL(2, _DEFINE_SYSCALL_ARGS(__a __1, __a __2), _R1(__1), _R2(__2))
 _DEFINE_SYSCALL(3, _DEFINE_SYSCALL_ARGS(__a __1, __a __2, __a __3), _R1(__1), _R2(__2), _R3(__3))
 
+/// The remaining arguments go in registers that have no constraint
+/// letter of their own, so they are moved there by hand.
 __attribute__((__always_inline__, __artificial__))
 inline __a __syscall4(__a __n, __a __1, __a __2, __a __3, __a __4) {
     __a __result;
     __asm__ __volatile__
-        ("movq %0, %%" _R4 "\n"
+        ("movq %[__4], %%" _R4 "\n"
          _SYSCALL "\n"
          : "=a"(__result)
-         : "a"(__n), _R1(__1), _R2(__2), _R3(__3), "r"(__4)
-         : "memory", _R4);
+         : "a"(__n), _R1(__1), _R2(__2), _R3(__3), [__4] "r"(__4)
+         : "rcx", "r11", "memory", _R4);
     return __result;
 }
 
@@ -126,12 +153,12 @@ __attribute__((__always_inline__, __artificial__))
 inline __a __syscall5(__a __n, __a __1, __a __2, __a __3, __a __4, __a __5) {
     __a __result;
     __asm__ __volatile__
-        ("movq %0, %%" _R4 "\n"
-         "movq %1, %%" _R5 "\n"
+        ("movq %[__4], %%" _R4 "\n"
+         "movq %[__5], %%" _R5 "\n"
          _SYSCALL "\n"
          : "=a"(__result)
-         : "a"(__n), _R1(__1), _R2(__2), _R3(__3), "r"(__4), "r"(__5)
-         : "memory", _R4, _R5);
+         : "a"(__n), _R1(__1), _R2(__2), _R3(__3), [__4] "r"(__4), [__5] "r"(__5)
+         : "rcx", "r11", "memory", _R4, _R5);
     return __result;
 }
 
@@ -139,13 +166,13 @@ __attribute__((__always_inline__, __artificial__))
 inline __a __syscall6(__a __n, __a __1, __a __2, __a __3, __a __4, __a __5, __a __6) {
     __a __result;
     __asm__ __volatile__
-        ("movq %0, %%" _R4 "\n"
-         "movq %1, %%" _R5 "\n"
-         "movq %2, %%" _R6 "\n"
+        ("movq %[__4], %%" _R4 "\n"
+         "movq %[__5], %%" _R5 "\n"
+         "movq %[__6], %%" _R6 "\n"
          _SYSCALL "\n"
          : "=a"(__result)
-         : "a"(__n), _R1(__1), _R2(__2), _R3(__3), "r"(__4), "r"(__5), "r"(__6)
-         : "memory", _R4, _R5, _R6);
+         : "a"(__n), _R1(__1), _R2(__2), _R3(__3), [__4] "r"(__4), [__5] "r"(__5), [__6] "r"(__6)
+         : "rcx", "r11", "memory", _R4, _R5, _R6);
     return __result;
 }
 
@@ -157,6 +184,10 @@ inline __a __syscall6(__a __n, __a __1, __a __2, __a __3, __a __4, __a __5, __a
 #undef _R5
 #undef _R6
 
+/// Futex operations.
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
 #define SOCK_ADDR_MAX_SIZE 16
 typedef struct sockaddr {
     enum {
@@ -185,6 +216,112 @@ struct DirectoryEntry {
     char file_name[248];
 };
 
+#define SCHED_STATS_BUCKETS 16
+
+/// How a process has fared with the scheduler; see `sys_sched_stats`.
+/// Times are in nanoseconds.
+struct sched_stats {
+    uint64_t runtime;
+    /// Switches away from the process because it blocked, slept, or
+    /// exited, and because something else deserved the CPU more.
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+    /// Time spent runnable, but waiting on the run queue.
+    uint64_t waits;
+    uint64_t wait_time;
+    uint64_t max_wait_time;
+    /// Time from being woken up until actually running.
+    uint64_t wakeups;
+    uint64_t wakeup_latency;
+    uint64_t max_wakeup_latency;
+    /// Bucket zero counts waits on the run queue of less than one
+    /// microsecond, bucket N those of [2^(N-1), 2^N) microseconds, and
+    /// the last bucket everything longer.
+    uint64_t wait_histogram[SCHED_STATS_BUCKETS];
+};
+
+/// Operations of `sys_systrace`.
+#define SYSTRACE_TRACE      0 ///< Trace process A (zero for the caller) if B, else stop.
+#define SYSTRACE_COUNT      1 ///< Count every system call if A, else stop.
+#define SYSTRACE_READ       2 ///< Read up to C records into B, from sequence number *A.
+#define SYSTRACE_STATISTICS 3 ///< Read statistics of up to B system calls into A.
+#define SYSTRACE_RESET      4 ///< Zero the statistics of every system call.
+
+/// One system call made by a traced process.
+struct systrace_record {
+    /// Counts up from zero; a gap means records were overwritten
+    /// before they were read.
+    uint64_t sequence;
+    uint64_t pid;
+    uint64_t number;
+    uint64_t args[6];
+    int64_t result;
+    /// Time stamp counter, as of entry to and exit from the kernel.
+    uint64_t entry_tsc;
+    uint64_t exit_tsc;
+};
+
+#define SYSTRACE_BUCKETS 16
+
+/// How often a system call was made, and how long it took, while
+/// counting. Times are in nanoseconds.
+struct systrace_stats {
+    uint64_t count;
+    uint64_t total_time;
+    uint64_t max_time;
+    /// Bucket zero counts calls that took less than 128ns, bucket N
+    /// those that took [2^(N+6), 2^(N+7)) nanoseconds, and the last
+    /// bucket everything longer.
+    uint64_t histogram[SYSTRACE_BUCKETS];
+};
+
+/// Operations that may be submitted through `struct io_ring`.
+#define IO_RING_OP_NOP     0
+#define IO_RING_OP_READ    1 ///< Read `len` bytes from `fd` into `addr`.
+#define IO_RING_OP_WRITE   2 ///< Write `len` bytes at `addr` to `fd`.
+#define IO_RING_OP_ACCEPT  3 ///< Accept a connection on socket `fd`.
+#define IO_RING_OP_CONNECT 4 ///< Connect socket `fd` to the `len` byte address at `addr`.
+#define IO_RING_OP_KEVENT  5 ///< Store up to `len` events from queue `fd` at `addr`.
+#define IO_RING_OP_WAITPID 6 ///< Wait for process `arg` to exit.
+
+/// A submission; see `sys_io_setup`.
+struct io_sqe {
+    uint8_t op;
+    uint8_t flags;
+    uint16_t __reserved;
+    int32_t fd;
+    uint64_t addr;
+    uint64_t len;
+    uint64_t arg;
+    /// Handed back as-is in the completion.
+    uint64_t user_data;
+};
+
+/// A completion; `res` is what the equivalent syscall would return.
+struct io_cqe {
+    uint64_t user_data;
+    int64_t res;
+};
+
+/// The header of the memory shared with the kernel by `sys_io_setup`.
+/// Userspace only writes `sq_tail` (after filling in submissions) and
+/// `cq_head` (after consuming completions).
+struct io_ring {
+    uint32_t sq_head;
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail;
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    /// Submissions the kernel is holding on to because they would
+    /// have blocked; they are retried every time the process enters.
+    uint32_t pending;
+    uint32_t __reserved;
+    /// Byte offsets of the rings from the start of this header.
+    uint64_t sq_offset;
+    uint64_t cq_offset;
+};
+
 __END_DECLS__
 
 
@@ -316,14 +453,32 @@ typedef enum EventType {
     EVENTTYPE_READY_TO_READ,
     // For sockets/pipes: space is available in the FIFO to write to.
     EVENTTYPE_READY_TO_WRITE,
+    // A periodic timer registered with the event queue has expired.
+    EVENTTYPE_TIMER,
     EVENTTYPE_COUNT
 } EventType;
 typedef union EventFilter {
   ProcFD ProcessFD;
+  // ID is chosen by the program to tell timers apart.
+  struct {
+    uint32_t ID;
+    uint32_t Milliseconds;
+  } Timer;
 } EventFilter;
+/// Flags given along with an event in kevent's changelist.
+/// Level-triggered (the default) READY_TO_READ and READY_TO_WRITE
+/// registrations are reported by every call to kevent for as long as
+/// the file stays ready; edge-triggered ones once each time it becomes
+/// ready.
+#define EVENT_FLAG_EDGE    (1u << 0)
+/// The registration is removed once it has been reported.
+#define EVENT_FLAG_ONESHOT (1u << 1)
+/// Remove the registration matching the type and filter.
+#define EVENT_FLAG_DELETE  (1u << 2)
 #define EVENT_MAX_SIZE 128
 typedef struct Event {
     EventType Type;
+    uint32_t Flags;
     EventFilter Filter;
     uint8_t Data[EVENT_MAX_SIZE];
 } Event;
@@ -331,15 +486,95 @@ typedef struct Event {
 typedef struct EventData_ReadyToReadWrite {
     size_t BytesAvailable;
 } EventData_ReadyToReadWrite;
+/// TIMER events have this data sent with them.
+typedef struct EventData_Timer {
+    uint64_t Tick;
+} EventData_Timer;
 int sys_kqueue() {
   return (int)syscall(SYS_kqueue);
 }
+/// Returns the number of events stored in EVENTLIST, which is zero
+/// if there are none ready, or -1 on error.
 int sys_kevent(int handle, const Event* changelist, int numChanges, Event* eventlist, int maxEvents) {
-  return (int)syscall(SYS_kevent, handle, changelist, numChanges, eventlist, maxEvents);
+  return (int)syscall(SYS_kevent, (uintptr_t)handle, (uintptr_t)changelist, (uintptr_t)numChanges, (uintptr_t)eventlist, (uintptr_t)maxEvents, (uintptr_t)0);
+}
+/// Block for up to TIMEOUT milliseconds for an event to arrive if there
+/// are none ready; a negative TIMEOUT blocks until one arrives.
+/// Returns the number of events stored in EVENTLIST, which is zero on
+/// timeout, or -1 on error.
+int sys_kevent_timeout(int handle, const Event* changelist, int numChanges, Event* eventlist, int maxEvents, ssize_t timeout) {
+  int rc = (int)syscall(SYS_kevent, (uintptr_t)handle, (uintptr_t)changelist, (uintptr_t)numChanges, (uintptr_t)eventlist, (uintptr_t)maxEvents, (uintptr_t)timeout);
+  // An event arrived while we were blocked; the changes have already been applied.
+  while (rc == -2)
+    rc = (int)syscall(SYS_kevent, (uintptr_t)handle, (uintptr_t)NULL, (uintptr_t)0, (uintptr_t)eventlist, (uintptr_t)maxEvents, (uintptr_t)timeout);
+  return rc;
 }
 int sys_directory_data(const char* path, DirectoryEntry* entries, int maxEntries) {
     return (int)syscall(SYS_directory_data, path, entries, maxEntries);
 }
+/// PID zero refers to the calling process.
+/// NICE ranges from -20 (most CPU time) to 19 (least CPU time).
+int sys_setpriority(pid_t pid, int nice) {
+    return (int)syscall(SYS_setpriority, (uintptr_t)pid, (uintptr_t)nice);
+}
+int sys_nanosleep(uint64_t nanoseconds) {
+    return (int)syscall(SYS_nanosleep, (uintptr_t)nanoseconds);
+}
+/// Blocking reads and accepts on FD fail after MILLISECONDS; zero waits forever.
+int sys_timeout(ProcFD fd, size_t milliseconds) {
+    return (int)syscall(SYS_timeout, (uintptr_t)fd, (uintptr_t)milliseconds);
+}
+/// Start a thread running ENTRY(ARG) on the stack at STACKTOP, with
+/// the FS segment based at TLS. Returns the new thread's ID, or -1.
+pid_t sys_thread_create(void* entry, void* arg, void* stackTop, void* tls) {
+    return (pid_t)syscall(SYS_thread_create, (uintptr_t)entry, (uintptr_t)arg, (uintptr_t)stackTop, (uintptr_t)tls);
+}
+void sys_thread_exit(int status) {
+    syscall(SYS_thread_exit, (uintptr_t)status);
+}
+/// Wait for thread TID of the calling process to exit; returns it's status.
+int sys_thread_join(pid_t tid) {
+    return (int)syscall(SYS_thread_join, (uintptr_t)tid);
+}
+/// FUTEX_WAIT: sleep iff *ADDRESS == VALUE. Returns 0 when woken, or -2
+///             if the value differed.
+/// FUTEX_WAKE: wake up to VALUE waiters; returns how many were woken.
+ssize_t sys_futex(uint32_t* address, int operation, uint32_t value) {
+    return (ssize_t)syscall(SYS_futex, (uintptr_t)address, (uintptr_t)operation, (uintptr_t)value);
+}
+int sys_set_tls(void* base) {
+    return (int)syscall(SYS_set_tls, (uintptr_t)base);
+}
+/// PID zero refers to the calling process. Bit N of MASK is CPU N;
+/// SIZE is the size of MASK in bytes.
+int sys_sched_setaffinity(pid_t pid, size_t size, const uint64_t* mask) {
+    return (int)syscall(SYS_sched_setaffinity, (uintptr_t)pid, (uintptr_t)size, (uintptr_t)mask);
+}
+/// Returns the number of bytes stored in MASK, or -1.
+ssize_t sys_sched_getaffinity(pid_t pid, size_t size, uint64_t* mask) {
+    return (ssize_t)syscall(SYS_sched_getaffinity, (uintptr_t)pid, (uintptr_t)size, (uintptr_t)mask);
+}
+/// PID zero refers to the calling process. Returns 0, or -1.
+int sys_sched_stats(pid_t pid, struct sched_stats* stats) {
+    return (int)syscall(SYS_sched_stats, (uintptr_t)pid, (uintptr_t)stats);
+}
+/// Map rings of ENTRIES submissions (at most 256) and twice as many
+/// completions into the calling process. Returns NULL on failure.
+struct io_ring* sys_io_setup(uint32_t entries) {
+    return (struct io_ring*)syscall(SYS_io_setup, (uintptr_t)entries);
+}
+/// Submit up to TO_SUBMIT operations, and sleep if fewer than
+/// MIN_COMPLETE completions are waiting while operations are still
+/// pending. Returns the number of completions waiting, or -2 after
+/// having slept (check the ring and enter again).
+ssize_t sys_io_enter(uint32_t to_submit, uint32_t min_complete) {
+    return (ssize_t)syscall(SYS_io_enter, (uintptr_t)to_submit, (uintptr_t)min_complete);
+}
+/// See `SYSTRACE_*` for what OPERATION may be. Returns the number of
+/// records or statistics read, otherwise 0, or -1.
+ssize_t sys_systrace(uint64_t operation, uint64_t a, uint64_t b, uint64_t c) {
+    return (ssize_t)syscall(SYS_systrace, (uintptr_t)operation, (uintptr_t)a, (uintptr_t)b, (uintptr_t)c);
+}
 
 
 /// ===========================================================================
@@ -462,6 +697,69 @@ inline ProcFD sys_accept(ProcFD socketFD, const sockaddr* address, size_t* addre
 inline int sys_directory_data(const char* path, DirectoryEntry* entries, int maxEntries) {
     return std::__detail::syscall<int>(SYS_directory_data, (uintptr_t)path, (uintptr_t)entries, (uintptr_t)maxEntries);
 }
+/// PID zero refers to the calling process.
+/// NICE ranges from -20 (most CPU time) to 19 (least CPU time).
+inline int sys_setpriority(pid_t pid, int nice) {
+    return std::__detail::syscall<int>(SYS_setpriority, (uintptr_t)pid, (uintptr_t)nice);
+}
+inline int sys_nanosleep(uint64_t nanoseconds) {
+    return std::__detail::syscall<int>(SYS_nanosleep, (uintptr_t)nanoseconds);
+}
+/// Blocking reads and accepts on FD fail after MILLISECONDS; zero waits forever.
+inline int sys_timeout(ProcFD fd, size_t milliseconds) {
+    return std::__detail::syscall<int>(SYS_timeout, (uintptr_t)fd, (uintptr_t)milliseconds);
+}
+/// Start a thread running ENTRY(ARG) on the stack at STACKTOP, with
+/// the FS segment based at TLS. Returns the new thread's ID, or -1.
+inline pid_t sys_thread_create(void* entry, void* arg, void* stackTop, void* tls) {
+    return std::__detail::syscall<pid_t>(SYS_thread_create, (uintptr_t)entry, (uintptr_t)arg, (uintptr_t)stackTop, (uintptr_t)tls);
+}
+inline void sys_thread_exit(int status) {
+    std::__detail::syscall(SYS_thread_exit, (uintptr_t)status);
+}
+/// Wait for thread TID of the calling process to exit; returns it's status.
+inline int sys_thread_join(pid_t tid) {
+    return std::__detail::syscall<int>(SYS_thread_join, (uintptr_t)tid);
+}
+/// FUTEX_WAIT: sleep iff *ADDRESS == VALUE. Returns 0 when woken, or -2
+///             if the value differed.
+/// FUTEX_WAKE: wake up to VALUE waiters; returns how many were woken.
+inline ssize_t sys_futex(uint32_t* address, int operation, uint32_t value) {
+    return std::__detail::syscall<ssize_t>(SYS_futex, (uintptr_t)address, (uintptr_t)operation, (uintptr_t)value);
+}
+inline int sys_set_tls(void* base) {
+    return std::__detail::syscall<int>(SYS_set_tls, (uintptr_t)base);
+}
+/// PID zero refers to the calling process. Bit N of MASK is CPU N;
+/// SIZE is the size of MASK in bytes.
+inline int sys_sched_setaffinity(pid_t pid, size_t size, const uint64_t* mask) {
+    return std::__detail::syscall<int>(SYS_sched_setaffinity, (uintptr_t)pid, (uintptr_t)size, (uintptr_t)mask);
+}
+/// Returns the number of bytes stored in MASK, or -1.
+inline ssize_t sys_sched_getaffinity(pid_t pid, size_t size, uint64_t* mask) {
+    return std::__detail::syscall<ssize_t>(SYS_sched_getaffinity, (uintptr_t)pid, (uintptr_t)size, (uintptr_t)mask);
+}
+/// PID zero refers to the calling process. Returns 0, or -1.
+inline int sys_sched_stats(pid_t pid, sched_stats* stats) {
+    return std::__detail::syscall<int>(SYS_sched_stats, (uintptr_t)pid, (uintptr_t)stats);
+}
+/// Map rings of ENTRIES submissions (at most 256) and twice as many
+/// completions into the calling process. Returns NULL on failure.
+inline io_ring* sys_io_setup(uint32_t entries) {
+    return std::__detail::syscall<io_ring*>(SYS_io_setup, (uintptr_t)entries);
+}
+/// Submit up to TO_SUBMIT operations, and sleep if fewer than
+/// MIN_COMPLETE completions are waiting while operations are still
+/// pending. Returns the number of completions waiting, or -2 after
+/// having slept (check the ring and enter again).
+inline ssize_t sys_io_enter(uint32_t to_submit, uint32_t min_complete) {
+    return std::__detail::syscall<ssize_t>(SYS_io_enter, (uintptr_t)to_submit, (uintptr_t)min_complete);
+}
+/// See `SYSTRACE_*` for what OPERATION may be. Returns the number of
+/// records or statistics read, otherwise 0, or -1.
+inline ssize_t sys_systrace(uint64_t operation, uint64_t a, uint64_t b, uint64_t c) {
+    return std::__detail::syscall<ssize_t>(SYS_systrace, (uintptr_t)operation, (uintptr_t)a, (uintptr_t)b, (uintptr_t)c);
+}
 
 } // namespace std
 
@@ -0,0 +1,44 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SYS_UIO_H
+#define _SYS_UIO_H
+
+#include <bits/decls.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS__
+
+/// The most buffers `readv` and `writev` accept at once.
+#define IOV_MAX 1024
+
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+
+/// Read into, or write from, each of the COUNT buffers in VECTORS in
+/// turn, in a single call, as if they were one big buffer.
+ssize_t readv(int fd, const struct iovec* vectors, int count);
+ssize_t writev(int fd, const struct iovec* vectors, int count);
+
+__END_DECLS__
+
+#endif /* _SYS_UIO_H */
@@ -0,0 +1,243 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "threads.h"
+
+#include "stddef.h"
+#include "stdint.h"
+#include "sys/syscalls.h"
+
+/// Lives at the very top of the thread's stack mapping, so that the
+/// whole thread is a single allocation. FS is based here, too.
+struct __thrd {
+    /// Points to itself, so that `%fs:0` yields the current thread.
+    __thrd* self;
+    pid_t tid;
+    thrd_start_t func;
+    void* arg;
+    void* stack;
+};
+
+namespace {
+/// The thread that `main()` runs on; it has no stack of it's own to
+/// live on, and is never joined.
+__thrd main_thread;
+
+[[noreturn]] void thrd_trampoline(__thrd* thr) {
+    thrd_exit(thr->func(thr->arg));
+}
+
+/// ===========================================================================
+///  Futex helpers.
+/// ===========================================================================
+uint32_t cmpxchg(uint32_t* word, uint32_t expected, uint32_t desired) {
+    __atomic_compare_exchange_n(word, &expected, desired, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    return expected;
+}
+
+void futex_wait(uint32_t* word, uint32_t value) {
+    syscall(SYS_futex, word, FUTEX_WAIT, value);
+}
+
+void futex_wake(uint32_t* word, uint32_t count) {
+    syscall(SYS_futex, word, FUTEX_WAKE, count);
+}
+}
+
+extern "C" {
+    /// Give the main thread a thread control block, so that
+    /// `thrd_current()` works everywhere. Called before anything else by
+    /// `__libc_init()`.
+    void __libc_init_threads() {
+        main_thread.self = &main_thread;
+        main_thread.tid = -1;
+        syscall(SYS_set_tls, &main_thread);
+    }
+
+    int thrd_create(thrd_t* thr, thrd_start_t func, void* arg) {
+        if (!thr || !func) return thrd_error;
+        auto* stack = syscall<uint8_t*>(SYS_map, nullptr, THRD_STACK_SIZE, 0);
+        if (!stack) return thrd_nomem;
+
+        auto top = uintptr_t(stack + THRD_STACK_SIZE - sizeof(__thrd)) & ~uintptr_t(15);
+        auto* t = (__thrd*)top;
+        t->self = t;
+        t->func = func;
+        t->arg = arg;
+        t->stack = stack;
+
+        // Aligned as if the trampoline had just been called.
+        void* sp = (void*)(top - 8);
+        t->tid = syscall<pid_t>(SYS_thread_create, thrd_trampoline, t, sp, t);
+        if (t->tid == -1) {
+            syscall(SYS_unmap, stack);
+            return thrd_error;
+        }
+        *thr = t;
+        return thrd_success;
+    }
+
+    int thrd_join(thrd_t thr, int* res) {
+        if (!thr) return thrd_error;
+        // The thread is gone, but it's stack is still mapped until here.
+        int status = syscall<int>(SYS_thread_join, thr->tid);
+        if (res) *res = status;
+        syscall(SYS_unmap, thr->stack);
+        return thrd_success;
+    }
+
+    void thrd_exit(int res) {
+        syscall(SYS_thread_exit, res);
+        __builtin_unreachable();
+    }
+
+    thrd_t thrd_current(void) {
+        __thrd* self;
+        __asm__ ("movq %%fs:0, %0" : "=r"(self));
+        return self;
+    }
+
+    int thrd_equal(thrd_t lhs, thrd_t rhs) {
+        return lhs == rhs;
+    }
+
+    /// =======================================================================
+    ///  Mutexes.
+    /// =======================================================================
+    int mtx_init(mtx_t* mtx, int type) {
+        if (!mtx) return thrd_error;
+        mtx->__state = 0;
+        mtx->__type = type;
+        mtx->__owner = nullptr;
+        mtx->__count = 0;
+        return thrd_success;
+    }
+
+    int mtx_lock(mtx_t* mtx) {
+        if (mtx->__type & mtx_recursive) {
+            thrd_t self = thrd_current();
+            if (mtx->__owner == self) {
+                ++mtx->__count;
+                return thrd_success;
+            }
+        }
+
+        // Uncontended: never leaves userspace.
+        uint32_t state = cmpxchg(&mtx->__state, 0, 1);
+        if (state != 0) {
+            // Mark the mutex as waited on, and sleep until it is unlocked.
+            if (state != 2) state = __atomic_exchange_n(&mtx->__state, 2, __ATOMIC_ACQUIRE);
+            while (state != 0) {
+                futex_wait(&mtx->__state, 2);
+                state = __atomic_exchange_n(&mtx->__state, 2, __ATOMIC_ACQUIRE);
+            }
+        }
+
+        if (mtx->__type & mtx_recursive) {
+            mtx->__owner = thrd_current();
+            mtx->__count = 1;
+        }
+        return thrd_success;
+    }
+
+    int mtx_trylock(mtx_t* mtx) {
+        if (mtx->__type & mtx_recursive && mtx->__owner == thrd_current()) {
+            ++mtx->__count;
+            return thrd_success;
+        }
+        if (cmpxchg(&mtx->__state, 0, 1) != 0) return thrd_busy;
+        if (mtx->__type & mtx_recursive) {
+            mtx->__owner = thrd_current();
+            mtx->__count = 1;
+        }
+        return thrd_success;
+    }
+
+    int mtx_unlock(mtx_t* mtx) {
+        if (mtx->__type & mtx_recursive) {
+            if (--mtx->__count) return thrd_success;
+            mtx->__owner = nullptr;
+        }
+        // Only bother the kernel if somebody may be waiting.
+        if (__atomic_fetch_sub(&mtx->__state, 1, __ATOMIC_RELEASE) != 1) {
+            __atomic_store_n(&mtx->__state, 0, __ATOMIC_RELEASE);
+            futex_wake(&mtx->__state, 1);
+        }
+        return thrd_success;
+    }
+
+    void mtx_destroy(mtx_t*) {}
+
+    /// =======================================================================
+    ///  Condition variables.
+    /// =======================================================================
+    int cnd_init(cnd_t* cond) {
+        if (!cond) return thrd_error;
+        cond->__sequence = 0;
+        return thrd_success;
+    }
+
+    int cnd_signal(cnd_t* cond) {
+        __atomic_fetch_add(&cond->__sequence, 1, __ATOMIC_RELEASE);
+        futex_wake(&cond->__sequence, 1);
+        return thrd_success;
+    }
+
+    int cnd_broadcast(cnd_t* cond) {
+        __atomic_fetch_add(&cond->__sequence, 1, __ATOMIC_RELEASE);
+        futex_wake(&cond->__sequence, UINT32_MAX);
+        return thrd_success;
+    }
+
+    int cnd_wait(cnd_t* cond, mtx_t* mtx) {
+        // A signal between unlocking and waiting changes the sequence,
+        // so the wait returns straight away rather than missing it.
+        uint32_t sequence = __atomic_load_n(&cond->__sequence, __ATOMIC_ACQUIRE);
+        // A recursive mutex must be released fully, and restored after.
+        uint32_t count = mtx->__count;
+        mtx->__count = 1;
+        mtx_unlock(mtx);
+        futex_wait(&cond->__sequence, sequence);
+        mtx_lock(mtx);
+        if (mtx->__type & mtx_recursive) mtx->__count = count;
+        return thrd_success;
+    }
+
+    void cnd_destroy(cnd_t*) {}
+
+    /// =======================================================================
+    ///  Once flags.
+    /// =======================================================================
+    void __call_once(once_flag* flag, void (*func)(void*), void* arg) {
+        // Fast path once it has been called.
+        if (__atomic_load_n(&flag->__state, __ATOMIC_ACQUIRE) == 2) return;
+        if (cmpxchg(&flag->__state, 0, 1) == 0) {
+            func(arg);
+            __atomic_store_n(&flag->__state, 2, __ATOMIC_RELEASE);
+            futex_wake(&flag->__state, UINT32_MAX);
+            return;
+        }
+        while (__atomic_load_n(&flag->__state, __ATOMIC_ACQUIRE) != 2)
+            futex_wait(&flag->__state, 1);
+    }
+
+    void call_once(once_flag* flag, void (*func)(void)) {
+        __call_once(flag, [](void* f) { ((void (*)(void))f)(); }, (void*)func);
+    }
+}
@@ -0,0 +1,129 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THREADS_H
+#define _THREADS_H
+
+#include <bits/decls.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS__
+
+enum {
+    thrd_success,
+    thrd_error,
+    thrd_nomem,
+    thrd_busy,
+    thrd_timedout,
+};
+
+/// A thread of execution within the current process. Threads share
+/// everything (memory, open files, event queues) except for their
+/// registers and stack.
+/// NOTE: `malloc()` and `errno` are not yet safe to use from more than
+/// one thread at a time.
+typedef struct __thrd* thrd_t;
+typedef int (*thrd_start_t)(void*);
+
+/// Size of the stack each thread is created with.
+#define THRD_STACK_SIZE (64 * 1024)
+
+/// Start a new thread that runs FUNC(ARG), and store it in THR.
+/// Returning from FUNC is the same as calling `thrd_exit()` with the
+/// returned value.
+/// Returns thrd_success, or thrd_nomem if no stack could be allocated,
+/// or thrd_error if the thread could not be started.
+int thrd_create(thrd_t* thr, thrd_start_t func, void* arg);
+
+/// Wait for THR to exit and release it's resources. If RES is not NULL,
+/// it is set to the thread's exit status. Each thread must be joined
+/// exactly once.
+int thrd_join(thrd_t thr, int* res);
+
+/// Exit the calling thread with RES as it's status. The process exits
+/// when it's last thread does.
+__attribute__((__noreturn__)) void thrd_exit(int res);
+
+/// The calling thread.
+thrd_t thrd_current(void);
+
+/// Non-zero iff LHS and RHS are the same thread.
+int thrd_equal(thrd_t lhs, thrd_t rhs);
+
+/// ===========================================================================
+///  Mutexes, condition variables and once flags.
+/// ===========================================================================
+/// All of these are built on futexes: locking and unlocking are plain
+/// atomic operations, and the kernel is only asked to step in when a
+/// thread actually has to wait (or be woken up). A zero-filled object
+/// is a valid, unlocked plain mutex (or condition, or once flag).
+
+enum {
+    mtx_plain = 0,
+    mtx_recursive = 1,
+    /// Accepted, but there is no `mtx_timedlock()` yet.
+    mtx_timed = 2,
+};
+
+typedef struct {
+    /// 0 = unlocked, 1 = locked, 2 = locked and (maybe) waited on.
+    uint32_t __state;
+    int __type;
+    /// Only used by recursive mutexes.
+    thrd_t __owner;
+    uint32_t __count;
+} mtx_t;
+
+int mtx_init(mtx_t* mtx, int type);
+int mtx_lock(mtx_t* mtx);
+/// Returns thrd_busy, rather than waiting, if MTX is already locked.
+int mtx_trylock(mtx_t* mtx);
+int mtx_unlock(mtx_t* mtx);
+void mtx_destroy(mtx_t* mtx);
+
+typedef struct {
+    /// Bumped by every signal, so that waiters can tell if they missed one.
+    uint32_t __sequence;
+} cnd_t;
+
+int cnd_init(cnd_t* cond);
+int cnd_signal(cnd_t* cond);
+int cnd_broadcast(cnd_t* cond);
+/// Unlock MTX and wait for COND to be signalled, then lock MTX again.
+/// May return without having been signalled; check the condition again.
+int cnd_wait(cnd_t* cond, mtx_t* mtx);
+void cnd_destroy(cnd_t* cond);
+
+typedef struct {
+    /// 0 = not called, 1 = being called, 2 = called.
+    uint32_t __state;
+} once_flag;
+#define ONCE_FLAG_INIT {0}
+
+/// Call FUNC exactly once for FLAG, no matter how many threads get here;
+/// none return until it has been called.
+void call_once(once_flag* flag, void (*func)(void));
+
+/// As `call_once()`, but calls FUNC(ARG); used by `std::call_once()`.
+void __call_once(once_flag* flag, void (*func)(void*), void* arg);
+
+__END_DECLS__
+
+#endif /* _THREADS_H */
@@ -0,0 +1,117 @@
+/* Copyright 2022, Contributors To LensorOS.
+ * All rights reserved.
+ *
+ * This file is part of LensorOS.
+ *
+ * LensorOS is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LensorOS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with LensorOS. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "time.h"
+
+#include "errno.h"
+#include "sys/syscalls.h"
+
+namespace {
+/// The page the kernel keeps the time in, mapped read-only into every
+/// process. The layout must match that of `TimePage::Data` in the kernel.
+struct time_page {
+    /// Odd while the kernel is updating the page.
+    uint32_t sequence;
+    uint32_t __reserved;
+    uint64_t wall_clock_seconds;
+    uint64_t wall_clock_tsc;
+    uint64_t tsc_frequency;
+    uint64_t ticks;
+    uint64_t tick_frequency;
+};
+
+constexpr uintptr_t time_page_address = 0x7ffffffff000;
+
+/// Take a consistent copy of the time page, retrying if the kernel
+/// updated it while we were reading.
+time_page read_time_page() {
+    const auto* page = (const time_page*)time_page_address;
+    time_page copy;
+    uint32_t sequence;
+    do {
+        sequence = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        copy = *page;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((sequence & 1) || sequence != __atomic_load_n(&page->sequence, __ATOMIC_RELAXED));
+    return copy;
+}
+
+uint64_t rdtsc() {
+    uint32_t low;
+    uint32_t high;
+    __asm__ __volatile__ ("rdtsc" : "=a"(low), "=d"(high));
+    return (uint64_t(high) << 32) | low;
+}
+
+/// Convert COUNT of something that happens FREQUENCY times a second
+/// to nanoseconds; split to avoid overflowing the multiplication.
+uint64_t to_nanoseconds(uint64_t count, uint64_t frequency) {
+    return count / frequency * 1'000'000'000 + count % frequency * 1'000'000'000 / frequency;
+}
+
+void set_timespec(struct timespec* time, uint64_t seconds, uint64_t nanoseconds) {
+    time->tv_sec = time_t(seconds + nanoseconds / 1'000'000'000);
+    time->tv_nsec = long(nanoseconds % 1'000'000'000);
+}
+} // namespace
+
+extern "C" {
+    int clock_gettime(clockid_t clock, struct timespec* time) {
+        if (!time) {
+            errno = EINVAL;
+            return -1;
+        }
+        time_page page = read_time_page();
+        switch (clock) {
+        case CLOCK_REALTIME:
+            set_timespec(time, page.wall_clock_seconds, to_nanoseconds(rdtsc() - page.wall_clock_tsc, page.tsc_frequency));
+            return 0;
+        case CLOCK_MONOTONIC:
+            set_timespec(time, 0, to_nanoseconds(rdtsc(), page.tsc_frequency));
+            return 0;
+        case CLOCK_MONOTONIC_COARSE:
+            set_timespec(time, 0, to_nanoseconds(page.ticks, page.tick_frequency));
+            return 0;
+        default:
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    time_t time(time_t* t) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (t) *t = now.tv_sec;
+        return now.tv_sec;
+    }
+
+    int nanosleep(const struct timespec* requested, struct timespec* remaining) {
+        if (!requested || requested->tv_nsec < 0 || requested->tv_nsec >= 1'000'000'000) {
+            errno = EINVAL;
+            return -1;
+        }
+        uint64_t nanoseconds = requested->tv_sec * 1'000'000'000 + uint64_t(requested->tv_nsec);
+        syscall(SYS_nanosleep, nanoseconds);
+        if (remaining) {
+            remaining->tv_sec = 0;
+            remaining->tv_nsec = 0;
+        }
+        return 0;
+    }
+}
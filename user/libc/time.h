@@ -21,11 +21,39 @@
 #ifndef _TIME_H
 #define _TIME_H
 
+#include <sys/types.h>
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
 
+struct timespec {
+    time_t tv_sec;
+    long tv_nsec;
+};
+
+/// Wall-clock time, since the Unix epoch.
+#define CLOCK_REALTIME 0
+/// Time since boot, with the precision of the time stamp counter.
+#define CLOCK_MONOTONIC 1
+/// Time since boot, with the precision of the system timer tick.
+#define CLOCK_MONOTONIC_COARSE 6
+
+/// Store the current time of CLOCK in TIME. Returns 0 on success, or
+/// -1 with errno set to EINVAL if CLOCK is unknown.
+/// NOTE: This never enters the kernel; the time is read from a page
+/// the kernel keeps it in.
+int clock_gettime(clockid_t clock, struct timespec* time);
+
+/// Seconds since the Unix epoch. Also stored in T, if non-NULL.
+time_t time(time_t* t);
 
+/// Suspend execution of the calling process for (at least) the
+/// duration given by REQUESTED. Returns 0 on success, or -1 with errno
+/// set to EINVAL if REQUESTED is invalid.
+/// NOTE: REMAINING, if non-NULL, is always set to zero as sleeping is
+/// never interrupted.
+int nanosleep(const struct timespec* requested, struct timespec* remaining);
 
 #if defined (__cplusplus)
 } /* extern "C" */
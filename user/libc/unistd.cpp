@@ -24,7 +24,9 @@
 #include "stddef.h"
 #include "stdio.h"
 #include "stdlib.h"
+#include "sys/sendfile.h"
 #include "sys/syscalls.h"
+#include "sys/uio.h"
 
 extern "C" {
     int open(const char *path, int flags, int mode) {
@@ -53,6 +55,66 @@ extern "C" {
         return rc;
     }
 
+    ssize_t pread(int fd, void* buffer, size_t count, off_t offset) {
+        if (offset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        ssize_t rc = 0;
+        while ((rc = syscall<ssize_t>(SYS_pread, fd, buffer, count, offset)) == -2);
+        return rc;
+    }
+
+    ssize_t pwrite(int fd, const void* buffer, size_t count, off_t offset) {
+        if (offset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        ssize_t rc = 0;
+        while ((rc = syscall<ssize_t>(SYS_pwrite, fd, buffer, count, offset)) == -2);
+        return rc;
+    }
+
+    ssize_t readv(int fd, const struct iovec* vectors, int count) {
+        if (count < 0 || count > IOV_MAX) {
+            errno = EINVAL;
+            return -1;
+        }
+        ssize_t rc = 0;
+        while ((rc = syscall<ssize_t>(SYS_readv, fd, vectors, count)) == -2);
+        return rc;
+    }
+
+    ssize_t writev(int fd, const struct iovec* vectors, int count) {
+        if (count < 0 || count > IOV_MAX) {
+            errno = EINVAL;
+            return -1;
+        }
+        ssize_t rc = 0;
+        while ((rc = syscall<ssize_t>(SYS_writev, fd, vectors, count)) == -2);
+        return rc;
+    }
+
+    ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+        if (offset && *offset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        ssize_t rc = 0;
+        while ((rc = syscall<ssize_t>(SYS_sendfile, out_fd, in_fd, offset, count)) == -2);
+        return rc;
+    }
+
+    ssize_t splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t count) {
+        if ((in_offset && *in_offset < 0) || (out_offset && *out_offset < 0)) {
+            errno = EINVAL;
+            return -1;
+        }
+        ssize_t rc = 0;
+        while ((rc = syscall<ssize_t>(SYS_splice, in_fd, in_offset, out_fd, out_offset, count)) == -2);
+        return rc;
+    }
+
     pid_t fork(void) {
         // Flush all libc file buffers. This is necessary because, as
         // you can imagine, it isn't ideal when the two processes after
@@ -71,6 +133,16 @@ extern "C" {
         return child_pid;
     }
 
+    unsigned sleep(unsigned seconds) {
+        syscall(SYS_nanosleep, uint64_t(seconds) * 1'000'000'000);
+        return 0;
+    }
+
+    int usleep(uint64_t useconds) {
+        syscall(SYS_nanosleep, useconds * 1'000);
+        return 0;
+    }
+
     char *getcwd(char *buf, size_t size) {
         if (!size) {
             errno = EINVAL;
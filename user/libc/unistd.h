@@ -36,8 +36,19 @@ void close(int fd);
 ssize_t read(int fd, const void* buffer, size_t count);
 ssize_t write(int fd, const void* buffer, size_t count);
 
+/// Like `read` and `write`, but OFFSET bytes into the file, which is
+/// left at the same offset it was at before.
+ssize_t pread(int fd, void* buffer, size_t count, off_t offset);
+ssize_t pwrite(int fd, const void* buffer, size_t count, off_t offset);
+
 pid_t fork(void);
 
+/// Suspend execution of the calling process for SECONDS seconds.
+/// Always returns zero, as sleeping is never interrupted.
+unsigned sleep(unsigned seconds);
+/// Suspend execution of the calling process for USECONDS microseconds.
+int usleep(uint64_t useconds);
+
 /// On success, `buf` will be filled with the absolute path of the
 /// current process' working directory.
 /// On failure, return NULL, and errno is set to indicate the
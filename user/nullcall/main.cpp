@@ -0,0 +1,67 @@
+#include <format>
+
+#include <stdint.h>
+#include <sys/syscalls.h>
+
+// Measures the round trip into the kernel and back through each of
+// the ways in: the `int $0x80` gate (the only way in before the
+// `syscall` fast path), and the `syscall` instruction. The call made
+// is about as cheap as they come, so that the time is dominated by
+// getting in and out.
+
+constexpr size_t iterations = 100000;
+/// The best of this many runs is reported, so that a timer tick or a
+/// switch to another process landing in one doesn't skew the result.
+constexpr size_t runs = 5;
+
+static inline uint64_t rdtsc() {
+    uint32_t low;
+    uint32_t high;
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return (uint64_t(high) << 32) | low;
+}
+
+static uint64_t mask;
+
+static void through_interrupt() {
+    uintptr_t rax = SYS_sched_getaffinity;
+    asm volatile ("int $0x80"
+                  : "+a"(rax)
+                  : "D"(0), "S"(sizeof(mask)), "d"(&mask)
+                  : "memory");
+}
+
+static void through_syscall() {
+    uintptr_t rax = SYS_sched_getaffinity;
+    asm volatile ("syscall"
+                  : "+a"(rax)
+                  : "D"(0), "S"(sizeof(mask)), "d"(&mask)
+                  : "rcx", "r11", "memory");
+}
+
+template <typename Call>
+static uint64_t cycles_per_call(Call call) {
+    // Warm up the caches (and the branch predictor) first.
+    for (size_t i = 0; i < iterations / 10; ++i) call();
+    uint64_t best = UINT64_MAX;
+    for (size_t run = 0; run < runs; ++run) {
+        uint64_t start = rdtsc();
+        for (size_t i = 0; i < iterations; ++i) call();
+        uint64_t cycles = (rdtsc() - start) / iterations;
+        if (cycles < best) best = cycles;
+    }
+    return best;
+}
+
+int main() {
+    uint64_t interrupt = cycles_per_call(through_interrupt);
+    uint64_t syscall = cycles_per_call(through_syscall);
+    std::print("Round trip into the kernel, best of {} runs of {} calls:\n"
+               "  int $0x80: {} cycles (before)\n"
+               "  syscall:   {} cycles (after)\n"
+               , runs, iterations, interrupt, syscall);
+    if (interrupt > syscall)
+        std::print("  saved:     {} cycles ({}%)\n"
+                   , interrupt - syscall, (interrupt - syscall) * 100 / interrupt);
+    return 0;
+}
@@ -44,8 +44,13 @@ int main(int argc, char **argv) {
   Event eventlist[eventlist_size];
   memset(eventlist, 0, sizeof(eventlist));
   int status = 0;
-  while ((status = sys_kevent(listen_queue, NULL, 0, eventlist, eventlist_size)) != 0)
+  while ((status = sys_kevent_timeout(listen_queue, NULL, 0, eventlist, eventlist_size, -1)) == 0)
     ;
+  if (status < 0) {
+    close(sockFD);
+    printf("[SERVE]: `kevent` failed: %d\n", status);
+    return 1;
+  }
 
   printf("[SERVE]: Waiting for a connection to come in...\n");
   sockaddr connected_addr;
@@ -0,0 +1,120 @@
+#include <format>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscalls.h>
+#include <unistd.h>
+
+// Run a program, and print every system call it (and anything it
+// starts) made once it exits; or, with `-c`, how often each system
+// call was made and how long they took, across the whole system.
+
+struct syscall_info {
+    const char* name;
+    int args;
+};
+
+// In order of number; see the table in the kernel's `syscalls.cpp`.
+static constexpr syscall_info syscalls[] = {
+    {"open", 1}, {"close", 1}, {"read", 3}, {"write", 3}, {"poke", 0},
+    {"exit", 1}, {"map", 3}, {"unmap", 1}, {"time", 1}, {"waitpid", 1},
+    {"fork", 0}, {"exec", 2}, {"repfd", 2}, {"pipe", 1}, {"seek", 3},
+    {"pwd", 2}, {"dup", 1}, {"uart", 2}, {"socket", 3}, {"bind", 3},
+    {"listen", 2}, {"connect", 3}, {"accept", 3}, {"kqueue", 0}, {"kevent", 6},
+    {"directory_data", 3}, {"setpriority", 2}, {"nanosleep", 1}, {"timeout", 2}, {"thread_create", 4},
+    {"thread_exit", 1}, {"thread_join", 1}, {"futex", 3}, {"set_tls", 1}, {"sched_setaffinity", 3},
+    {"sched_getaffinity", 3}, {"sched_stats", 2}, {"io_setup", 1}, {"io_enter", 2}, {"readv", 3},
+    {"writev", 3}, {"pread", 4}, {"pwrite", 4}, {"sendfile", 4}, {"splice", 5},
+    {"systrace", 4}, {"spawn", 4}, {"poll", 3},
+};
+constexpr size_t syscall_count = sizeof(syscalls) / sizeof(syscalls[0]);
+
+constexpr size_t batch = 32;
+
+static void print_record(const systrace_record& record) {
+    if (record.number >= syscall_count) {
+        std::print("[{}] syscall_{}(...) = {}\n", record.pid, record.number, record.result);
+        return;
+    }
+    const syscall_info& info = syscalls[record.number];
+    std::print("[{}] {}(", record.pid, info.name);
+    for (int i = 0; i < info.args; ++i) {
+        if (i) std::print(", ");
+        std::print("{:#x}", record.args[i]);
+    }
+    std::print(") = {}  <{} cycles>\n", record.result, record.exit_tsc - record.entry_tsc);
+}
+
+/// Print (or, if PRINT is not set, skip) every record from CURSOR on.
+static void drain(uint64_t& cursor, bool print) {
+    systrace_record records[batch];
+    for (;;) {
+        uint64_t expected = cursor;
+        ssize_t n = std::sys_systrace(SYSTRACE_READ, (uintptr_t)&cursor, (uintptr_t)records, batch);
+        if (n <= 0) return;
+        if (!print) continue;
+        // Records are numbered in order; a gap means the ring wrapped
+        // around before we got to them.
+        if (records[0].sequence != expected)
+            std::print("... {} records lost ...\n", records[0].sequence - expected);
+        for (ssize_t i = 0; i < n; ++i)
+            print_record(records[i]);
+    }
+}
+
+static void print_statistics() {
+    systrace_stats stats[syscall_count];
+    ssize_t n = std::sys_systrace(SYSTRACE_STATISTICS, (uintptr_t)stats, syscall_count, 0);
+    for (ssize_t i = 0; i < n; ++i) {
+        if (!stats[i].count) continue;
+        std::print("{}: {} calls, {}ns total, {}ns average, {}ns at most\n"
+                   , syscalls[i].name
+                   , stats[i].count
+                   , stats[i].total_time
+                   , stats[i].total_time / stats[i].count
+                   , stats[i].max_time);
+        // Bucket zero is anything under 128ns, then doubling from there.
+        std::print("  histogram:");
+        for (size_t b = 0; b < SYSTRACE_BUCKETS; ++b)
+            std::print(" {}", stats[i].histogram[b]);
+        std::print("\n");
+    }
+}
+
+int main(int argc, const char** argv) {
+    bool count = false;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+        count = true;
+        first = 2;
+    }
+    if (first >= argc) {
+        std::print("Usage: systrace [-c] <program> [arguments...]\n");
+        return 1;
+    }
+
+    // Skip whatever was traced before we got here.
+    uint64_t cursor = 0;
+    drain(cursor, false);
+    if (count) {
+        std::sys_systrace(SYSTRACE_RESET, 0, 0, 0);
+        std::sys_systrace(SYSTRACE_COUNT, 1, 0, 0);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!count) std::sys_systrace(SYSTRACE_TRACE, 0, 1, 0);
+        // The kernel passes the path along as argv[0] itself.
+        syscall(SYS_exec, argv[first], argv + first + 1);
+        std::print("systrace: Could not run {}\n", argv[first]);
+        return 1;
+    }
+
+    int status = syscall<int>(SYS_waitpid, pid);
+    if (count) {
+        std::sys_systrace(SYSTRACE_COUNT, 0, 0, 0);
+        print_statistics();
+    } else drain(cursor, true);
+    std::print("{} exited with status {}\n", argv[first], status);
+    return 0;
+}
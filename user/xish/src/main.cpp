@@ -2,7 +2,10 @@
 #include <format>
 #include <vector>
 
+#include <sched.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/syscalls.h>
 #include <unistd.h>
 #include <bits/io_defs.h>
@@ -12,58 +15,69 @@ constexpr const char prompt[] = "  $:";
 // FIXME: May want to do ErrorOr or some type of variant so that we can
 // tell when run_program_waitpid itself failed vs the program that was
 // run failing.
-/// @param filepath Passed to `exec` syscall
+/// @param filepath Passed to `posix_spawn`
 /// @param args
-///   NULL-terminated array of pointers to NULL-terminated strings.
-///   Passed to `exec` syscall
-int run_program_waitpid(const char *const filepath, const char **args) {
+///   NULL-terminated array of pointers to NULL-terminated strings,
+///   not including the program itself (argv[0]).
+/// @param affinity
+///   If not NULL, the CPUs the program may run on.
+int run_program_waitpid(const char *const filepath, const char **args, const cpu_set_t *affinity = nullptr) {
     size_t fds[2] = {size_t(-1), size_t(-1)};
     syscall(SYS_pipe, fds);
-    //std::print("[XiSh]: Created pipe: ({}, {})\n", fds[0], fds[1]);
-
-    pid_t cpid = fork();
-    //printf("pid: %d\n", cpid);
-    if (cpid) {
-        //puts("Parent");
-        close(fds[1]);
-
-        char c;
-        while (read(fds[0], &c, 1) != EOF && c)
-            std::print("{}", c);
-
-        close(fds[0]);
-
-        // TODO: waitpid needs to reserve some uncommon error code for
-        // itself so that it is clear what is a failure from waitpid or just a
-        // failing status. Maybe have some other way to check? Or wrap this in
-        // libc that sets errno (that always goes well).
-        fflush(NULL);
-        int command_status = syscall<int>(SYS_waitpid, cpid);
-        if (command_status == -1) {
-            std::print("`waitpid` failure!\n");
-            return -1;
-        }
-
-        //puts("Parent waited");
-        //fflush(NULL);
-
-        return command_status;
+    //std::print("[XiSH]: Created pipe: ({}, {})\n", fds[0], fds[1]);
+
+    // Redirect stdout of the program to the write end of the pipe, and
+    // don't let it keep either end open otherwise.
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, int(fds[1]), STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, int(fds[1]));
+    posix_spawn_file_actions_addclose(&actions, int(fds[0]));
+
+    // `posix_spawn` skips argv[0], so stand `filepath` in for it.
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(filepath));
+    for (const char **arg = args; *arg; ++arg)
+        argv.push_back(const_cast<char *>(*arg));
+    argv.push_back(nullptr);
+
+    // Set up front, so that the program never runs anywhere else.
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    if (affinity) {
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETAFFINITY_NP);
+        posix_spawnattr_setaffinity_np(&attributes, sizeof(cpu_set_t), affinity);
+    }
 
-    } else {
-        //puts("Child");;
+    pid_t cpid = -1;
+    int error = posix_spawn(&cpid, filepath, &actions, &attributes, argv.data(), nullptr);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    close(fds[1]);
+    if (error) {
+        std::print("[XiSH]:Error: Could not run {}\n", filepath);
         close(fds[0]);
-
-        // Redirect stdout to write end of pipe.
-        syscall(SYS_repfd, fds[1], STDOUT_FILENO);
-        close(fds[1]);
-
-        fflush(NULL);
-        syscall(SYS_exec, filepath, args);
+        return -1;
     }
 
-    // FIXME: Unreachable
+    char c;
+    while (read(fds[0], &c, 1) != EOF && c)
+        std::print("{}", c);
+
+    close(fds[0]);
+
+    // TODO: waitpid needs to reserve some uncommon error code for
+    // itself so that it is clear what is a failure from waitpid or just a
+    // failing status. Maybe have some other way to check? Or wrap this in
+    // libc that sets errno (that always goes well).
+    fflush(NULL);
+    int command_status = syscall<int>(SYS_waitpid, cpid);
+    if (command_status == -1) {
+        std::print("`waitpid` failure!\n");
+        return -1;
+    }
 
-    return -1;
+    return command_status;
 }
 
 int main(int argc, char **argv) {
@@ -175,6 +189,30 @@ int main(int argc, char **argv) {
         if (command == "quit")
             break;
 
+        // taskset MASK COMMAND [ARGS...]
+        // Run COMMAND on only the CPUs in MASK (hexadecimal, bit N is
+        // CPU N). With no arguments, show the shell's own mask.
+        cpu_set_t affinity;
+        cpu_set_t *command_affinity = nullptr;
+        if (command == "taskset") {
+            if (arguments.empty()) {
+                if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+                    std::print("{:x}\n", affinity.__bits[0]);
+                continue;
+            }
+            char *end = nullptr;
+            CPU_ZERO(&affinity);
+            affinity.__bits[0] = strtoull(arguments[0].data(), &end, 16);
+            if (arguments.size() < 2 || *end || !CPU_COUNT(&affinity)) {
+                std::print("[XiSH]:Error: Usage: taskset MASK COMMAND [ARGS...]\n");
+                rc = -1;
+                continue;
+            }
+            command_affinity = &affinity;
+            command = arguments[1];
+            arguments.erase(arguments.begin(), arguments.begin() + 2);
+        }
+
         // NOT A BUILTIN, DELEGATE TO SYSTEM COMMAND
         std::vector<const char *> argv;
         for (const auto& arg : arguments) {
@@ -183,7 +221,7 @@ int main(int argc, char **argv) {
         argv.push_back(nullptr);
 
         if (std::filesystem::exists(std::filesystem::path{command.data()}))
-            rc = run_program_waitpid(command.data(), argv.data());
+            rc = run_program_waitpid(command.data(), argv.data(), command_affinity);
         else std::print("[XiSH]:Error: \"{}\" does not exist\n", command);
     }
     return 0;